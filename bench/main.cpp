@@ -0,0 +1,957 @@
+/*
+ * Copyright (C) 2026  Psi IM Team
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301  USA
+ *
+ */
+
+#include "main.h"
+
+#include <QCommandLineParser>
+#include <QCoreApplication>
+#include <QDateTime>
+#include <QDir>
+#include <QFile>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QLibrary>
+#include <QProcess>
+#include <QtPlugin>
+#include <QtMath>
+#include <cstdio>
+#include <ctime>
+#ifdef Q_OS_LINUX
+#include <unistd.h>
+#endif
+
+// seconds a pair may take to get its sessions going, and to stop them
+#define NEGOTIATION_TIMEOUT 30
+#define STOP_TIMEOUT 5
+
+// seconds a replayed session gets to play out what it has buffered
+#define DRAIN_TIME 2
+
+static qint64 cpu_time_us() { return qint64(std::clock()) * 1000000 / CLOCKS_PER_SEC; }
+
+// resident memory of this process in bytes, -1 where we can't tell
+static qint64 resident_memory()
+{
+#ifdef Q_OS_LINUX
+    QFile f("/proc/self/statm");
+    if (!f.open(QIODevice::ReadOnly))
+        return -1;
+    QList<QByteArray> fields = f.readAll().split(' ');
+    if (fields.count() < 2)
+        return -1;
+    return fields[1].toLongLong() * sysconf(_SC_PAGESIZE);
+#else
+    return -1;
+#endif
+}
+
+static QString size_to_string(const QSize &size) { return QString("%1x%2").arg(size.width()).arg(size.height()); }
+
+static QSize string_to_size(const QString &str)
+{
+    QStringList parts = str.split('x');
+    if (parts.count() != 2)
+        return QSize();
+    return QSize(parts[0].toInt(), parts[1].toInt());
+}
+
+QStringList BenchConfig::pairArguments() const
+{
+    QStringList args;
+    args << "--pair";
+    args << "--audio-codec" << audioCodec << "--video-codec" << videoCodec << "--pattern" << pattern;
+    args << "--sizes" << size_to_string(size) << "--fps" << QString::number(fps);
+    args << "--warmup" << QString::number(warmup) << "--duration" << QString::number(duration);
+    if (!audio)
+        args << "--no-audio";
+    if (!video)
+        args << "--no-video";
+    if (!impairment.isEmpty())
+        args << "--impairment" << impairment;
+    return args;
+}
+
+//----------------------------------------------------------------------------
+// BenchPair
+//----------------------------------------------------------------------------
+// what a stream did between two readings of the metrics
+static QJsonObject stream_result(const PsiMedia::StreamMetrics &sendFrom, const PsiMedia::StreamMetrics &sendTo,
+                                 const PsiMedia::StreamMetrics &recvFrom, const PsiMedia::StreamMetrics &recvTo)
+{
+    QJsonObject out;
+    if (sendFrom.isNull() || sendTo.isNull() || recvFrom.isNull() || recvTo.isNull())
+        return out;
+
+    out["packetsSent"]     = sendTo.packetsSent() - sendFrom.packetsSent();
+    out["bytesSent"]       = sendTo.bytesSent() - sendFrom.bytesSent();
+    out["packetsDropped"]  = sendTo.packetsDropped() - sendFrom.packetsDropped();
+    out["packetsReceived"] = recvTo.packetsReceived() - recvFrom.packetsReceived();
+    out["bytesReceived"]   = recvTo.bytesReceived() - recvFrom.bytesReceived();
+    out["jitter"]          = recvTo.jitter();
+    out["framesEncoded"]   = sendTo.framesEncoded() - sendFrom.framesEncoded();
+    out["framesDecoded"]   = recvTo.framesDecoded() - recvFrom.framesDecoded();
+    out["encodeTime"]      = sendTo.encodeTime();
+    out["decodeTime"]      = recvTo.decodeTime();
+    return out;
+}
+
+static QJsonArray int_list_to_json(const QList<int> &list)
+{
+    QJsonArray out;
+    for (int i : list)
+        out += i;
+    return out;
+}
+
+static QJsonArray latency_to_json(const QList<PsiMedia::LatencyStage> &stages)
+{
+    QJsonArray out;
+    for (const PsiMedia::LatencyStage &s : stages) {
+        QJsonObject stage;
+        stage["stream"]    = s.stream();
+        stage["name"]      = s.name();
+        stage["count"]     = s.count();
+        stage["mean"]      = s.meanLatency();
+        stage["max"]       = s.maxLatency();
+        stage["histogram"] = int_list_to_json(s.histogram());
+        stage["limits"]    = int_list_to_json(s.histogramLimits());
+        out += stage;
+    }
+    return out;
+}
+
+static QJsonObject link_result(const PsiMedia::NetworkImpairment &link)
+{
+    QJsonObject out;
+    out["in"]         = link.packetsIn();
+    out["delivered"]  = link.packetsDelivered();
+    out["lost"]       = link.packetsLost();
+    out["overflowed"] = link.packetsOverflowed();
+    return out;
+}
+
+BenchPair::BenchPair(const BenchConfig &benchConfig, QObject *parent) : QObject(parent), config(benchConfig)
+{
+    connect(&sendSession, &PsiMedia::RtpSession::started, this, &BenchPair::send_started);
+    connect(&sendSession, &PsiMedia::RtpSession::preferencesUpdated, this, &BenchPair::send_preferencesUpdated);
+    connect(&sendSession, &PsiMedia::RtpSession::error, this, &BenchPair::session_error);
+    connect(&sendSession, &PsiMedia::RtpSession::stopped, this, &BenchPair::session_stopped);
+    connect(&recvSession, &PsiMedia::RtpSession::started, this, &BenchPair::recv_started);
+    connect(&recvSession, &PsiMedia::RtpSession::error, this, &BenchPair::session_error);
+    connect(&recvSession, &PsiMedia::RtpSession::stopped, this, &BenchPair::session_stopped);
+
+    timer.setSingleShot(true);
+    connect(&timer, &QTimer::timeout, this, &BenchPair::timer_timeout);
+}
+
+void BenchPair::start()
+{
+    // the provider and its threads are up by now, so this is what the
+    //   sessions themselves cost
+    memoryStart = resident_memory();
+
+    result["audioCodec"] = config.audio ? config.audioCodec : QString();
+    result["videoCodec"] = config.video ? config.videoCodec : QString();
+
+    // checked by the parent already
+    if (!config.impairment.isEmpty()) {
+        audioLink.setModel(config.impairment);
+        videoLink.setModel(config.impairment);
+    }
+
+    QList<PsiMedia::AudioParams> audioParams;
+    QList<PsiMedia::VideoParams> videoParams;
+    if (config.audio) {
+        PsiMedia::AudioParams p;
+        p.setCodec(config.audioCodec);
+        p.setSampleRate(16000);
+        p.setSampleSize(16);
+        p.setChannels(1);
+        audioParams += p;
+
+        sendSession.setAudioInputDevice("virtual:audio-in");
+        recvSession.setAudioOutputDevice("virtual:audio-out");
+    }
+    if (config.video) {
+        PsiMedia::VideoParams p;
+        p.setCodec(config.videoCodec);
+        p.setSize(config.size);
+        p.setFps(config.fps);
+        videoParams += p;
+
+        sendSession.setVideoInputDevice(QString("virtual:video-in size=%1 fps=%2 pattern=%3")
+                                            .arg(size_to_string(config.size))
+                                            .arg(config.fps)
+                                            .arg(config.pattern));
+    }
+
+    sendSession.setLocalAudioPreferences(audioParams);
+    sendSession.setLocalVideoPreferences(videoParams);
+    recvSession.setLocalAudioPreferences(audioParams);
+    recvSession.setLocalVideoPreferences(videoParams);
+
+    phase = Negotiating;
+    timer.start(NEGOTIATION_TIMEOUT * 1000);
+    sendSession.start();
+}
+
+void BenchPair::send_started()
+{
+    recvSession.setRemoteAudioPreferences(sendSession.localAudioPayloadInfo());
+    recvSession.setRemoteVideoPreferences(sendSession.localVideoPayloadInfo());
+    recvSession.start();
+}
+
+void BenchPair::recv_started()
+{
+    sendSession.setRemoteAudioPreferences(recvSession.localAudioPayloadInfo());
+    sendSession.setRemoteVideoPreferences(recvSession.localVideoPayloadInfo());
+    sendSession.updatePreferences();
+}
+
+static void connect_channels(PsiMedia::RtpChannel *from, PsiMedia::RtpChannel *to)
+{
+    QObject::connect(from, &PsiMedia::RtpChannel::readyRead, to, [from, to]() {
+        while (from->packetsAvailable() > 0)
+            to->write(from->read());
+    });
+}
+
+void BenchPair::send_preferencesUpdated()
+{
+    if (phase != Negotiating)
+        return;
+
+    // media one way, rtcp feedback the other.  the impairment is only on the
+    //   way to the receiver
+    if (config.impairment.isEmpty()) {
+        connect_channels(sendSession.audioRtpChannel(), recvSession.audioRtpChannel());
+        connect_channels(sendSession.videoRtpChannel(), recvSession.videoRtpChannel());
+    } else {
+        audioLink.connectChannels(sendSession.audioRtpChannel(), recvSession.audioRtpChannel());
+        videoLink.connectChannels(sendSession.videoRtpChannel(), recvSession.videoRtpChannel());
+    }
+    connect_channels(recvSession.audioRtpChannel(), sendSession.audioRtpChannel());
+    connect_channels(recvSession.videoRtpChannel(), sendSession.videoRtpChannel());
+
+    if (config.audio)
+        sendSession.transmitAudio();
+    if (config.video)
+        sendSession.transmitVideo();
+
+    phase = Warmup;
+    timer.start(config.warmup * 1000);
+}
+
+void BenchPair::session_error()
+{
+    if (phase == Stopping || phase == Done)
+        return;
+
+    auto session = static_cast<PsiMedia::RtpSession *>(sender());
+    fail(QString("%1 session error %2")
+             .arg(session == &sendSession ? "send" : "receive")
+             .arg(int(session->errorCode())));
+}
+
+void BenchPair::session_stopped()
+{
+    if (phase == Stopping && --stopsPending == 0)
+        finish();
+}
+
+void BenchPair::timer_timeout()
+{
+    switch (phase) {
+    case Negotiating:
+        fail("timed out while negotiating");
+        break;
+    case Warmup:
+        startMeasuring();
+        break;
+    case Measuring:
+        finishMeasuring();
+        break;
+    case Stopping:
+        // good enough, the results are in
+        finish();
+        break;
+    case Done:
+        break;
+    }
+}
+
+void BenchPair::startMeasuring()
+{
+    sendAudioStart = sendSession.audioStreamMetrics();
+    sendVideoStart = sendSession.videoStreamMetrics();
+    recvAudioStart = recvSession.audioStreamMetrics();
+    recvVideoStart = recvSession.videoStreamMetrics();
+
+    // enabling resets the results, so the warmup is left out
+    sendSession.setLatencyTracingEnabled(true);
+    recvSession.setLatencyTracingEnabled(true);
+
+    cpuStart = cpu_time_us();
+    wallTime.start();
+
+    phase = Measuring;
+    timer.start(config.duration * 1000);
+}
+
+void BenchPair::finishMeasuring()
+{
+    qint64 wall   = wallTime.nsecsElapsed() / 1000;
+    qint64 cpu    = cpu_time_us() - cpuStart;
+    qint64 memory = resident_memory();
+
+    result["duration"] = double(wall) / 1000000;
+    result["cpuTime"]  = double(cpu) / 1000000;
+    result["memory"]   = memoryStart >= 0 && memory >= 0 ? memory - memoryStart : qint64(-1);
+    result["streams"]  = int(config.audio) + int(config.video);
+
+    if (config.audio)
+        result["audio"] = stream_result(sendAudioStart, sendSession.audioStreamMetrics(), recvAudioStart,
+                                        recvSession.audioStreamMetrics());
+    if (config.video)
+        result["video"] = stream_result(sendVideoStart, sendSession.videoStreamMetrics(), recvVideoStart,
+                                        recvSession.videoStreamMetrics());
+
+    result["latency"] = latency_to_json(sendSession.latencyStages() + recvSession.latencyStages());
+
+    // since the media started flowing, warmup included
+    if (!config.impairment.isEmpty()) {
+        QJsonObject impairment;
+        impairment["model"]  = audioLink.model();
+        impairment["audio"]  = link_result(audioLink);
+        impairment["video"]  = link_result(videoLink);
+        result["impairment"] = impairment;
+    }
+
+    stopSessions();
+}
+
+void BenchPair::fail(const QString &reason)
+{
+    result["error"] = reason;
+    stopSessions();
+}
+
+void BenchPair::stopSessions()
+{
+    phase        = Stopping;
+    stopsPending = 2;
+    timer.start(STOP_TIMEOUT * 1000);
+    sendSession.stop();
+    recvSession.stop();
+}
+
+void BenchPair::finish()
+{
+    phase = Done;
+    timer.stop();
+    emit finished(result);
+}
+
+//----------------------------------------------------------------------------
+// BenchReplay
+//----------------------------------------------------------------------------
+static QJsonObject receive_result(const PsiMedia::StreamMetrics &m)
+{
+    QJsonObject out;
+    if (m.isNull())
+        return out;
+
+    out["packetsReceived"] = m.packetsReceived();
+    out["bytesReceived"]   = m.bytesReceived();
+    out["jitter"]          = m.jitter();
+    out["framesDecoded"]   = m.framesDecoded();
+    out["decodeTime"]      = m.decodeTime();
+    return out;
+}
+
+BenchReplay::BenchReplay(const QString &_fileName, PsiMedia::RtpReplay::Timing _timing, QObject *parent) :
+    QObject(parent), fileName(_fileName), timing(_timing)
+{
+    connect(&session, &PsiMedia::RtpSession::started, this, &BenchReplay::session_started);
+    connect(&session, &PsiMedia::RtpSession::error, this, &BenchReplay::session_error);
+    connect(&session, &PsiMedia::RtpSession::stopped, this, &BenchReplay::session_stopped);
+    connect(&replay, &PsiMedia::RtpReplay::finished, this, &BenchReplay::replay_finished);
+
+    timer.setSingleShot(true);
+    connect(&timer, &QTimer::timeout, this, &BenchReplay::timer_timeout);
+}
+
+void BenchReplay::start()
+{
+    result["capture"] = fileName;
+    result["timing"]  = QString(timing == PsiMedia::RtpReplay::AsFastAsPossible ? "fast" : "original");
+
+    if (!replay.open(fileName)) {
+        result["error"] = QString("can't read the capture");
+        finish();
+        return;
+    }
+
+    // the receiving session needs the payload info the recorded one had
+    //   from its remote side, and local preferences for the same codecs
+    QList<PsiMedia::PayloadInfo> audioInfo = replay.audioPayloadInfo(PsiMedia::RtpReplay::Received);
+    QList<PsiMedia::PayloadInfo> videoInfo = replay.videoPayloadInfo(PsiMedia::RtpReplay::Received);
+    if (audioInfo.isEmpty() && videoInfo.isEmpty()) {
+        result["error"] = QString("the capture has no received media");
+        finish();
+        return;
+    }
+
+    QList<PsiMedia::AudioParams> audioParams;
+    QList<PsiMedia::VideoParams> videoParams;
+    for (const PsiMedia::PayloadInfo &pi : audioInfo) {
+        PsiMedia::AudioParams p;
+        p.setCodec(pi.name().toLower());
+        p.setSampleRate(pi.clockrate());
+        p.setSampleSize(16);
+        p.setChannels(qMax(1, pi.channels()));
+        audioParams += p;
+    }
+    for (const PsiMedia::PayloadInfo &pi : videoInfo) {
+        PsiMedia::VideoParams p;
+        p.setCodec(pi.name().toLower());
+        p.setSize(QSize(640, 480));
+        p.setFps(30);
+        videoParams += p;
+    }
+    if (!audioInfo.isEmpty())
+        session.setAudioOutputDevice("virtual:audio-out");
+
+    result["packets"]  = replay.packetCount(PsiMedia::RtpReplay::Received);
+    result["recorded"] = double(replay.duration()) / 1000000;
+
+    session.setLocalAudioPreferences(audioParams);
+    session.setLocalVideoPreferences(videoParams);
+    session.setRemoteAudioPreferences(audioInfo);
+    session.setRemoteVideoPreferences(videoInfo);
+
+    phase = Negotiating;
+    timer.start(NEGOTIATION_TIMEOUT * 1000);
+    session.start();
+}
+
+void BenchReplay::session_started()
+{
+    session.setLatencyTracingEnabled(true);
+    cpuStart = cpu_time_us();
+    wallTime.start();
+
+    phase = Replaying;
+    timer.stop();
+    replay.start(session.audioRtpChannel(), session.videoRtpChannel(), PsiMedia::RtpReplay::Received, timing);
+}
+
+void BenchReplay::session_error()
+{
+    if (phase == Stopping || phase == Done)
+        return;
+    fail(QString("session error %1").arg(int(session.errorCode())));
+}
+
+void BenchReplay::session_stopped()
+{
+    if (phase == Stopping)
+        finish();
+}
+
+void BenchReplay::replay_finished()
+{
+    phase = Draining;
+    timer.start(DRAIN_TIME * 1000);
+}
+
+void BenchReplay::timer_timeout()
+{
+    switch (phase) {
+    case Negotiating:
+        fail("timed out while starting");
+        break;
+    case Draining:
+        collect();
+        stopSession();
+        break;
+    case Stopping:
+        finish();
+        break;
+    case Replaying:
+    case Done:
+        break;
+    }
+}
+
+void BenchReplay::collect()
+{
+    qint64 wall = wallTime.nsecsElapsed() / 1000;
+    qint64 cpu  = cpu_time_us() - cpuStart;
+
+    // the drain time included, the decoders are busy for part of it
+    result["duration"] = double(wall) / 1000000;
+    result["cpuTime"]  = double(cpu) / 1000000;
+    result["replayed"] = replay.packetsReplayed();
+    result["audio"]    = receive_result(session.audioStreamMetrics());
+    result["video"]    = receive_result(session.videoStreamMetrics());
+    result["latency"]  = latency_to_json(session.latencyStages());
+}
+
+void BenchReplay::fail(const QString &reason)
+{
+    result["error"] = reason;
+    stopSession();
+}
+
+void BenchReplay::stopSession()
+{
+    replay.stop();
+    phase = Stopping;
+    timer.start(STOP_TIMEOUT * 1000);
+    session.stop();
+}
+
+void BenchReplay::finish()
+{
+    phase = Done;
+    timer.stop();
+    emit finished(result);
+}
+
+//----------------------------------------------------------------------------
+// Runs
+//----------------------------------------------------------------------------
+class MergedStage {
+public:
+    QString    stream;
+    QString    name;
+    qint64     count = 0;
+    double     total = 0; // us
+    int        max   = 0; // us
+    QList<int> histogram;
+    QList<int> limits;
+};
+
+// upper limit of the histogram bucket holding the given fraction of the
+//   measurements.  the last bucket is open, so max stands in for it
+static int histogram_percentile(const MergedStage &s, double fraction)
+{
+    qint64 total = 0;
+    for (int n : s.histogram)
+        total += n;
+    if (total == 0)
+        return 0;
+
+    qint64 wanted = qint64(qCeil(total * fraction));
+    qint64 seen   = 0;
+    for (int n = 0; n < s.histogram.count(); ++n) {
+        seen += s.histogram[n];
+        if (seen >= wanted)
+            return n < s.limits.count() ? qMin(s.limits[n], s.max) : s.max;
+    }
+    return s.max;
+}
+
+static void merge_stage(QList<MergedStage> *stages, const QJsonObject &in)
+{
+    QString stream = in["stream"].toString();
+    QString name   = in["name"].toString();
+
+    int at = 0;
+    while (at < stages->count() && ((*stages)[at].stream != stream || (*stages)[at].name != name))
+        ++at;
+    if (at == stages->count()) {
+        MergedStage s;
+        s.stream = stream;
+        s.name   = name;
+        *stages += s;
+    }
+
+    MergedStage &s     = (*stages)[at];
+    int          count = in["count"].toInt();
+    s.count += count;
+    s.total += double(in["mean"].toInt()) * count;
+    s.max = qMax(s.max, in["max"].toInt());
+
+    QJsonArray histogram = in["histogram"].toArray();
+    while (s.histogram.count() < histogram.count())
+        s.histogram += 0;
+    for (int n = 0; n < histogram.count(); ++n)
+        s.histogram[n] += histogram[n].toInt();
+    if (s.limits.isEmpty()) {
+        for (const QJsonValue &v : in["limits"].toArray())
+            s.limits += v.toInt();
+    }
+}
+
+// per stream, the stages and what they add up to.  means add up exactly,
+//   the sum of the maxima is an upper bound
+static QJsonObject latency_summary(const QList<MergedStage> &stages)
+{
+    QJsonObject out;
+    for (const MergedStage &s : stages) {
+        QJsonObject stream = out[s.stream].toObject();
+        int         mean   = s.count > 0 ? int(s.total / s.count) : 0;
+
+        QJsonObject stage;
+        stage["name"]  = s.name;
+        stage["count"] = s.count;
+        stage["mean"]  = mean;
+        stage["p50"]   = histogram_percentile(s, 0.50);
+        stage["p95"]   = histogram_percentile(s, 0.95);
+        stage["p99"]   = histogram_percentile(s, 0.99);
+        stage["max"]   = s.max;
+
+        QJsonArray list = stream["stages"].toArray();
+        list += stage;
+        stream["stages"]   = list;
+        stream["mean"]     = stream["mean"].toInt() + mean;
+        stream["maxBound"] = stream["maxBound"].toInt() + s.max;
+        out[s.stream]      = stream;
+    }
+    return out;
+}
+
+static QJsonObject summarize(const BenchConfig &config, const QList<QJsonObject> &pairs)
+{
+    QJsonObject run;
+    run["audioCodec"] = config.audio ? config.audioCodec : QString();
+    run["videoCodec"] = config.video ? config.videoCodec : QString();
+    run["size"]       = config.video ? size_to_string(config.size) : QString();
+    run["fps"]        = config.fps;
+    run["pattern"]    = config.pattern;
+    run["sessions"]   = config.sessions;
+    run["impairment"] = config.impairment;
+
+    QJsonArray         errors;
+    QList<MergedStage> stages;
+    QJsonObject        rates;
+    double             cpuPerStream = 0;
+    qint64             memory       = 0;
+    int                ok = 0, memoryKnown = 0;
+    for (const QJsonObject &pair : pairs) {
+        if (pair.contains("error")) {
+            errors += pair["error"];
+            continue;
+        }
+        ++ok;
+
+        double duration = pair["duration"].toDouble();
+        if (duration > 0) {
+            for (const QString &type : { QString("audio"), QString("video") }) {
+                QJsonObject stream = pair[type].toObject();
+                for (const QString &key : { QString("packetsSent"), QString("packetsReceived"),
+                                            QString("packetsDropped"), QString("framesDecoded") }) {
+                    if (stream.contains(key)) {
+                        QString name = type + key.left(1).toUpper() + key.mid(1);
+                        rates[name]  = rates[name].toDouble() + stream[key].toDouble() / duration;
+                    }
+                }
+            }
+            int streams = qMax(1, pair["streams"].toInt());
+            cpuPerStream += pair["cpuTime"].toDouble() / duration * 100 / streams;
+        }
+
+        if (pair["memory"].toDouble() >= 0) {
+            memory += qint64(pair["memory"].toDouble());
+            ++memoryKnown;
+        }
+
+        for (const QJsonValue &v : pair["latency"].toArray())
+            merge_stage(&stages, v.toObject());
+    }
+
+    run["failed"] = pairs.count() - ok;
+    if (!errors.isEmpty())
+        run["errors"] = errors;
+
+    // totals over all sessions of the run, per second
+    run["rates"] = rates;
+
+    // percent of one core, averaged over the sessions.  a stream is one
+    //   media type of a pair, so it covers both its encoding and decoding
+    run["cpuPerStream"]     = ok > 0 ? cpuPerStream / ok : 0.0;
+    run["memoryPerSession"] = memoryKnown > 0 ? memory / memoryKnown : qint64(-1);
+    run["latency"]          = latency_summary(stages);
+    return run;
+}
+
+static QJsonObject run_sessions(const BenchConfig &config)
+{
+    QList<QProcess *> processes;
+    for (int n = 0; n < config.sessions; ++n) {
+        auto p = new QProcess;
+        // the pairs' diagnostics go straight to our stderr, their results
+        //   come back on stdout
+        p->setProcessChannelMode(QProcess::ForwardedErrorChannel);
+        p->start(QCoreApplication::applicationFilePath(), config.pairArguments());
+        processes += p;
+    }
+
+    int                wait = (NEGOTIATION_TIMEOUT + config.warmup + config.duration + STOP_TIMEOUT + 10) * 1000;
+    QList<QJsonObject> results;
+    for (QProcess *p : processes) {
+        if (!p->waitForFinished(wait)) {
+            p->kill();
+            p->waitForFinished();
+        }
+
+        QJsonObject result = QJsonDocument::fromJson(p->readAllStandardOutput()).object();
+        if (result.isEmpty())
+            result["error"] = QString("pair process gave no result");
+        results += result;
+        delete p;
+    }
+
+    return summarize(config, results);
+}
+
+//----------------------------------------------------------------------------
+// main
+//----------------------------------------------------------------------------
+#ifdef GSTPROVIDER_STATIC
+Q_IMPORT_PLUGIN(gstprovider)
+#endif
+
+#ifndef GSTPROVIDER_STATIC
+static QString findPlugin(const QString &relpath, const QString &basename)
+{
+    QDir dir(QCoreApplication::applicationDirPath());
+    if (!dir.cd(relpath))
+        return QString();
+    foreach (const QString &fileName, dir.entryList()) {
+        if (fileName.contains(basename)) {
+            QString filePath = dir.filePath(fileName);
+            if (QLibrary::isLibrary(filePath))
+                return filePath;
+        }
+    }
+    return QString();
+}
+
+static void loadProvider()
+{
+    QString pluginFile = qgetenv("PSI_MEDIA_PLUGIN");
+    if (pluginFile.isEmpty())
+        pluginFile = findPlugin("../gstprovider", "gstprovider" DEBUG_POSTFIX);
+    if (pluginFile.isEmpty())
+        pluginFile = findPlugin(".", "gstprovider" DEBUG_POSTFIX);
+#ifdef PLUGIN_INSTALL_PATH
+    if (pluginFile.isEmpty())
+        pluginFile = findPlugin(PLUGIN_INSTALL_PATH, "gstprovider" DEBUG_POSTFIX);
+#endif
+#ifdef PLUGIN_INSTALL_PATH_DEBUG
+    if (pluginFile.isEmpty())
+        pluginFile = findPlugin(PLUGIN_INSTALL_PATH_DEBUG, "gstprovider" DEBUG_POSTFIX);
+#endif
+
+    PsiMedia::loadPlugin(pluginFile, QString());
+}
+#endif
+
+// trimmed, without empty entries
+static QStringList split_list(const QString &str)
+{
+#if QT_VERSION >= QT_VERSION_CHECK(5, 14, 0)
+    QStringList parts = str.split(',', Qt::SkipEmptyParts);
+#else
+    QStringList parts = str.split(',', QString::SkipEmptyParts);
+#endif
+    QStringList out;
+    for (const QString &s : qAsConst(parts)) {
+        if (!s.trimmed().isEmpty())
+            out += s.trimmed();
+    }
+    return out;
+}
+
+static QList<int> parse_int_list(const QString &str)
+{
+    QList<int> out;
+    for (const QString &s : split_list(str)) {
+        int n = s.trimmed().toInt();
+        if (n > 0)
+            out += n;
+    }
+    return out;
+}
+
+int main(int argc, char **argv)
+{
+    QCoreApplication qapp(argc, argv);
+
+    QCoreApplication::setOrganizationName("psi-im.org");
+    QCoreApplication::setApplicationName("psimedia-bench");
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Headless loopback benchmark of the PsiMedia provider. Each session sends "
+                                     "test audio and video to a second session in the same process. The results "
+                                     "are written as json.");
+    parser.addHelpOption();
+
+    QCommandLineOption audioCodecOption("audio-codec", "Comma separated audio codecs (default opus).", "codecs",
+                                        "opus");
+    QCommandLineOption videoCodecOption("video-codec", "Comma separated video codecs (default theora).", "codecs",
+                                        "theora");
+    QCommandLineOption sizesOption("sizes", "Comma separated video sizes (default 320x240,640x480,1280x720).",
+                                   "sizes", "320x240,640x480,1280x720");
+    QCommandLineOption sessionsOption("sessions", "Comma separated numbers of concurrent sessions (default 1,2,4).",
+                                      "counts", "1,2,4");
+    QCommandLineOption fpsOption("fps", "Video frame rate (default 30).", "fps", "30");
+    QCommandLineOption patternOption("pattern", "videotestsrc pattern, which sets the content complexity "
+                                                "(default ball).",
+                                     "pattern", "ball");
+    QCommandLineOption warmupOption("warmup", "Seconds to run before measuring (default 3).", "seconds", "3");
+    QCommandLineOption durationOption("duration", "Seconds to measure (default 10).", "seconds", "10");
+    QCommandLineOption noAudioOption("no-audio", "Don't send audio.");
+    QCommandLineOption noVideoOption("no-video", "Don't send video.");
+    QCommandLineOption impairmentOption("impairment",
+                                        "Network impairment model between the sessions, see NetworkImpairment "
+                                        "(for example \"loss=0.02 delay=50 jitter=10 seed=1\").",
+                                        "model");
+    QCommandLineOption replayOption("replay",
+                                    "Instead of running pairs, play the received rtp of a capture (see "
+                                    "RtpSession::setRtpCaptureFile) into a receiving session and measure it.",
+                                    "file");
+    QCommandLineOption replayFastOption("replay-fast", "Replay as fast as possible, not at the recorded timing.");
+    QCommandLineOption outputOption("output", "Write the results to file instead of stdout.", "file");
+    QCommandLineOption pairOption("pair",
+                                  "Run a single pair of the first codecs and size and print its raw result.");
+    parser.addOptions({ audioCodecOption, videoCodecOption, sizesOption, sessionsOption, fpsOption, patternOption,
+                        warmupOption, durationOption, noAudioOption, noVideoOption, impairmentOption, replayOption,
+                        replayFastOption, outputOption, pairOption });
+    parser.process(qapp);
+
+    BenchConfig config;
+    config.pattern    = parser.value(patternOption);
+    config.fps        = qMax(1, parser.value(fpsOption).toInt());
+    config.warmup     = qMax(0, parser.value(warmupOption).toInt());
+    config.duration   = qMax(1, parser.value(durationOption).toInt());
+    config.audio      = !parser.isSet(noAudioOption);
+    config.video      = !parser.isSet(noVideoOption);
+    config.impairment = parser.value(impairmentOption);
+
+    QList<QSize> sizes;
+    for (const QString &s : split_list(parser.value(sizesOption))) {
+        QSize size = string_to_size(s.trimmed());
+        if (size.isValid() && !size.isEmpty())
+            sizes += size;
+    }
+    QList<int>  sessionCounts = parse_int_list(parser.value(sessionsOption));
+    QStringList audioCodecs   = split_list(parser.value(audioCodecOption));
+    QStringList videoCodecs   = split_list(parser.value(videoCodecOption));
+    if (sizes.isEmpty() || sessionCounts.isEmpty() || audioCodecs.isEmpty() || videoCodecs.isEmpty()
+        || (!config.audio && !config.video)) {
+        fprintf(stderr, "Nothing to run.\n");
+        return 1;
+    }
+    if (!config.impairment.isEmpty() && !PsiMedia::NetworkImpairment().setModel(config.impairment)) {
+        fprintf(stderr, "Bad impairment model.\n");
+        return 1;
+    }
+
+    if (parser.isSet(pairOption)) {
+#ifndef GSTPROVIDER_STATIC
+        loadProvider();
+#endif
+        QJsonObject result;
+        if (!PsiMedia::isSupported()) {
+            result["error"] = QString("could not load the PsiMedia provider");
+        } else {
+            config.audioCodec = audioCodecs.first();
+            config.videoCodec = videoCodecs.first();
+            config.size       = sizes.first();
+            BenchPair pair(config);
+            QObject::connect(&pair, &BenchPair::finished, [&result](const QJsonObject &r) {
+                result = r;
+                QCoreApplication::quit();
+            });
+            QTimer::singleShot(0, &pair, &BenchPair::start);
+            QCoreApplication::exec();
+        }
+
+        QByteArray out = QJsonDocument(result).toJson(QJsonDocument::Compact);
+        fwrite(out.constData(), 1, size_t(out.size()), stdout);
+        return result.contains("error") ? 1 : 0;
+    }
+
+    QJsonObject report;
+    report["benchmark"] = QString("psimedia-bench");
+    report["version"]   = 1;
+    report["date"]      = QDateTime::currentDateTimeUtc().toString(Qt::ISODate);
+
+    if (parser.isSet(replayOption)) {
+        // a single receiving session, so it can run in this process
+#ifndef GSTPROVIDER_STATIC
+        loadProvider();
+#endif
+        QJsonObject result;
+        if (!PsiMedia::isSupported()) {
+            result["error"] = QString("could not load the PsiMedia provider");
+        } else {
+            auto        timing = parser.isSet(replayFastOption) ? PsiMedia::RtpReplay::AsFastAsPossible
+                                                                : PsiMedia::RtpReplay::OriginalTiming;
+            BenchReplay replay(parser.value(replayOption), timing);
+            QObject::connect(&replay, &BenchReplay::finished, [&result](const QJsonObject &r) {
+                result = r;
+                QCoreApplication::quit();
+            });
+            QTimer::singleShot(0, &replay, &BenchReplay::start);
+            QCoreApplication::exec();
+        }
+        report["replay"] = result;
+    } else {
+        // the provider is only loaded by the pair processes
+        QJsonArray runs;
+        // a media type that isn't sent makes its codecs and the size no
+        //   difference
+        for (const QString &audioCodec : config.audio ? audioCodecs : audioCodecs.mid(0, 1)) {
+            for (const QString &videoCodec : config.video ? videoCodecs : videoCodecs.mid(0, 1)) {
+                for (int sessions : sessionCounts) {
+                    for (const QSize &size : config.video ? sizes : sizes.mid(0, 1)) {
+                        BenchConfig run = config;
+                        run.audioCodec  = audioCodec;
+                        run.videoCodec  = videoCodec;
+                        run.size        = size;
+                        run.sessions    = sessions;
+                        fprintf(stderr, "running %d session(s) of %s/%s at %s\n", sessions, qPrintable(audioCodec),
+                                qPrintable(videoCodec), qPrintable(size_to_string(size)));
+                        runs += run_sessions(run);
+                    }
+                }
+            }
+        }
+        report["runs"] = runs;
+    }
+    QByteArray out = QJsonDocument(report).toJson();
+
+    if (parser.isSet(outputOption)) {
+        QFile file(parser.value(outputOption));
+        if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate) || file.write(out) != out.size()) {
+            fprintf(stderr, "Can't write %s.\n", qPrintable(parser.value(outputOption)));
+            return 1;
+        }
+    } else
+        fwrite(out.constData(), 1, size_t(out.size()), stdout);
+
+    return report["replay"].toObject().contains("error") ? 1 : 0;
+}
@@ -0,0 +1,139 @@
+/*
+ * Copyright (C) 2026  Psi IM Team
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301  USA
+ *
+ */
+
+#ifndef PSIMEDIA_BENCH_MAIN_H
+#define PSIMEDIA_BENCH_MAIN_H
+
+#include <QElapsedTimer>
+#include <QJsonObject>
+#include <QSize>
+#include <QStringList>
+#include <QTimer>
+
+#include <networkimpairment.h>
+#include <psimedia.h>
+#include <rtpreplay.h>
+
+class BenchConfig {
+public:
+    QString audioCodec = "opus";
+    QString videoCodec = "theora";
+    QString pattern    = "ball"; // of videotestsrc
+    QSize   size       = QSize(640, 480);
+    int     fps        = 30;
+    int     sessions   = 1;
+    int     warmup     = 3;  // seconds
+    int     duration   = 10; // seconds
+    bool    audio      = true;
+    bool    video      = true;
+    QString impairment; // NetworkImpairment model on the way to the receiver
+
+    // command line of a pair process running this configuration
+    QStringList pairArguments() const;
+};
+
+// one sending and one receiving session, wired back to back through their
+//   rtp channels.  the provider only runs one send and one receive pipeline
+//   per process, so every pair of a run lives in a process of its own
+class BenchPair : public QObject {
+    Q_OBJECT
+
+public:
+    explicit BenchPair(const BenchConfig &benchConfig, QObject *parent = nullptr);
+
+    void start();
+
+signals:
+    // the measurements of the pair, with "error" set if it failed
+    void finished(const QJsonObject &result);
+
+private slots:
+    void send_started();
+    void send_preferencesUpdated();
+    void recv_started();
+    void session_error();
+    void session_stopped();
+    void timer_timeout();
+
+private:
+    enum Phase { Negotiating, Warmup, Measuring, Stopping, Done };
+
+    BenchConfig                 config;
+    PsiMedia::RtpSession        sendSession;
+    PsiMedia::RtpSession        recvSession;
+    PsiMedia::NetworkImpairment audioLink;
+    PsiMedia::NetworkImpairment videoLink;
+    Phase                       phase = Negotiating;
+    QTimer                      timer;
+    QElapsedTimer               wallTime;
+    qint64                      cpuStart     = 0;
+    qint64                      memoryStart  = -1;
+    int                         stopsPending = 0;
+    PsiMedia::StreamMetrics     sendAudioStart, sendVideoStart, recvAudioStart, recvVideoStart;
+    QJsonObject                 result;
+
+    void startMeasuring();
+    void finishMeasuring();
+    void fail(const QString &reason);
+    void stopSessions();
+    void finish();
+};
+
+// one receiving session fed from an rtp capture, to measure the receive
+//   side of a recorded call
+class BenchReplay : public QObject {
+    Q_OBJECT
+
+public:
+    BenchReplay(const QString &fileName, PsiMedia::RtpReplay::Timing timing, QObject *parent = nullptr);
+
+    void start();
+
+signals:
+    // the measurements, with "error" set if it failed
+    void finished(const QJsonObject &result);
+
+private slots:
+    void session_started();
+    void session_error();
+    void session_stopped();
+    void replay_finished();
+    void timer_timeout();
+
+private:
+    enum Phase { Negotiating, Replaying, Draining, Stopping, Done };
+
+    QString                     fileName;
+    PsiMedia::RtpReplay::Timing timing;
+    PsiMedia::RtpSession        session;
+    PsiMedia::RtpReplay         replay;
+    Phase                       phase = Negotiating;
+    QTimer                      timer;
+    QElapsedTimer               wallTime;
+    qint64                      cpuStart = 0;
+    QJsonObject                 result;
+
+    void collect();
+    void fail(const QString &reason);
+    void stopSession();
+    void finish();
+};
+
+#endif // PSIMEDIA_BENCH_MAIN_H
@@ -0,0 +1,600 @@
+/*
+ * Copyright (C) 2026  Psi IM Team
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301  USA
+ *
+ */
+
+#include "gstrtpchannel.h"
+#include "gstthread.h"
+#include "payloadinfo.h"
+#include "rtpworker.h"
+#include "rwcontrol.h"
+
+#include <QCommandLineParser>
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QEventLoop>
+#include <QFile>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QThread>
+#include <cerrno>
+#include <cstdio>
+#include <functional>
+#include <gst/app/gstappsrc.h>
+
+// count the allocations of the measuring thread by wrapping the glibc
+//   allocator.  that covers g_malloc, g_slice and operator new as well
+#ifdef __GLIBC__
+#define COUNT_ALLOCATIONS
+
+extern "C" {
+void *__libc_malloc(size_t size);
+void *__libc_calloc(size_t count, size_t size);
+void *__libc_realloc(void *ptr, size_t size);
+void *__libc_memalign(size_t alignment, size_t size);
+}
+
+static thread_local quint64 allocations = 0;
+
+extern "C" void *malloc(size_t size) noexcept
+{
+    ++allocations;
+    return __libc_malloc(size);
+}
+
+extern "C" void *calloc(size_t count, size_t size) noexcept
+{
+    ++allocations;
+    return __libc_calloc(count, size);
+}
+
+extern "C" void *realloc(void *ptr, size_t size) noexcept
+{
+    ++allocations;
+    return __libc_realloc(ptr, size);
+}
+
+extern "C" void *memalign(size_t alignment, size_t size) noexcept
+{
+    ++allocations;
+    return __libc_memalign(alignment, size);
+}
+
+extern "C" void *aligned_alloc(size_t alignment, size_t size) noexcept
+{
+    ++allocations;
+    return __libc_memalign(alignment, size);
+}
+
+extern "C" int posix_memalign(void **ptr, size_t alignment, size_t size) noexcept
+{
+    ++allocations;
+    void *p = __libc_memalign(alignment, size);
+    if (!p)
+        return ENOMEM;
+    *ptr = p;
+    return 0;
+}
+
+static quint64 allocation_count() { return allocations; }
+#else
+static quint64 allocation_count() { return 0; }
+#endif
+
+namespace PsiMedia {
+
+//----------------------------------------------------------------------------
+// Measure
+//----------------------------------------------------------------------------
+// accumulates the time and allocations of the measured parts of a benchmark.
+//   setup done between end() and begin() is left out
+class Measure {
+public:
+    qint64 ops         = 0;
+    qint64 nsecs       = 0;
+    qint64 allocations = 0;
+
+    void begin()
+    {
+        allocStart = allocation_count();
+        timer.start();
+    }
+
+    void end(int count)
+    {
+        nsecs += timer.nsecsElapsed();
+        allocations += qint64(allocation_count() - allocStart);
+        ops += count;
+    }
+
+private:
+    QElapsedTimer timer;
+    quint64       allocStart = 0;
+};
+
+//----------------------------------------------------------------------------
+// FakeSampleSource
+//----------------------------------------------------------------------------
+// appsrc ! appsink, to feed the appsink callbacks without a real pipeline.
+//   fill() leaves the samples queued in the appsink, so pulling them doesn't
+//   wait for anything
+class FakeSampleSource {
+public:
+    FakeSampleSource()
+    {
+        pipeline = gst_pipeline_new(nullptr);
+        src      = gst_element_factory_make("appsrc", nullptr);
+        sink     = gst_element_factory_make("appsink", nullptr);
+        g_object_set(G_OBJECT(src), "format", GST_FORMAT_TIME, nullptr);
+        g_object_set(G_OBJECT(sink), "sync", FALSE, "wait-on-eos", FALSE, nullptr);
+        gst_bin_add_many(GST_BIN(pipeline), src, sink, nullptr);
+        gst_element_link(src, sink);
+    }
+
+    ~FakeSampleSource()
+    {
+        gst_element_set_state(pipeline, GST_STATE_NULL);
+        gst_object_unref(pipeline);
+    }
+
+    FakeSampleSource(const FakeSampleSource &) = delete;
+    FakeSampleSource &operator=(const FakeSampleSource &) = delete;
+
+    GstAppSink *appSink() const { return GST_APP_SINK(sink); }
+
+    // queues count copies of buffer, sharing its memory
+    bool fill(GstCaps *caps, GstBuffer *buffer, int count)
+    {
+        gst_element_set_state(pipeline, GST_STATE_NULL);
+        gst_app_src_set_caps(GST_APP_SRC(src), caps);
+        gst_element_set_state(pipeline, GST_STATE_PLAYING);
+
+        for (int n = 0; n < count; ++n) {
+            GstBuffer *copy      = gst_buffer_copy(buffer);
+            GST_BUFFER_PTS(copy) = GST_MSECOND * 20 * guint64(n);
+            gst_app_src_push_buffer(GST_APP_SRC(src), copy);
+        }
+        gst_app_src_end_of_stream(GST_APP_SRC(src));
+
+        // with wait-on-eos off, eos is posted once everything is queued
+        GstBus *    bus = gst_element_get_bus(pipeline);
+        GstMessage *msg
+            = gst_bus_timed_pop_filtered(bus, 10 * GST_SECOND, GstMessageType(GST_MESSAGE_EOS | GST_MESSAGE_ERROR));
+        gst_object_unref(bus);
+
+        bool ok = msg && GST_MESSAGE_TYPE(msg) == GST_MESSAGE_EOS;
+        if (msg)
+            gst_message_unref(msg);
+        return ok;
+    }
+
+private:
+    GstElement *pipeline;
+    GstElement *src;
+    GstElement *sink;
+};
+
+static QByteArray make_rtp_packet(int payloadSize)
+{
+    QByteArray packet(12 + payloadSize, 0x55);
+    packet[0] = char(0x80); // version 2
+    packet[1] = char(96);
+    return packet;
+}
+
+static GstBuffer *make_buffer(const QByteArray &data)
+{
+    GstBuffer *buffer = gst_buffer_new_allocate(nullptr, gsize(data.size()), nullptr);
+    gst_buffer_fill(buffer, 0, data.constData(), gsize(data.size()));
+    return buffer;
+}
+
+static PPayloadInfo make_opus_payload_info()
+{
+    PPayloadInfo info;
+    info.id        = 97;
+    info.name      = "OPUS";
+    info.clockrate = 48000;
+    info.channels  = 2;
+    info.ptime     = 20;
+    info.maxptime  = 120;
+    for (const char *name : { "minptime", "useinbandfec", "stereo" }) {
+        PPayloadInfo::Parameter p;
+        p.name  = name;
+        p.value = "1";
+        info.parameters += p;
+    }
+    return info;
+}
+
+//----------------------------------------------------------------------------
+// MicroBench
+//----------------------------------------------------------------------------
+// the per packet and per frame primitives of the provider, each driven on
+//   its own.  every benchmark function runs one batch and returns false if
+//   it couldn't
+class MicroBench {
+public:
+    typedef std::function<bool(Measure *)> Batch;
+
+    class Benchmark {
+    public:
+        QString name;
+        Batch   batch;
+    };
+
+    QList<Benchmark> benchmarks;
+
+    explicit MicroBench(GstMainLoop *loop) : loop_(loop)
+    {
+        worker                 = new RtpWorker(loop_->mainContext());
+        worker->cb_rtpAudioOut = [](const PRtpPacket &, void *) {};
+        worker->rtpaudioout    = true;
+        control                = new RwControlLocal(loop_);
+        channel.setEnabled(true);
+        directChannel.setEnabled(true);
+        directChannel.setReadCallback([](const PRtpPacket &) {});
+
+        add("makeGstBuffer/172", [this](Measure *m) { return makeGstBuffer(m, 160); });
+        add("makeGstBuffer/1200", [this](Measure *m) { return makeGstBuffer(m, 1188); });
+        add("packet_ready_rtp_audio", [this](Measure *m) { return packetReadyRtpAudio(m); });
+        add("Frame::pullFromSink/320x240", [this](Measure *m) { return pullFromSink(m, QSize(320, 240)); });
+        add("Frame::pullFromSink/640x480", [this](Measure *m) { return pullFromSink(m, QSize(640, 480)); });
+        add("Frame::pullFromSink/1280x720", [this](Measure *m) { return pullFromSink(m, QSize(1280, 720)); });
+        add("GstRtpChannel::push_packet_for_read/queued", [this](Measure *m) { return channelQueued(m); });
+        add("GstRtpChannel::push_packet_for_read/direct", [this](Measure *m) { return channelDirect(m); });
+        add("RwControlLocal::postMessage/intensity", [this](Measure *m) { return postIntensity(m); });
+        add("RwControlLocal::postMessage/frame", [this](Measure *m) { return postFrame(m); });
+        add("payloadInfoToStructure", [this](Measure *m) { return toStructure(m); });
+        add("structureToPayloadInfo", [this](Measure *m) { return fromStructure(m); });
+    }
+
+    ~MicroBench()
+    {
+        // the remote side goes away in the glib thread, which is still up
+        delete control;
+        delete worker;
+    }
+
+    MicroBench(const MicroBench &) = delete;
+    MicroBench &operator=(const MicroBench &) = delete;
+
+private:
+    GstMainLoop *    loop_;
+    RtpWorker *      worker;
+    RwControlLocal * control;
+    GstRtpChannel    channel;
+    GstRtpChannel    directChannel;
+    FakeSampleSource source;
+
+    void add(const QString &name, const Batch &batch) { benchmarks += Benchmark { name, batch }; }
+
+    // includes freeing the buffer, which the appsrc does in real life
+    bool makeGstBuffer(Measure *m, int payloadSize)
+    {
+        PRtpPacket packet;
+        packet.rawValue = make_rtp_packet(payloadSize);
+
+        m->begin();
+        for (int n = 0; n < 1000; ++n)
+            gst_buffer_unref(RtpWorker::makeGstBuffer(packet));
+        m->end(1000);
+        return true;
+    }
+
+    bool packetReadyRtpAudio(Measure *m)
+    {
+        GstCaps *  caps   = gst_caps_new_empty_simple("application/x-rtp");
+        GstBuffer *buffer = make_buffer(make_rtp_packet(160));
+        bool       ok     = source.fill(caps, buffer, 1000);
+        gst_buffer_unref(buffer);
+        gst_caps_unref(caps);
+        if (!ok)
+            return false;
+
+        m->begin();
+        for (int n = 0; n < 1000; ++n)
+            worker->packet_ready_rtp_audio(source.appSink());
+        m->end(1000);
+        return true;
+    }
+
+    bool pullFromSink(Measure *m, const QSize &size)
+    {
+        GstCaps *caps = gst_caps_new_simple("video/x-raw", "format", G_TYPE_STRING, "BGRx", "width", G_TYPE_INT,
+                                            size.width(), "height", G_TYPE_INT, size.height(), "framerate",
+                                            GST_TYPE_FRACTION, 30, 1, nullptr);
+        GstBuffer *buffer = gst_buffer_new_allocate(nullptr, gsize(size.width() * size.height() * 4), nullptr);
+        gst_buffer_memset(buffer, 0, 0x80, gst_buffer_get_size(buffer));
+        bool ok = source.fill(caps, buffer, 50);
+        gst_buffer_unref(buffer);
+        gst_caps_unref(caps);
+        if (!ok)
+            return false;
+
+        bool valid = true;
+        m->begin();
+        for (int n = 0; n < 50; ++n) {
+            // the frame is freed here, like after delivery
+            if (RtpWorker::Frame::pullFromSink(source.appSink()).image.isNull())
+                valid = false;
+        }
+        m->end(50);
+        return valid;
+    }
+
+    // the streaming thread pushes, the main thread delivers and the app
+    //   reads.  batches stay below the queue limit, so nothing is dropped
+    bool channelQueued(Measure *m)
+    {
+        PRtpPacket packet;
+        packet.rawValue = make_rtp_packet(160);
+
+        m->begin();
+        for (int n = 0; n < 20; ++n)
+            channel.push_packet_for_read(packet);
+        QCoreApplication::sendPostedEvents(&channel, QEvent::MetaCall);
+        while (channel.packetsAvailable() > 0)
+            channel.read();
+        m->end(20);
+        return true;
+    }
+
+    bool channelDirect(Measure *m)
+    {
+        PRtpPacket packet;
+        packet.rawValue = make_rtp_packet(160);
+
+        m->begin();
+        for (int n = 0; n < 1000; ++n)
+            directChannel.push_packet_for_read(packet);
+        m->end(1000);
+        return true;
+    }
+
+    // posting and processing, as a batch of what the worker sends between
+    //   two passes of the main loop
+    bool postIntensity(Measure *m)
+    {
+        m->begin();
+        for (int n = 0; n < 8; ++n) {
+            auto msg             = new RwControlAudioIntensityMessage;
+            msg->intensity.type  = RwControlAudioIntensity::Output;
+            msg->intensity.value = n;
+            control->postMessage(msg);
+        }
+        QCoreApplication::sendPostedEvents(control, QEvent::MetaCall);
+        m->end(8);
+        return true;
+    }
+
+    bool postFrame(Measure *m)
+    {
+        QImage image(640, 480, QImage::Format_RGB32);
+        image.fill(Qt::gray);
+
+        m->begin();
+        for (int n = 0; n < 8; ++n) {
+            auto msg         = new RwControlFrameMessage;
+            msg->frame.type  = RwControlFrame::Output;
+            msg->frame.image = image;
+            control->postMessage(msg);
+        }
+        QCoreApplication::sendPostedEvents(control, QEvent::MetaCall);
+        m->end(8);
+        return true;
+    }
+
+    bool toStructure(Measure *m)
+    {
+        PPayloadInfo info = make_opus_payload_info();
+
+        m->begin();
+        for (int n = 0; n < 1000; ++n)
+            gst_structure_free(payloadInfoToStructure(info, "audio"));
+        m->end(1000);
+        return true;
+    }
+
+    bool fromStructure(Measure *m)
+    {
+        GstStructure *structure = payloadInfoToStructure(make_opus_payload_info(), "audio");
+        if (!structure)
+            return false;
+
+        bool ok = true;
+        m->begin();
+        for (int n = 0; n < 1000; ++n) {
+            if (structureToPayloadInfo(structure).id == -1)
+                ok = false;
+        }
+        m->end(1000);
+        gst_structure_free(structure);
+        return ok;
+    }
+};
+
+}
+
+using namespace PsiMedia;
+
+// runs batches until they add up to minTime of measured time.  the first
+//   batch warms up caches and lazy initialization, and isn't counted
+static QJsonObject run_benchmark(const MicroBench::Benchmark &b, qint64 minTime)
+{
+    QJsonObject out;
+    out["name"] = b.name;
+
+    Measure warmup;
+    if (!b.batch(&warmup)) {
+        out["error"] = QString("failed");
+        return out;
+    }
+
+    Measure       m;
+    QElapsedTimer wall;
+    wall.start();
+    while (m.nsecs < minTime && wall.nsecsElapsed() < minTime * 20) {
+        if (!b.batch(&m)) {
+            out["error"] = QString("failed");
+            return out;
+        }
+    }
+
+    out["ops"]     = m.ops;
+    out["nsPerOp"] = double(m.nsecs) / m.ops;
+#ifdef COUNT_ALLOCATIONS
+    out["allocsPerOp"] = double(m.allocations) / m.ops;
+#else
+    out["allocsPerOp"] = -1;
+#endif
+    return out;
+}
+
+// a result is a regression if it takes more than tolerance percent longer
+//   than the baseline, or allocates more
+static bool is_regression(const QJsonObject &result, const QJsonObject &baseline, double tolerance)
+{
+    if (result.contains("error"))
+        return true;
+    if (result["nsPerOp"].toDouble() > baseline["nsPerOp"].toDouble() * (100 + tolerance) / 100)
+        return true;
+    double allocs = result["allocsPerOp"].toDouble(), baseAllocs = baseline["allocsPerOp"].toDouble();
+    return allocs >= 0 && baseAllocs >= 0 && allocs > baseAllocs + 0.01;
+}
+
+int main(int argc, char **argv)
+{
+    QCoreApplication qapp(argc, argv);
+
+    QCoreApplication::setOrganizationName("psi-im.org");
+    QCoreApplication::setApplicationName("psimedia-microbench");
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Microbenchmarks of the PsiMedia provider's per packet and per frame "
+                                     "primitives, in ns and allocations per operation.");
+    parser.addHelpOption();
+    parser.addPositionalArgument("filter", "Only run benchmarks with names containing this.", "[filter]");
+    QCommandLineOption timeOption("time", "Milliseconds to measure each benchmark for (default 500).", "ms", "500");
+    QCommandLineOption listOption("list", "List the benchmarks and exit.");
+    QCommandLineOption jsonOption("json", "Write the results as json to file.", "file");
+    QCommandLineOption compareOption("compare", "Compare with the results in file (from --json), and fail on "
+                                                "regressions.",
+                                     "file");
+    QCommandLineOption toleranceOption("tolerance", "Percent a benchmark may be slower than in the comparison "
+                                                    "(default 10).",
+                                       "percent", "10");
+    parser.addOptions({ timeOption, listOption, jsonOption, compareOption, toleranceOption });
+    parser.process(qapp);
+
+    QString filter  = parser.positionalArguments().value(0);
+    qint64  minTime = qMax(1, parser.value(timeOption).toInt()) * qint64(1000000);
+
+    QJsonObject baseline;
+    if (parser.isSet(compareOption)) {
+        QFile file(parser.value(compareOption));
+        if (!file.open(QIODevice::ReadOnly)) {
+            fprintf(stderr, "Can't read %s.\n", qPrintable(parser.value(compareOption)));
+            return 1;
+        }
+        for (const QJsonValue &v : QJsonDocument::fromJson(file.readAll()).object()["results"].toArray())
+            baseline[v.toObject()["name"].toString()] = v;
+    }
+
+    // the glib thread initializes gstreamer and hosts the remote side of
+    //   RwControlLocal, the same way the provider sets it up
+    QThread     gstThread;
+    GstMainLoop loop { QString() };
+    QEventLoop  wait;
+    loop.moveToThread(&gstThread);
+    QObject::connect(&loop, &GstMainLoop::started, &wait, &QEventLoop::quit, Qt::QueuedConnection);
+    QObject::connect(
+        &gstThread, &QThread::started, &loop,
+        [&loop, &wait]() {
+            if (!loop.start())
+                QMetaObject::invokeMethod(&wait, "quit", Qt::QueuedConnection);
+        },
+        Qt::QueuedConnection);
+    gstThread.start();
+    wait.exec();
+    if (!loop.isInitialized()) {
+        fprintf(stderr, "Can't initialize GStreamer.\n");
+        gstThread.quit();
+        gstThread.wait();
+        return 1;
+    }
+
+    QJsonArray results;
+    bool       regressed = false;
+    {
+        MicroBench bench(&loop);
+        if (parser.isSet(listOption)) {
+            for (const MicroBench::Benchmark &b : bench.benchmarks)
+                printf("%s\n", qPrintable(b.name));
+        } else {
+            printf("%-45s %12s %12s\n", "benchmark", "ns/op", "allocs/op");
+            for (const MicroBench::Benchmark &b : bench.benchmarks) {
+                if (!filter.isEmpty() && !b.name.contains(filter))
+                    continue;
+
+                QJsonObject result = run_benchmark(b, minTime);
+                results += result;
+                if (result.contains("error")) {
+                    printf("%-45s %12s\n", qPrintable(b.name), "failed");
+                    regressed = regressed || baseline.contains(b.name);
+                    continue;
+                }
+
+                QString line = QString::asprintf("%-45s %12.1f %12.2f", qPrintable(b.name),
+                                                 result["nsPerOp"].toDouble(), result["allocsPerOp"].toDouble());
+                if (baseline.contains(b.name)) {
+                    QJsonObject base = baseline[b.name].toObject();
+                    double      diff = (result["nsPerOp"].toDouble() / base["nsPerOp"].toDouble() - 1) * 100;
+                    line += QString::asprintf(" %+7.1f%%", diff);
+                    if (is_regression(result, base, parser.value(toleranceOption).toDouble())) {
+                        line += " REGRESSION";
+                        regressed = true;
+                    }
+                }
+                printf("%s\n", qPrintable(line));
+                fflush(stdout);
+            }
+        }
+    }
+
+    loop.stop();
+    gstThread.quit();
+    gstThread.wait();
+
+    if (parser.isSet(jsonOption)) {
+        QJsonObject report;
+        report["benchmark"] = QString("psimedia-microbench");
+        report["version"]   = 1;
+        report["results"]   = results;
+
+        QFile      file(parser.value(jsonOption));
+        QByteArray out = QJsonDocument(report).toJson();
+        if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate) || file.write(out) != out.size()) {
+            fprintf(stderr, "Can't write %s.\n", qPrintable(parser.value(jsonOption)));
+            return 1;
+        }
+    }
+
+    return regressed ? 1 : 0;
+}
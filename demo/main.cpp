@@ -421,9 +421,24 @@ void RtpSocketGroup::sock_bytesWritten(qint64 bytes)
 }
 
 RtpBinding::RtpBinding(Mode _mode, PsiMedia::RtpChannel *_channel, RtpSocketGroup *_socketGroup, QObject *parent) :
-    QObject(parent), mode(_mode), channel(_channel), socketGroup(_socketGroup), sendBasePort(-1)
+    QObject(parent), mode(_mode), channel(_channel), socketGroup(_socketGroup), sendBasePort(-1), impairment(nullptr)
 {
     socketGroup->setParent(this);
+
+    // simulated network trouble, see NetworkImpairment for the model
+    QString model = QString::fromLocal8Bit(qgetenv("PSI_IMPAIRMENT"));
+    if (!model.isEmpty()) {
+        impairment = new PsiMedia::NetworkImpairment(this);
+        if (impairment->setModel(model)) {
+            connect(impairment, &PsiMedia::NetworkImpairment::packetReady, channel,
+                    [this](const PsiMedia::RtpPacket &packet) { channel->write(packet); });
+        } else {
+            qWarning("Bad PSI_IMPAIRMENT model: %s", qPrintable(model));
+            delete impairment;
+            impairment = nullptr;
+        }
+    }
+
     connect(socketGroup, SIGNAL(readyRead(int)), SLOT(net_ready(int)));
     connect(socketGroup, SIGNAL(datagramWritten(int)), SLOT(net_written(int)));
     connect(channel, SIGNAL(readyRead()), SLOT(app_ready()));
@@ -450,7 +465,10 @@ void RtpBinding::net_ready(int offset)
             continue;
 
         PsiMedia::RtpPacket packet(rawValue, offset);
-        channel->write(packet);
+        if (impairment)
+            impairment->write(packet);
+        else
+            channel->write(packet);
     }
 }
 
@@ -28,6 +28,7 @@
 #include "ui_config.h"
 #include "ui_mainwin.h"
 
+#include <networkimpairment.h>
 #include <psimedia.h>
 
 class Configuration {
@@ -123,11 +124,12 @@ class RtpBinding : public QObject {
 public:
     enum Mode { Send, Receive };
 
-    Mode                  mode;
-    PsiMedia::RtpChannel *channel;
-    RtpSocketGroup *      socketGroup;
-    QHostAddress          sendAddress;
-    int                   sendBasePort;
+    Mode                         mode;
+    PsiMedia::RtpChannel *       channel;
+    RtpSocketGroup *             socketGroup;
+    QHostAddress                 sendAddress;
+    int                          sendBasePort;
+    PsiMedia::NetworkImpairment *impairment; // on what we receive, from PSI_IMPAIRMENT
 
     RtpBinding(Mode _mode, PsiMedia::RtpChannel *_channel, RtpSocketGroup *_socketGroup, QObject *parent = nullptr);
 
@@ -20,8 +20,11 @@
 
 #include "bins.h"
 
+#include "logging.h"
+#include "psimediaprovider.h"
 #include <QSize>
 #include <QString>
+#include <QThread>
 #include <cstdio>
 #include <gst/audio/audio-channels.h>
 #include <gst/gst.h>
@@ -29,6 +32,12 @@
 // default latency is 200ms
 #define DEFAULT_RTP_LATENCY 200
 
+// by default the video encoder may use half of the machine
+#define DEFAULT_VIDEO_CPU_BUDGET 50
+
+// upper bound for the automatic display conversion thread count
+#define DEFAULT_VIDEOCONVERT_MAX_THREADS 4
+
 namespace PsiMedia {
 
 static int get_rtp_latency()
@@ -40,6 +49,136 @@ static int get_rtp_latency()
         return DEFAULT_RTP_LATENCY;
 }
 
+// 0 means one thread per core, as with the n-threads property itself
+static int get_videoconvert_threads()
+{
+    QString val = QString::fromLatin1(qgetenv("PSI_VIDEOCONVERT_THREADS"));
+    if (!val.isEmpty())
+        return qMax(0, val.toInt());
+
+    // half the machine, the other half belongs to the codecs
+    return qBound(1, QThread::idealThreadCount() / 2, DEFAULT_VIDEOCONVERT_MAX_THREADS);
+}
+
+static QString srtp_cipher(const PSrtpParams &params)
+{
+    return params.cipher.isEmpty() ? QString("aes-128-icm") : params.cipher;
+}
+
+static QString srtp_auth(const PSrtpParams &params)
+{
+    return params.auth.isEmpty() ? QString("hmac-sha1-80") : params.auth;
+}
+
+// master key + master salt
+static int srtp_key_length(const QString &cipher)
+{
+    if (cipher == "aes-256-icm")
+        return 46;
+    else if (cipher == "aes-128-gcm")
+        return 28;
+    else if (cipher == "aes-256-gcm")
+        return 44;
+    else // aes-128-icm, null
+        return 30;
+}
+
+static GstBuffer *srtp_key_buffer(const PSrtpParams &params)
+{
+    if (params.key.size() != srtp_key_length(srtp_cipher(params))) {
+        qCWarning(lcPipeline, "srtp: wrong key length %d for %s", params.key.size(), qPrintable(srtp_cipher(params)));
+        return nullptr;
+    }
+
+    GstBuffer *buffer = gst_buffer_new_allocate(nullptr, gsize(params.key.size()), nullptr);
+    gst_buffer_fill(buffer, 0, params.key.constData(), gsize(params.key.size()));
+    return buffer;
+}
+
+// encoder settings derived from the cpu budget, in codec neutral units
+class VideoEncoderTuning {
+public:
+    int threads          = 1;
+    int speed            = 0; // 0 (encoder default) to 100 (fastest)
+    int keyframeInterval = 0; // in frames
+};
+
+static VideoEncoderTuning video_encoder_tuning(const QSize &size, int fps, int cpuBudget)
+{
+    if (cpuBudget <= 0 || cpuBudget > 100)
+        cpuBudget = DEFAULT_VIDEO_CPU_BUDGET;
+    if (fps <= 0)
+        fps = 30;
+
+    // how many cores we may keep busy, and how many the stream would need
+    //   at full effort. 640x480@30 is roughly one core worth of encoding
+    double cores = double(QThread::idealThreadCount() * cpuBudget) / 100;
+    double need  = double(size.width() * size.height()) * fps / (640 * 480 * 30);
+
+    VideoEncoderTuning t;
+    // more threads than slices of ~240 rows only add overhead
+    t.threads = qBound(1, qMin(int(cores), size.height() / 240), 8);
+
+    if (cores >= need * 2)
+        t.speed = 0;
+    else if (cores >= need)
+        t.speed = 33;
+    else if (cores >= need / 2)
+        t.speed = 66;
+    else
+        t.speed = 100;
+
+    // keyframes are expensive, space them out more when short on cpu
+    t.keyframeInterval = fps * (t.speed >= 66 ? 4 : 2);
+    return t;
+}
+
+static bool set_int_property(GstElement *e, const char *name, int value)
+{
+    GParamSpec *spec = g_object_class_find_property(G_OBJECT_GET_CLASS(e), name);
+    if (!spec)
+        return false;
+
+    if (G_IS_PARAM_SPEC_INT(spec)) {
+        auto ispec = G_PARAM_SPEC_INT(spec);
+        g_object_set(G_OBJECT(e), name, qBound(ispec->minimum, value, ispec->maximum), NULL);
+    } else if (G_IS_PARAM_SPEC_UINT(spec)) {
+        auto uspec = G_PARAM_SPEC_UINT(spec);
+        g_object_set(G_OBJECT(e), name, qBound(uspec->minimum, guint(qMax(value, 0)), uspec->maximum), NULL);
+    } else
+        return false;
+    return true;
+}
+
+// maps 0-100 onto an integer speed property, from its default up to its
+//   fastest.  the budget only ever makes the encoder cheaper than stock,
+//   a spare budget is no reason to burn more cpu
+static void set_speed_int_property(GstElement *e, const char *name, int percent)
+{
+    GParamSpec *spec = g_object_class_find_property(G_OBJECT_GET_CLASS(e), name);
+    if (!spec || !G_IS_PARAM_SPEC_INT(spec))
+        return;
+
+    auto ispec = G_PARAM_SPEC_INT(spec);
+    int  base  = qBound(ispec->minimum, ispec->default_value, ispec->maximum);
+    g_object_set(G_OBJECT(e), name, base + (ispec->maximum - base) * percent / 100, NULL);
+}
+
+static void video_encoder_apply_tuning(GstElement *enc, const QString &codec, const VideoEncoderTuning &t)
+{
+    if (codec == "theora") {
+        // libtheora encodes on a single thread, effort is all we can trade.
+        //   a higher speed-level is cheaper
+        set_speed_int_property(enc, "speed-level", t.speed);
+        set_int_property(enc, "keyframe-freq", t.keyframeInterval);
+    } else if (codec == "h263p") {
+        // the libav wrappers expose threading under either name
+        if (!set_int_property(enc, "threads", t.threads))
+            set_int_property(enc, "max-threads", t.threads);
+        set_int_property(enc, "gop-size", t.keyframeInterval);
+    }
+}
+
 static GstElement *audio_codec_to_enc_element(const QString &name)
 {
     QString ename;
@@ -225,7 +364,7 @@ GstElement *bins_videoprep_create(const QSize &size, int fps, bool is_live)
     if (fps != -1) {
         videorate = gst_element_factory_make("videorate", nullptr);
 
-        ratefilter = gst_element_factory_make("capsfilter", nullptr);
+        ratefilter = gst_element_factory_make("capsfilter", "ratefilter");
 
         GstCaps *     caps = gst_caps_new_empty();
         GstStructure *cs   = gst_structure_new("video/x-raw", "framerate", GST_TYPE_FRACTION, fps, 1, NULL);
@@ -240,7 +379,7 @@ GstElement *bins_videoprep_create(const QSize &size, int fps, bool is_live)
     GstElement *scalefilter = nullptr;
     if (size.isValid()) {
         videoscale  = gst_element_factory_make("videoscale", nullptr);
-        scalefilter = gst_element_factory_make("capsfilter", nullptr);
+        scalefilter = gst_element_factory_make("capsfilter", "scalefilter");
 
         GstCaps *     caps = gst_caps_new_empty();
         GstStructure *cs   = gst_structure_new("video/x-raw", "width", G_TYPE_INT, size.width(), "height", G_TYPE_INT,
@@ -298,6 +437,76 @@ GstElement *bins_videoprep_create(const QSize &size, int fps, bool is_live)
     return bin;
 }
 
+bool bins_videoprep_set(GstElement *videoprep, const QSize &size, int fps)
+{
+    if (!GST_IS_BIN(videoprep))
+        return false;
+
+    // look both up before touching either, so a failure leaves the old
+    //   size and rate in place together
+    GstElement *ratefilter  = gst_bin_get_by_name(GST_BIN(videoprep), "ratefilter");
+    GstElement *scalefilter = gst_bin_get_by_name(GST_BIN(videoprep), "scalefilter");
+    if (!ratefilter || !scalefilter) {
+        if (ratefilter)
+            gst_object_unref(ratefilter);
+        if (scalefilter)
+            gst_object_unref(scalefilter);
+        return false;
+    }
+
+    // capsfilter accepts new caps while playing and renegotiates upstream
+    GstCaps *caps = gst_caps_new_simple("video/x-raw", "framerate", GST_TYPE_FRACTION, fps, 1, NULL);
+    g_object_set(G_OBJECT(ratefilter), "caps", caps, NULL);
+    gst_caps_unref(caps);
+    gst_object_unref(ratefilter);
+
+    caps = gst_caps_new_simple("video/x-raw", "width", G_TYPE_INT, size.width(), "height", G_TYPE_INT, size.height(),
+                               NULL);
+    g_object_set(G_OBJECT(scalefilter), "caps", caps, NULL);
+    gst_caps_unref(caps);
+    gst_object_unref(scalefilter);
+
+    return true;
+}
+
+GstElement *bins_videoconvert_create(bool scale)
+{
+    int threads = get_videoconvert_threads();
+
+    // videoconvertscale (gstreamer 1.22+) does both in a single pass
+    GstElement *videoconvert = gst_element_factory_make("videoconvertscale", nullptr);
+    if (videoconvert) {
+        set_int_property(videoconvert, "n-threads", threads);
+        return videoconvert;
+    }
+
+    videoconvert = gst_element_factory_make("videoconvert", nullptr);
+    set_int_property(videoconvert, "n-threads", threads);
+    if (!scale)
+        return videoconvert;
+
+    // scale first, so the conversion only sees the smaller picture
+    GstElement *videoscale = gst_element_factory_make("videoscale", nullptr);
+    set_int_property(videoscale, "n-threads", threads);
+
+    GstElement *bin = gst_bin_new("videoconvertbin");
+    gst_bin_add(GST_BIN(bin), videoscale);
+    gst_bin_add(GST_BIN(bin), videoconvert);
+    gst_element_link(videoscale, videoconvert);
+
+    GstPad *pad;
+
+    pad = gst_element_get_static_pad(videoscale, "sink");
+    gst_element_add_pad(bin, gst_ghost_pad_new("sink", pad));
+    gst_object_unref(GST_OBJECT(pad));
+
+    pad = gst_element_get_static_pad(videoconvert, "src");
+    gst_element_add_pad(bin, gst_ghost_pad_new("src", pad));
+    gst_object_unref(GST_OBJECT(pad));
+
+    return bin;
+}
+
 GstElement *bins_audioenc_create(const QString &codec, int id, int rate, int size, int channels)
 {
     bool variableRate = (codec == QLatin1String("opus")); // opus supports variable bitrate and resampling on its own
@@ -311,6 +520,9 @@ GstElement *bins_audioenc_create(const QString &codec, int id, int rate, int siz
     if (id != -1)
         g_object_set(G_OBJECT(audiortppay), "pt", id, NULL);
 
+    // named so the worker can find it for latency tracing
+    gst_element_set_name(audioenc, "encoder");
+
     GstElement *audioconvert  = gst_element_factory_make("audioconvert", nullptr);
     GstElement *audioresample = nullptr;
     if (!variableRate) {
@@ -328,11 +540,11 @@ GstElement *bins_audioenc_create(const QString &codec, int id, int rate, int siz
         // also width could be taken from internal codec's caps. just any width.
         cs = gst_structure_new("audio/x-raw", "channels", G_TYPE_INT, channels, "channel-mask", GST_TYPE_BITMASK,
                                channel_mask, NULL);
-        qDebug("channels=%d", channels);
+        qCDebug(lcPipeline, "channels=%d", channels);
     } else {
         cs = gst_structure_new("audio/x-raw", "rate", G_TYPE_INT, rate, "width", G_TYPE_INT, size, "channels",
                                G_TYPE_INT, channels, "channel-mask", GST_TYPE_BITMASK, channel_mask, NULL);
-        qDebug("rate=%d,width=%d,channels=%d", rate, size, channels);
+        qCDebug(lcPipeline, "rate=%d,width=%d,channels=%d", rate, size, channels);
     }
     gst_caps_append_structure(caps, cs);
     GstElement *capsfilter = gst_element_factory_make("capsfilter", nullptr);
@@ -366,7 +578,73 @@ GstElement *bins_audioenc_create(const QString &codec, int id, int rate, int siz
     return bin;
 }
 
-GstElement *bins_videoenc_create(const QString &codec, int id, int maxkbps)
+GstElement *bins_audiorecord_create(int rate, int channels, bool dsp)
+{
+    GstElement *audioenc = audio_codec_to_enc_element("opus");
+    GstElement *oggmux   = gst_element_factory_make("oggmux", nullptr);
+    if (!audioenc || !oggmux) {
+        if (audioenc)
+            g_object_unref(G_OBJECT(audioenc));
+        if (oggmux)
+            g_object_unref(G_OBJECT(oggmux));
+        return nullptr;
+    }
+    gst_element_set_name(audioenc, "encoder");
+
+    GstElement *bin = gst_bin_new("audiorecordbin");
+
+    // webrtcdsp only takes a few formats.  there is no playback to cancel
+    //   the echo of, just noise to suppress
+    GstElement *first = nullptr, *last = nullptr;
+    GstElement *webrtcdsp = dsp ? gst_element_factory_make("webrtcdsp", nullptr) : nullptr;
+    if (webrtcdsp) {
+        g_object_set(G_OBJECT(webrtcdsp), "echo-cancel", FALSE, "noise-suppression", TRUE, NULL);
+
+        GstElement *dspconvert  = gst_element_factory_make("audioconvert", nullptr);
+        GstElement *dspresample = gst_element_factory_make("audioresample", nullptr);
+        GstElement *dspfilter   = gst_element_factory_make("capsfilter", nullptr);
+
+        GstCaps *caps = gst_caps_new_simple("audio/x-raw", "format", G_TYPE_STRING, "S16LE", "rate", G_TYPE_INT, 48000,
+                                            NULL);
+        g_object_set(G_OBJECT(dspfilter), "caps", caps, NULL);
+        gst_caps_unref(caps);
+
+        gst_bin_add_many(GST_BIN(bin), dspconvert, dspresample, dspfilter, webrtcdsp, NULL);
+        gst_element_link_many(dspconvert, dspresample, dspfilter, webrtcdsp, NULL);
+        first = dspconvert;
+        last  = webrtcdsp;
+    }
+
+    GstElement *audioconvert  = gst_element_factory_make("audioconvert", nullptr);
+    GstElement *audioresample = gst_element_factory_make("audioresample", nullptr);
+    GstElement *capsfilter    = gst_element_factory_make("capsfilter", nullptr);
+
+    GstCaps *caps
+        = gst_caps_new_simple("audio/x-raw", "rate", G_TYPE_INT, rate, "channels", G_TYPE_INT, channels, NULL);
+    g_object_set(G_OBJECT(capsfilter), "caps", caps, NULL);
+    gst_caps_unref(caps);
+
+    gst_bin_add_many(GST_BIN(bin), audioconvert, audioresample, capsfilter, audioenc, oggmux, NULL);
+    gst_element_link_many(audioconvert, audioresample, capsfilter, audioenc, oggmux, NULL);
+    if (last)
+        gst_element_link(last, audioconvert);
+    else
+        first = audioconvert;
+
+    GstPad *pad;
+
+    pad = gst_element_get_static_pad(first, "sink");
+    gst_element_add_pad(bin, gst_ghost_pad_new("sink", pad));
+    gst_object_unref(GST_OBJECT(pad));
+
+    pad = gst_element_get_static_pad(oggmux, "src");
+    gst_element_add_pad(bin, gst_ghost_pad_new("src", pad));
+    gst_object_unref(GST_OBJECT(pad));
+
+    return bin;
+}
+
+GstElement *bins_videoenc_create(const QString &codec, int id, int maxkbps, const QSize &size, int fps, int cpuBudget)
 {
     GstElement *bin = gst_bin_new("videoencbin");
 
@@ -378,9 +656,22 @@ GstElement *bins_videoenc_create(const QString &codec, int id, int maxkbps)
     if (id != -1)
         g_object_set(G_OBJECT(videortppay), "pt", id, NULL);
 
-    if (codec == "theora")
+    // named so the worker can find it for latency tracing
+    gst_element_set_name(videoenc, "encoder");
+
+    if (codec == "theora") {
         g_object_set(G_OBJECT(videoenc), "bitrate", maxkbps, NULL);
 
+        // the stream config changes whenever the capture is adapted to the
+        //   load, so repeat it in-band for the remote depayloader
+        set_int_property(videortppay, "config-interval", 1);
+    }
+
+    VideoEncoderTuning tuning = video_encoder_tuning(size, fps, cpuBudget);
+    qCDebug(lcPipeline, "video encoder: threads=%d speed=%d keyframe-interval=%d", tuning.threads, tuning.speed,
+            tuning.keyframeInterval);
+    video_encoder_apply_tuning(videoenc, codec, tuning);
+
     GstElement *videoconvert = gst_element_factory_make("videoconvert", nullptr);
 
     gst_bin_add(GST_BIN(bin), videoconvert);
@@ -402,6 +693,25 @@ GstElement *bins_videoenc_create(const QString &codec, int id, int maxkbps)
     return bin;
 }
 
+bool bins_videoenc_retune(GstElement *videoenc, const QString &codec, const QSize &size, int fps, int cpuBudget)
+{
+    if (!GST_IS_BIN(videoenc))
+        return false;
+
+    GstElement *enc = gst_bin_get_by_name(GST_BIN(videoenc), "encoder");
+    if (!enc)
+        return false;
+
+    // the new caps reach the encoder right behind this and make it set
+    //   itself up again, which picks up what it doesn't take while playing
+    VideoEncoderTuning tuning = video_encoder_tuning(size, fps, cpuBudget);
+    qCDebug(lcPipeline, "video encoder retuned: threads=%d speed=%d keyframe-interval=%d", tuning.threads,
+            tuning.speed, tuning.keyframeInterval);
+    video_encoder_apply_tuning(enc, codec, tuning);
+    gst_object_unref(enc);
+    return true;
+}
+
 GstElement *bins_audiodec_create(const QString &codec)
 {
     GstElement *bin = gst_bin_new("audiodecbin");
@@ -411,7 +721,11 @@ GstElement *bins_audiodec_create(const QString &codec)
     if (!audio_codec_get_recv_elements(codec, &audiodec, &audiortpdepay))
         return nullptr;
 
-    GstElement *audiortpjitterbuffer = gst_element_factory_make("rtpjitterbuffer", nullptr);
+    GstElement *audiortpjitterbuffer = gst_element_factory_make("rtpjitterbuffer", "jitterbuffer");
+
+    // named so the worker can find them for latency tracing
+    gst_element_set_name(audiortpdepay, "depayloader");
+    gst_element_set_name(audiodec, "decoder");
 
     gst_bin_add(GST_BIN(bin), audiortpjitterbuffer);
     gst_bin_add(GST_BIN(bin), audiortpdepay);
@@ -443,7 +757,12 @@ GstElement *bins_videodec_create(const QString &codec)
     if (!video_codec_get_recv_elements(codec, &videodec, &videortpdepay))
         return nullptr;
 
-    GstElement *videortpjitterbuffer = gst_element_factory_make("rtpjitterbuffer", nullptr);
+    GstElement *videortpjitterbuffer = gst_element_factory_make("rtpjitterbuffer", "jitterbuffer");
+
+    // named so the receiver can find them for its frame counters and
+    //   latency tracing
+    gst_element_set_name(videortpdepay, "depayloader");
+    gst_element_set_name(videodec, "decoder");
 
     gst_bin_add(GST_BIN(bin), videortpjitterbuffer);
     gst_bin_add(GST_BIN(bin), videortpdepay);
@@ -451,7 +770,19 @@ GstElement *bins_videodec_create(const QString &codec)
 
     gst_element_link_many(videortpjitterbuffer, videortpdepay, videodec, NULL);
 
-    g_object_set(G_OBJECT(videortpjitterbuffer), "latency", (unsigned int)get_rtp_latency(), NULL);
+    // do-lost makes the jitterbuffer announce lost packets, so the
+    //   depayloader and decoder know data is missing
+    g_object_set(G_OBJECT(videortpjitterbuffer), "latency", (unsigned int)get_rtp_latency(), "do-lost", TRUE, NULL);
+
+    // newer decoders can ask upstream for a keyframe on corrupted input,
+    //   which the receiver passes on as a picture loss indication
+    if (g_object_class_find_property(G_OBJECT_GET_CLASS(videodec), "automatic-request-sync-points"))
+        g_object_set(G_OBJECT(videodec), "automatic-request-sync-points", TRUE, NULL);
+
+    // skip frames that qos events say are already late (on by default
+    //   where supported, but be explicit)
+    if (g_object_class_find_property(G_OBJECT_GET_CLASS(videodec), "qos"))
+        g_object_set(G_OBJECT(videodec), "qos", TRUE, NULL);
 
     GstPad *pad;
 
@@ -466,4 +797,73 @@ GstElement *bins_videodec_create(const QString &codec)
     return bin;
 }
 
+bool bins_srtp_params_valid(const PSrtpParams &params)
+{
+    if (params.key.isEmpty() || params.key.size() == srtp_key_length(srtp_cipher(params)))
+        return true;
+
+    qCWarning(lcPipeline, "srtp: wrong key length %d for %s", params.key.size(), qPrintable(srtp_cipher(params)));
+    return false;
+}
+
+GstElement *bins_srtpenc_create(const PSrtpParams &params)
+{
+    GstElement *srtpenc = gst_element_factory_make("srtpenc", nullptr);
+    if (!srtpenc) {
+        qCWarning(lcPipeline, "srtp: srtpenc element is not available");
+        return nullptr;
+    }
+
+    if (!bins_srtpenc_setkey(srtpenc, params)) {
+        g_object_unref(G_OBJECT(srtpenc));
+        return nullptr;
+    }
+
+    return srtpenc;
+}
+
+bool bins_srtpenc_setkey(GstElement *srtpenc, const PSrtpParams &params)
+{
+    GstBuffer *key = srtp_key_buffer(params);
+    if (!key)
+        return false;
+
+    QByteArray cipher = srtp_cipher(params).toLatin1();
+    QByteArray auth   = srtp_auth(params).toLatin1();
+    gst_util_set_object_arg(G_OBJECT(srtpenc), "rtp-cipher", cipher.data());
+    gst_util_set_object_arg(G_OBJECT(srtpenc), "rtp-auth", auth.data());
+    gst_util_set_object_arg(G_OBJECT(srtpenc), "rtcp-cipher", cipher.data());
+    gst_util_set_object_arg(G_OBJECT(srtpenc), "rtcp-auth", auth.data());
+
+    // the key is mutable while playing. srtpenc recreates its session with
+    //   the new key on the next buffer, so rekeying doesn't stop the stream
+    g_object_set(G_OBJECT(srtpenc), "key", key, NULL);
+    gst_buffer_unref(key);
+    return true;
+}
+
+GstElement *bins_srtpdec_create()
+{
+    GstElement *srtpdec = gst_element_factory_make("srtpdec", nullptr);
+    if (!srtpdec)
+        qCWarning(lcPipeline, "srtp: srtpdec element is not available");
+    return srtpdec;
+}
+
+GstCaps *bins_srtpdec_keycaps(const PSrtpParams &params)
+{
+    GstBuffer *key = srtp_key_buffer(params);
+    if (!key)
+        return nullptr;
+
+    QByteArray cipher = srtp_cipher(params).toLatin1();
+    QByteArray auth   = srtp_auth(params).toLatin1();
+    GstCaps *  caps   = gst_caps_new_simple("application/x-srtp", "srtp-key", GST_TYPE_BUFFER, key, "srtp-cipher",
+                                         G_TYPE_STRING, cipher.data(), "srtp-auth", G_TYPE_STRING, auth.data(),
+                                         "srtcp-cipher", G_TYPE_STRING, cipher.data(), "srtcp-auth", G_TYPE_STRING,
+                                         auth.data(), NULL);
+    gst_buffer_unref(key);
+    return caps;
+}
+
 }
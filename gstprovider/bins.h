@@ -28,13 +28,38 @@ class QSize;
 
 namespace PsiMedia {
 
+class PSrtpParams;
+
 GstElement *bins_videoprep_create(const QSize &size, int fps, bool is_live);
+// changes the caps of a running videoprep bin, only for the parts it was created with
+bool bins_videoprep_set(GstElement *videoprep, const QSize &size, int fps);
+
+// raw video conversion for the display paths, threaded according to the
+//   cpu count or PSI_VIDEOCONVERT_THREADS. with scale it also resizes to
+//   whatever the downstream caps ask for. may return a bin
+GstElement *bins_videoconvert_create(bool scale);
 
 GstElement *bins_audioenc_create(const QString &codec, int id, int rate, int size, int channels);
-GstElement *bins_videoenc_create(const QString &codec, int id, int maxkbps);
+// raw audio in, ogg opus out.  dsp adds noise suppression when webrtcdsp is
+//   available
+GstElement *bins_audiorecord_create(int rate, int channels, bool dsp);
+// cpuBudget is the share of all cores (percent) the encoder may use, -1 for default
+GstElement *bins_videoenc_create(const QString &codec, int id, int maxkbps, const QSize &size, int fps, int cpuBudget);
+// applies the tuning for a new size or rate to a running encoder bin
+bool bins_videoenc_retune(GstElement *videoenc, const QString &codec, const QSize &size, int fps, int cpuBudget);
 GstElement *bins_audiodec_create(const QString &codec);
 GstElement *bins_videodec_create(const QString &codec);
 
+// srtpenc goes right after a payloader, srtpdec right before a jitterbuffer.
+//   srtpdec takes keys from its "request-key" signal, which should return
+//   bins_srtpdec_keycaps(). both return null for an invalid key.
+// an empty key (no srtp) is valid, otherwise it has to fit the cipher
+bool        bins_srtp_params_valid(const PSrtpParams &params);
+GstElement *bins_srtpenc_create(const PSrtpParams &params);
+bool        bins_srtpenc_setkey(GstElement *srtpenc, const PSrtpParams &params);
+GstElement *bins_srtpdec_create();
+GstCaps *   bins_srtpdec_keycaps(const PSrtpParams &params);
+
 }
 
 #endif
@@ -21,11 +21,14 @@
 #include "devices.h"
 
 #include "gstthread.h"
+#include "logging.h"
+#include "virtualdevices.h"
 #include <QMap>
 #include <QMutex>
 #include <QSize>
 #include <QStringList>
 #include <QTimer>
+#include <atomic>
 #include <gst/gst.h>
 
 namespace PsiMedia {
@@ -147,6 +150,13 @@ static gchar *get_launch_line(::GstDevice *device)
     return g_string_free(launch_line, FALSE);
 }
 
+// the lists devices() returns, by PDevice::Type.  never modified once
+//   published
+class DeviceSnapshot {
+public:
+    QList<GstDevice> byType[3];
+};
+
 class DeviceMonitor::Private {
 public:
     DeviceMonitor *          q;
@@ -154,8 +164,18 @@ public:
     QMap<QString, GstDevice> _devices;
     PlatformDeviceMonitor *  _platform = nullptr;
     QTimer *                 timer;
-    QMutex                   devListMutex;
+    QMutex                   devListMutex; // of _devices
     bool                     started = false;
+    std::atomic_bool         ready { false }; // the devices there on start() are known
+
+    // rebuilt whenever _devices changes and swapped in whole, so devices()
+    //   from any thread only copies an implicitly shared list out of it.
+    //   readers count themselves in readers while they do, and a replaced
+    //   snapshot is retired until a swap finds no reader, since one that
+    //   comes later can only see the new snapshot
+    std::atomic<const DeviceSnapshot *> snapshot { new DeviceSnapshot };
+    std::atomic_int                     readers { 0 };
+    QList<const DeviceSnapshot *>       retired; // glib thread
 
     bool videoSrcFirst  = true;
     bool audioSrcFirst  = true;
@@ -166,7 +186,76 @@ public:
         timer = new QTimer(q); // we need it to go another thread together with q
         timer->setSingleShot(true);
         timer->setInterval(50); // an interval to emit updated() signal on dev discovery since the may come in row
-        QObject::connect(timer, &QTimer::timeout, q, &DeviceMonitor::updated);
+        QObject::connect(timer, &QTimer::timeout, q, [this]() {
+            ready = true;
+            emit this->q->updated();
+        });
+    }
+
+    ~Private()
+    {
+        delete snapshot.load();
+        qDeleteAll(retired);
+    }
+
+    // devices of one type, sorted by name, with the default pulse device
+    //   added when there are pulse devices without it
+    QList<GstDevice> filter(PDevice::Type type) const
+    {
+        QList<GstDevice> ret;
+
+        bool hasPulsesrc         = false;
+        bool hasDefaultPulsesrc  = false;
+        bool hasPulsesink        = false;
+        bool hasDefaultPulsesink = false;
+        for (auto const &dev : qAsConst(_devices)) {
+            if (dev.type == type)
+                ret.append(dev);
+            // hack for pulsesrc
+            if (type == PDevice::AudioIn && dev.id.startsWith(QLatin1String("pulsesrc"))) {
+                hasPulsesrc = true;
+                if (dev.id == QLatin1String("pulsesrc"))
+                    hasDefaultPulsesrc = true;
+            }
+            if (type == PDevice::AudioOut && dev.id.startsWith(QLatin1String("pulsesink"))) {
+                hasPulsesink = true;
+                if (dev.id == QLatin1String("pulsesink"))
+                    hasDefaultPulsesink = true;
+            }
+        }
+
+        std::sort(ret.begin(), ret.end(), [](const GstDevice &a, const GstDevice &b) { return a.name < b.name; });
+        if (hasPulsesrc && !hasDefaultPulsesrc) {
+            GstDevice defalt;
+            defalt.isDefault = true;
+            defalt.id        = "pulsesrc";
+            defalt.name      = DeviceMonitor::tr("Default");
+            defalt.type      = type;
+            ret.prepend(defalt);
+        }
+        if (hasPulsesink && !hasDefaultPulsesink) {
+            GstDevice defalt;
+            defalt.isDefault = true;
+            defalt.id        = "pulsesink";
+            defalt.name      = DeviceMonitor::tr("Default");
+            defalt.type      = type;
+            ret.prepend(defalt);
+        }
+        return ret;
+    }
+
+    // call with devListMutex held
+    void publish()
+    {
+        auto next                       = new DeviceSnapshot;
+        next->byType[PDevice::AudioOut] = filter(PDevice::AudioOut);
+        next->byType[PDevice::AudioIn]  = filter(PDevice::AudioIn);
+        next->byType[PDevice::VideoIn]  = filter(PDevice::VideoIn);
+        retired += snapshot.exchange(next);
+        if (readers == 0) {
+            qDeleteAll(retired);
+            retired.clear();
+        }
     }
 
     static GstDevice gstDevConvert(::GstDevice *gdev)
@@ -249,7 +338,7 @@ public:
 
 void DeviceMonitor::updateDevList()
 {
-    QMutexLocker(&d->devListMutex);
+    QMutexLocker locker(&d->devListMutex);
     d->_devices.clear();
 #if GST_VERSION_MAJOR == 1 && GST_VERSION_MINOR < 18
     // with newer versions the devices events seem replayed, so we don't need this
@@ -265,7 +354,7 @@ void DeviceMonitor::updateDevList()
             devices = g_list_delete_link(devices, devices);
         }
     } else {
-        qDebug("No devices found!");
+        qCDebug(lcDevices, "No devices found!");
     }
 #endif
 
@@ -278,16 +367,23 @@ void DeviceMonitor::updateDevList()
         }
     }
 
+    if (virtualdevices_listed()) {
+        auto l = virtualdevices_list();
+        for (auto const &vdev : qAsConst(l))
+            d->_devices.insert(vdev.id, vdev);
+    }
+
     for (auto const &pdev : qAsConst(d->_devices)) {
-        qDebug("found dev: %s (%s)", qPrintable(pdev.name), qPrintable(pdev.id));
+        qCDebug(lcDevices, "found dev: %s (%s)", qPrintable(pdev.name), qPrintable(pdev.id));
     }
+    d->publish();
 }
 
 void DeviceMonitor::onDeviceAdded(GstDevice dev)
 {
-    QMutexLocker(&d->devListMutex);
+    QMutexLocker locker(&d->devListMutex);
     if (d->_devices.contains(dev.id)) {
-        qWarning("Double added of device %s (%s)", qPrintable(dev.name), qPrintable(dev.id));
+        qCWarning(lcDevices, "Double added of device %s (%s)", qPrintable(dev.name), qPrintable(dev.id));
     } else {
         switch (dev.type) {
         case PDevice::AudioIn:
@@ -304,7 +400,8 @@ void DeviceMonitor::onDeviceAdded(GstDevice dev)
             break;
         }
         d->_devices.insert(dev.id, dev);
-        qDebug("added dev: %s (%s)", qPrintable(dev.name), qPrintable(dev.id));
+        d->publish();
+        qCDebug(lcDevices, "added dev: %s (%s)", qPrintable(dev.name), qPrintable(dev.id));
         // wait quite a bit since updates may come in row with latest gstreamer
         if (!d->timer->isActive())
             d->timer->start();
@@ -313,26 +410,31 @@ void DeviceMonitor::onDeviceAdded(GstDevice dev)
 
 void DeviceMonitor::onDeviceRemoved(const GstDevice &dev)
 {
-    QMutexLocker(&d->devListMutex);
+    QMutexLocker locker(&d->devListMutex);
     if (d->_devices.remove(dev.id)) {
-        qDebug("removed dev: %s (%s)", qPrintable(dev.name), qPrintable(dev.id));
+        d->publish();
+        qCDebug(lcDevices, "removed dev: %s (%s)", qPrintable(dev.name), qPrintable(dev.id));
+        locker.unlock();
         emit updated();
     } else {
-        qWarning("Double remove of device %s (%s)", qPrintable(dev.name), qPrintable(dev.id));
+        qCWarning(lcDevices, "Double remove of device %s (%s)", qPrintable(dev.name), qPrintable(dev.id));
     }
 }
 
 void DeviceMonitor::onDeviceChanged(const GstDevice &dev)
 {
-    QMutexLocker(&d->devListMutex);
-    auto it = d->_devices.find(dev.id);
+    QMutexLocker locker(&d->devListMutex);
+    auto         it = d->_devices.find(dev.id);
     if (it == d->_devices.end()) {
-        qDebug("Changed unknown previously device '%s'. Try to add it", qPrintable(dev.id));
+        qCDebug(lcDevices, "Changed unknown previously device '%s'. Try to add it", qPrintable(dev.id));
+        locker.unlock();
         onDeviceAdded(dev);
         return;
     }
-    qDebug("Changed device '%s'", qPrintable(dev.id));
+    qCDebug(lcDevices, "Changed device '%s'", qPrintable(dev.id));
     it->updateFrom(dev);
+    d->publish();
+    locker.unlock();
     emit updated();
 }
 
@@ -381,60 +483,30 @@ void DeviceMonitor::start()
 
     updateDevList();
     if (!gst_device_monitor_start(d->_monitor)) {
-        qWarning("failed to start device monitor");
+        qCWarning(lcDevices, "failed to start device monitor");
     }
+
+    // the devices found by now come in as bus messages.  the first
+    //   updated() after they are in makes the monitor ready, even if there
+    //   are no devices at all
+    d->timer->start();
 }
 
+bool DeviceMonitor::isReady() const { return d->ready; }
+
 QList<GstDevice> DeviceMonitor::devices(PDevice::Type type)
 {
-    QList<GstDevice> ret;
-
-    bool hasPulsesrc         = false;
-    bool hasDefaultPulsesrc  = false;
-    bool hasPulsesink        = false;
-    bool hasDefaultPulsesink = false;
-    d->devListMutex.lock();
-    for (auto const &dev : qAsConst(d->_devices)) {
-        if (dev.type == type)
-            ret.append(dev);
-        // hack for pulsesrc
-        if (type == PDevice::AudioIn && dev.id.startsWith(QLatin1String("pulsesrc"))) {
-            hasPulsesrc = true;
-            if (dev.id == QLatin1String("pulsesrc"))
-                hasDefaultPulsesrc = true;
-        }
-        if (type == PDevice::AudioOut && dev.id.startsWith(QLatin1String("pulsesink"))) {
-            hasPulsesink = true;
-            if (dev.id == QLatin1String("pulsesink"))
-                hasDefaultPulsesink = true;
-        }
-    }
-    d->devListMutex.unlock();
-
-    std::sort(ret.begin(), ret.end(), [](const GstDevice &a, const GstDevice &b) { return a.name < b.name; });
-    if (hasPulsesrc && !hasDefaultPulsesrc) {
-        GstDevice defalt;
-        defalt.isDefault = true;
-        defalt.id        = "pulsesrc";
-        defalt.name      = tr("Default");
-        defalt.type      = type;
-        ret.prepend(defalt);
-    }
-    if (hasPulsesink && !hasDefaultPulsesink) {
-        GstDevice defalt;
-        defalt.isDefault = true;
-        defalt.id        = "pulsesink";
-        defalt.name      = tr("Default");
-        defalt.type      = type;
-        ret.prepend(defalt);
-    }
+    ++d->readers;
+    QList<GstDevice> ret = d->snapshot.load()->byType[type];
+    --d->readers;
     return ret;
 }
 
 GstElement *devices_makeElement(const QString &id, PDevice::Type type, QSize *captureSize)
 {
-    Q_UNUSED(type);
-    Q_UNUSED(captureSize);
+    if (virtualdevices_isVirtual(id))
+        return virtualdevices_makeElement(id, type, captureSize);
+
     return gst_parse_launch(id.toLatin1().data(), nullptr);
     // TODO check if it correponds to passed type.
     // TODO drop captureSize
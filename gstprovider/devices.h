@@ -72,7 +72,12 @@ public:
     explicit DeviceMonitor(GstMainLoop *mainLoop);
     ~DeviceMonitor() override;
 
-    void             start();
+    void start();
+    // from any thread.  false until the devices present at start() were
+    //   reported with updated()
+    bool isReady() const;
+    // from any thread.  a snapshot taken when the devices last changed, so
+    //   this neither locks nor builds a list
     QList<GstDevice> devices(PDevice::Type type);
 };
 
@@ -0,0 +1,141 @@
+/*
+ * Copyright (C) 2026  Psi IM Team
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301  USA
+ *
+ */
+
+#include "eventrecorder.h"
+
+#include <QCoreApplication>
+#include <QFile>
+#include <atomic>
+#include <glib.h>
+
+// must be a power of two
+#define EVENT_RING_SIZE 8192
+
+namespace PsiMedia {
+
+class RecordedEvent {
+public:
+    // index + 1 of the event in this slot, 0 while it is being written
+    std::atomic<quint64> seq { 0 };
+
+    gint64      time; // us, monotonic
+    const char *category;
+    const char *name;
+    qint64      value;
+    int         thread;
+    int         phase;
+};
+
+static RecordedEvent        event_ring[EVENT_RING_SIZE];
+static std::atomic<quint64> event_next { 0 };
+static std::atomic<int>     thread_next { 0 };
+static const bool           event_recording = qEnvironmentVariableIsEmpty("PSI_NO_EVENT_RECORDER");
+static thread_local int     event_thread    = 0;
+
+void EventRecorder::record(const char *category, const char *name, Phase phase, qint64 value)
+{
+    if (!event_recording)
+        return;
+
+    // small numbers read better in the trace viewer than native thread ids
+    if (!event_thread)
+        event_thread = ++thread_next;
+
+    quint64        index = event_next.fetch_add(1, std::memory_order_relaxed);
+    RecordedEvent &e     = event_ring[index & (EVENT_RING_SIZE - 1)];
+
+    // a slot is only reused after a full turn of the ring, so writers of the
+    //   same slot don't meet in practice.  readers check seq to skip a slot
+    //   that changes under them
+    e.seq.store(0, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    e.time     = g_get_monotonic_time();
+    e.category = category;
+    e.name     = name;
+    e.value    = value;
+    e.thread   = event_thread;
+    e.phase    = phase;
+    e.seq.store(index + 1, std::memory_order_release);
+}
+
+static void append_event(QByteArray *out, const RecordedEvent &e, qint64 pid)
+{
+    static const char *phases[] = { "i", "B", "E", "C" };
+
+    *out += "{\"cat\":\"";
+    *out += e.category;
+    *out += "\",\"name\":\"";
+    *out += e.name;
+    *out += "\",\"ph\":\"";
+    *out += phases[e.phase];
+    *out += "\",\"ts\":" + QByteArray::number(e.time);
+    *out += ",\"pid\":" + QByteArray::number(pid);
+    *out += ",\"tid\":" + QByteArray::number(e.thread);
+    if (e.phase == EventRecorder::Instant)
+        *out += ",\"s\":\"t\"";
+    if (e.phase != EventRecorder::End)
+        *out += ",\"args\":{\"value\":" + QByteArray::number(e.value) + '}';
+    *out += '}';
+}
+
+QByteArray EventRecorder::chromeTrace()
+{
+    qint64     pid   = QCoreApplication::applicationPid();
+    quint64    end   = event_next.load(std::memory_order_acquire);
+    quint64    from  = end > EVENT_RING_SIZE ? end - EVENT_RING_SIZE : 0;
+    QByteArray out   = "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+    bool       first = true;
+
+    for (quint64 index = from; index < end; ++index) {
+        const RecordedEvent &slot = event_ring[index & (EVENT_RING_SIZE - 1)];
+        if (slot.seq.load(std::memory_order_acquire) != index + 1)
+            continue;
+
+        RecordedEvent e;
+        e.time     = slot.time;
+        e.category = slot.category;
+        e.name     = slot.name;
+        e.value    = slot.value;
+        e.thread   = slot.thread;
+        e.phase    = slot.phase;
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (slot.seq.load(std::memory_order_relaxed) != index + 1)
+            continue;
+
+        if (!first)
+            out += ",\n";
+        first = false;
+        append_event(&out, e, pid);
+    }
+
+    out += "]}\n";
+    return out;
+}
+
+bool EventRecorder::writeChromeTrace(const QString &fileName)
+{
+    QFile file(fileName);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate))
+        return false;
+    QByteArray trace = chromeTrace();
+    return file.write(trace) == trace.size();
+}
+
+}
@@ -0,0 +1,55 @@
+/*
+ * Copyright (C) 2026  Psi IM Team
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301  USA
+ *
+ */
+
+#ifndef PSIMEDIA_EVENTRECORDER_H
+#define PSIMEDIA_EVENTRECORDER_H
+
+#include <QByteArray>
+#include <QString>
+
+namespace PsiMedia {
+
+//----------------------------------------------------------------------------
+// EventRecorder
+//----------------------------------------------------------------------------
+// keeps the most recent media events of the whole process in a fixed ring,
+//   so the moments before a glitch can be looked at afterwards.  recording
+//   takes no lock and doesn't allocate, so it stays on all the time unless
+//   PSI_NO_EVENT_RECORDER is set.
+//
+// events can be recorded from any thread.  the ring can be dumped as a
+//   chrome trace, to be loaded into perfetto or chrome://tracing
+class EventRecorder {
+public:
+    enum Phase { Instant, Begin, End, Counter };
+
+    // category and name must be string literals, only the pointers are kept.
+    //   value is shown as an argument of the event, or as the value of a
+    //   counter
+    static void record(const char *category, const char *name, Phase phase = Instant, qint64 value = 0);
+
+    // recorded events in chrome trace event format, oldest first
+    static QByteArray chromeTrace();
+    static bool       writeChromeTrace(const QString &fileName);
+};
+
+}
+
+#endif // PSIMEDIA_EVENTRECORDER_H
@@ -1,40 +1,535 @@
 #include "gstaudiorecordercontext.h"
 
+#include "bins.h"
+#include "gstthread.h"
+#include "logging.h"
+#include "pipeline.h"
+
+#include <QIODevice>
+#include <QThread>
+#include <algorithm>
+#include <gst/app/gstappsink.h>
+#include <gst/gst.h>
+
 namespace PsiMedia {
 
+static const int opus_rates[] = { 8000, 12000, 16000, 24000, 48000 };
+
+// opus is all we record.  the first opus entry wins, anything it asks for
+//   that opus can't do falls back to 48khz mono
+static PAudioParams recorder_params(const QList<PAudioParams> &list)
+{
+    PAudioParams p;
+    p.codec      = "opus";
+    p.sampleRate = 48000;
+    p.sampleSize = 16;
+    p.channels   = 1;
+    for (const PAudioParams &i : list) {
+        if (i.codec.toLower() != "opus")
+            continue;
+        if (std::find(std::begin(opus_rates), std::end(opus_rates), i.sampleRate) != std::end(opus_rates))
+            p.sampleRate = i.sampleRate;
+        if (i.channels == 1 || i.channels == 2)
+            p.channels = i.channels;
+        break;
+    }
+    return p;
+}
+
+//----------------------------------------------------------------------------
+// AudioRecorderWriter
+//----------------------------------------------------------------------------
+AudioRecorderWriter::AudioRecorderWriter(QIODevice *_device) : device(_device) { }
+
+void AudioRecorderWriter::push(const QByteArray &buf)
+{
+    QMutexLocker locker(&m);
+    pending_in += buf;
+    if (!wake_pending) {
+        wake_pending = true;
+        QMetaObject::invokeMethod(this, "processIn", Qt::QueuedConnection);
+    }
+}
+
+void AudioRecorderWriter::processIn()
+{
+    m.lock();
+    wake_pending         = false;
+    QList<QByteArray> in = pending_in;
+    pending_in.clear();
+    m.unlock();
+
+    for (const QByteArray &buf : qAsConst(in)) {
+        if (!device)
+            break;
+        if (!buf.isEmpty()) {
+            device->write(buf);
+            continue;
+        }
+
+        // EOF
+        device->close();
+        device = nullptr;
+        emit finished();
+    }
+}
+
+//----------------------------------------------------------------------------
+// AudioRecorderPipeline
+//----------------------------------------------------------------------------
+// everything but owner, writer and readyTimer is only touched in the glib
+//   thread.  the calls queued there hold a reference, so this may outlive
+//   the context
+class AudioRecorderPipeline {
+public:
+    QMutex                   m;
+    GstAudioRecorderContext *owner      = nullptr; // guarded by m
+    AudioRecorderWriter *    writer     = nullptr; // guarded by m
+    GSource *                readyTimer = nullptr; // guarded by m
+
+    GstMainLoop *          gstLoop;
+    QString                deviceId;
+    PAudioParams           params;
+    bool                   dsp             = false;
+    PipelineContext *      pipelineContext = nullptr;
+    PipelineDeviceContext *pd_audiosrc     = nullptr;
+    GstElement *           valve           = nullptr;
+    GstElement *           recordbin       = nullptr;
+    GSource *              busWatch        = nullptr;
+    bool                   playing         = false;
+    int                    error           = AudioRecorderContext::ErrorGeneric; // of the last prepare()
+
+    explicit AudioRecorderPipeline(GstMainLoop *_gstLoop) : gstLoop(_gstLoop) { }
+
+    ~AudioRecorderPipeline() { teardown(); }
+
+    // builds the pipeline but leaves it in the null state, so the device is
+    //   only opened by start().  does nothing if it is already built for
+    //   these settings
+    bool prepare(const QString &_deviceId, const PAudioParams &_params)
+    {
+        bool wantDsp = qgetenv("PSI_RECORDER_DSP") != "0";
+        if (pipelineContext && deviceId == _deviceId && params.sampleRate == _params.sampleRate
+            && params.channels == _params.channels && dsp == wantDsp)
+            return true;
+
+        teardown();
+        deviceId = _deviceId;
+        params   = _params;
+        dsp      = wantDsp;
+        error    = AudioRecorderContext::ErrorGeneric;
+        if (deviceId.isEmpty())
+            return false;
+
+        // the capture device of a running session can't be shared, since
+        //   PipelineDevice only shares within a pipeline
+        pipelineContext = new PipelineContext;
+        pd_audiosrc     = PipelineDeviceContext::create(pipelineContext, deviceId, PDevice::AudioIn);
+        if (!pd_audiosrc) {
+            qCDebug(lcPipeline, "recorder: failed to create audio input element '%s'", qPrintable(deviceId));
+            teardown();
+            return false;
+        }
+
+        recordbin = bins_audiorecord_create(params.sampleRate, params.channels, dsp);
+        valve     = gst_element_factory_make("valve", nullptr);
+        if (!recordbin || !valve) {
+            qCDebug(lcPipeline, "recorder: failed to create the encoder");
+            if (recordbin)
+                g_object_unref(G_OBJECT(recordbin));
+            if (valve)
+                g_object_unref(G_OBJECT(valve));
+            recordbin = nullptr;
+            valve     = nullptr;
+            error     = AudioRecorderContext::ErrorCodec;
+            teardown();
+            return false;
+        }
+
+        GstElement *appsink = gst_element_factory_make("appsink", nullptr);
+        // written out as soon as it is encoded
+        g_object_set(G_OBJECT(appsink), "sync", FALSE, nullptr);
+        GstAppSinkCallbacks callbacks = {};
+        callbacks.new_sample          = cb_new_sample;
+        callbacks.eos                 = cb_eos;
+        gst_app_sink_set_callbacks(GST_APP_SINK(appsink), &callbacks, this, nullptr);
+
+        GstElement *pipeline = pipelineContext->element();
+        gst_bin_add_many(GST_BIN(pipeline), valve, recordbin, appsink, nullptr);
+        gst_element_link_many(pd_audiosrc->element(), valve, recordbin, appsink, nullptr);
+
+        GstBus *bus = gst_pipeline_get_bus(GST_PIPELINE(pipeline));
+        busWatch    = gst_bus_create_watch(bus);
+        gst_object_unref(bus);
+        g_source_set_callback(busWatch, (GSourceFunc)cb_bus_call, this, nullptr);
+        g_source_attach(busWatch, gstLoop->mainContext());
+        g_source_unref(busWatch);
+
+        pd_audiosrc->activate();
+        return true;
+    }
+
+    void teardown()
+    {
+        // stop the streaming threads first, so that eos() can't run anymore
+        //   and the device is idle when it goes away
+        if (pipelineContext) {
+            gst_element_set_state(pipelineContext->element(), GST_STATE_NULL);
+            gst_element_get_state(pipelineContext->element(), nullptr, nullptr, GST_CLOCK_TIME_NONE);
+        }
+        playing = false;
+
+        m.lock();
+        if (readyTimer) {
+            g_source_destroy(readyTimer);
+            readyTimer = nullptr;
+        }
+        m.unlock();
+
+        if (!pipelineContext)
+            return;
+
+        if (busWatch) {
+            g_source_destroy(busWatch);
+            busWatch = nullptr;
+        }
+
+        delete pd_audiosrc;
+        pd_audiosrc = nullptr;
+        delete pipelineContext;
+        pipelineContext = nullptr;
+        valve           = nullptr;
+        recordbin       = nullptr;
+    }
+
+    void start(const QString &_deviceId, const PAudioParams &_params)
+    {
+        // a stop may still be settling, see eos()
+        m.lock();
+        GSource *pending = readyTimer;
+        readyTimer       = nullptr;
+        m.unlock();
+        if (pending) {
+            g_source_destroy(pending);
+            rewind();
+        }
+
+        if (!prepare(_deviceId, _params)) {
+            postError(error);
+            return;
+        }
+
+        // opens the device
+        g_object_set(G_OBJECT(valve), "drop", FALSE, nullptr);
+        if (gst_element_set_state(pipelineContext->element(), GST_STATE_PLAYING) == GST_STATE_CHANGE_FAILURE) {
+            qCDebug(lcPipeline, "recorder: failed to open audio input '%s'", qPrintable(deviceId));
+            teardown();
+            postError(AudioRecorderContext::ErrorGeneric);
+            return;
+        }
+        playing = true;
+        post("pipeline_started");
+    }
+
+    void setPaused(bool paused)
+    {
+        if (!playing)
+            return;
+        g_object_set(G_OBJECT(valve), "drop", paused ? TRUE : FALSE, nullptr);
+        post(paused ? "pipeline_paused" : "pipeline_started");
+    }
+
+    void stop()
+    {
+        if (!playing) {
+            // nothing to finish, just close the output
+            QMutexLocker locker(&m);
+            if (writer)
+                writer->push(QByteArray());
+            return;
+        }
+
+        // sent past the valve, so that the encoder drains even while paused
+        GstPad *pad = gst_element_get_static_pad(recordbin, "sink");
+        gst_pad_send_event(pad, gst_event_new_eos());
+        gst_object_unref(GST_OBJECT(pad));
+    }
+
+    // back to null for the next recording.  that closes the device, which
+    //   a call may want exclusively (alsa hw) while nothing is recorded
+    void rewind()
+    {
+        if (!pipelineContext)
+            return;
+        gst_element_set_state(pipelineContext->element(), GST_STATE_NULL);
+        playing = false;
+    }
+
+    // queued to the owner, if it is still around
+    void post(const char *method)
+    {
+        QMutexLocker locker(&m);
+        if (owner)
+            QMetaObject::invokeMethod(owner, method, Qt::QueuedConnection);
+    }
+
+    void postError(int code)
+    {
+        QMutexLocker locker(&m);
+        if (owner)
+            QMetaObject::invokeMethod(owner, "pipeline_error", Qt::QueuedConnection, Q_ARG(int, code));
+    }
+
+    // streaming thread
+    GstFlowReturn new_sample(GstAppSink *appsink)
+    {
+        GstSample *sample = gst_app_sink_pull_sample(appsink);
+        if (!sample)
+            return GST_FLOW_OK;
+
+        GstBuffer *buffer = gst_sample_get_buffer(sample);
+        QByteArray buf(int(gst_buffer_get_size(buffer)), Qt::Uninitialized);
+        gst_buffer_extract(buffer, 0, buf.data(), size_t(buf.size()));
+        gst_sample_unref(sample);
+
+        QMutexLocker locker(&m);
+        if (writer)
+            writer->push(buf);
+        return GST_FLOW_OK;
+    }
+
+    // streaming thread.  the state can't be changed from here
+    void eos()
+    {
+        QMutexLocker locker(&m);
+        if (writer)
+            writer->push(QByteArray());
+        if (!readyTimer) {
+            readyTimer = g_timeout_source_new(0);
+            g_source_set_callback(readyTimer, cb_ready, this, nullptr);
+            g_source_attach(readyTimer, gstLoop->mainContext());
+            g_source_unref(readyTimer);
+        }
+    }
+
+    gboolean ready()
+    {
+        m.lock();
+        readyTimer = nullptr;
+        m.unlock();
+        rewind();
+        return FALSE;
+    }
+
+    gboolean bus_call(GstMessage *msg)
+    {
+        if (GST_MESSAGE_TYPE(msg) != GST_MESSAGE_ERROR)
+            return TRUE;
+
+        GError *err;
+        gchar * debug;
+        gst_message_parse_error(msg, &err, &debug);
+        qCWarning(lcPipeline, "recorder: %s (%s)", err->message, debug ? debug : "");
+        g_error_free(err);
+        g_free(debug);
+
+        // the device may be gone.  built again on the next start
+        busWatch = nullptr;
+        teardown();
+        postError(AudioRecorderContext::ErrorSystem);
+        return FALSE;
+    }
+
+    static GstFlowReturn cb_new_sample(GstAppSink *appsink, gpointer data)
+    {
+        return static_cast<AudioRecorderPipeline *>(data)->new_sample(appsink);
+    }
+
+    static void cb_eos(GstAppSink *appsink, gpointer data)
+    {
+        Q_UNUSED(appsink);
+        static_cast<AudioRecorderPipeline *>(data)->eos();
+    }
+
+    static gboolean cb_ready(gpointer data) { return static_cast<AudioRecorderPipeline *>(data)->ready(); }
+
+    static gboolean cb_bus_call(GstBus *bus, GstMessage *msg, gpointer data)
+    {
+        Q_UNUSED(bus);
+        return static_cast<AudioRecorderPipeline *>(data)->bus_call(msg);
+    }
+};
+
+//----------------------------------------------------------------------------
+// GstAudioRecorderContext
+//----------------------------------------------------------------------------
 GstAudioRecorderContext::GstAudioRecorderContext(GstMainLoop *_gstLoop, QObject *parent) :
     QObject(parent), gstLoop(_gstLoop)
 {
+    params          = recorder_params(QList<PAudioParams>());
+    pipeline        = std::make_shared<AudioRecorderPipeline>(gstLoop);
+    pipeline->owner = this;
 }
 
-GstAudioRecorderContext::~GstAudioRecorderContext() { }
+GstAudioRecorderContext::~GstAudioRecorderContext()
+{
+    pipeline->m.lock();
+    pipeline->owner  = nullptr;
+    pipeline->writer = nullptr;
+    pipeline->m.unlock();
+
+    if (writer)
+        writer->deleteLater();
+
+    exec([](AudioRecorderPipeline *p) { p->teardown(); });
+}
 
 QObject *GstAudioRecorderContext::qobject() { return this; }
 
-void GstAudioRecorderContext::setInputDevice(const QString &deviceId)
+void GstAudioRecorderContext::setInputDevice(const QString &_deviceId)
+{
+    deviceId = _deviceId;
+    prepare();
+}
+
+void GstAudioRecorderContext::setOutputDevice(QIODevice *recordDevice)
 {
-    Q_UNUSED(deviceId);
-#if 0
-    devices.audioInId = deviceId;
-    devices.fileNameIn.clear();
-    devices.fileDataIn.clear();
-    if (control)
-        control->updateDevices(devices);
-#endif
+    if (state != Idle) {
+        qCWarning(lcPipeline, "recorder: output device can't be changed while recording");
+        return;
+    }
+
+    AudioRecorderWriter *old = writer;
+    writer                   = recordDevice ? new AudioRecorderWriter(recordDevice) : nullptr;
+    if (writer) {
+        writer->moveToThread(recordDevice->thread());
+        connect(writer, &AudioRecorderWriter::finished, this, &GstAudioRecorderContext::writer_finished);
+    }
+
+    pipeline->m.lock();
+    pipeline->writer = writer;
+    pipeline->m.unlock();
+
+    if (old)
+        old->deleteLater();
+}
+
+void GstAudioRecorderContext::setPreferences(const QList<PAudioParams> &_params)
+{
+    params = recorder_params(_params);
+    prepare();
+    QMetaObject::invokeMethod(this, "preferencesUpdated", Qt::QueuedConnection);
 }
 
-void GstAudioRecorderContext::setOutputDevice(QIODevice *recordDevice) { Q_UNUSED(recordDevice); }
+QList<PAudioParams> GstAudioRecorderContext::preferences() const { return QList<PAudioParams>() << params; }
 
-void GstAudioRecorderContext::setPreferences(const QList<PAudioParams> &params) { Q_UNUSED(params); }
+void GstAudioRecorderContext::start()
+{
+    if (state == Paused) {
+        state = Starting;
+        exec([](AudioRecorderPipeline *p) { p->setPaused(false); });
+        return;
+    }
+    if (state != Idle)
+        return;
 
-QList<PAudioParams> GstAudioRecorderContext::preferences() const { return QList<PAudioParams>(); }
+    if (!writer) {
+        errorCode_ = ErrorGeneric;
+        QMetaObject::invokeMethod(this, "error", Qt::QueuedConnection);
+        return;
+    }
 
-void GstAudioRecorderContext::start() { }
+    state = Starting;
 
-void GstAudioRecorderContext::pause() { }
+    QString      id     = deviceId;
+    PAudioParams params = this->params;
+    exec([id, params](AudioRecorderPipeline *p) { p->start(id, params); });
+}
 
-void GstAudioRecorderContext::stop() { }
+void GstAudioRecorderContext::pause()
+{
+    if (state != Recording)
+        return;
+    state = Paused;
+    exec([](AudioRecorderPipeline *p) { p->setPaused(true); });
+}
 
-AudioRecorderContext::Error GstAudioRecorderContext::errorCode() const { return ErrorGeneric; }
+void GstAudioRecorderContext::stop()
+{
+    if (state == Idle || state == Stopping)
+        return;
+    state = Stopping;
+    exec([](AudioRecorderPipeline *p) { p->stop(); });
+}
+
+AudioRecorderContext::Error GstAudioRecorderContext::errorCode() const { return errorCode_; }
+
+void GstAudioRecorderContext::pipeline_started()
+{
+    if (state != Starting)
+        return;
+    state = Recording;
+    emit started();
+}
+
+void GstAudioRecorderContext::pipeline_paused()
+{
+    if (state == Paused)
+        emit paused();
+}
+
+void GstAudioRecorderContext::pipeline_error(int code)
+{
+    if (state == Idle)
+        return;
+    state      = Idle;
+    errorCode_ = Error(code);
+
+    // whatever was written is closed off
+    pipeline->m.lock();
+    pipeline->writer = nullptr;
+    pipeline->m.unlock();
+    if (writer) {
+        writer->push(QByteArray());
+        writer->deleteLater();
+        writer = nullptr;
+    }
+
+    emit error();
+}
+
+void GstAudioRecorderContext::writer_finished()
+{
+    if (state != Stopping || sender() != writer)
+        return;
+    state = Idle;
+
+    // one output device per recording
+    pipeline->m.lock();
+    pipeline->writer = nullptr;
+    pipeline->m.unlock();
+    writer->deleteLater();
+    writer = nullptr;
+
+    emit stopped();
+}
+
+// runs f in the glib thread, or right here if the loop isn't running
+void GstAudioRecorderContext::exec(std::function<void(AudioRecorderPipeline *)> &&f)
+{
+    std::shared_ptr<AudioRecorderPipeline> p = pipeline;
+    if (!gstLoop->execInContext([p, f](void *) { f(p.get()); }, nullptr))
+        f(p.get());
+}
+
+// builds ahead of time, so that starting is quick
+void GstAudioRecorderContext::prepare()
+{
+    if (state != Idle || deviceId.isEmpty())
+        return;
+    QString      id     = deviceId;
+    PAudioParams params = this->params;
+    exec([id, params](AudioRecorderPipeline *p) { p->prepare(id, params); });
+}
 
 } // namespace PsiMedia
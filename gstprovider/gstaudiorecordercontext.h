@@ -3,10 +3,45 @@
 
 #include "psimediaprovider.h"
 
+#include <QMutex>
+#include <functional>
+#include <memory>
+
+class QIODevice;
+
 namespace PsiMedia {
 
 class GstMainLoop;
+class AudioRecorderPipeline;
+
+// writes the recording in the thread the output device lives in, so a
+//   device moved to a thread of its own keeps the disk off the main thread
+class AudioRecorderWriter : public QObject {
+    Q_OBJECT
+
+public:
+    explicit AudioRecorderWriter(QIODevice *device);
+
+    // any thread.  an empty buf ends the recording and closes the device
+    void push(const QByteArray &buf);
+
+signals:
+    void finished();
+
+private slots:
+    void processIn();
 
+private:
+    QIODevice *       device;
+    QMutex            m;
+    bool              wake_pending = false;
+    QList<QByteArray> pending_in;
+};
+
+// capture -> noise suppression -> opus -> ogg.  the pipeline runs in the
+//   glib thread and is built ahead of time, but only opens the capture
+//   device while recording, so starting has to set it to playing and not
+//   build anything.  pausing just closes a valve in front of the encoder
 class GstAudioRecorderContext : public QObject, public AudioRecorderContext {
     Q_OBJECT
     Q_INTERFACES(PsiMedia::AudioRecorderContext)
@@ -14,10 +49,6 @@ class GstAudioRecorderContext : public QObject, public AudioRecorderContext {
 public:
     GstMainLoop *gstLoop;
 
-    bool isStarted      = false;
-    bool isStopping     = false;
-    bool pending_status = false;
-
     explicit GstAudioRecorderContext(GstMainLoop *_gstLoop, QObject *parent = nullptr);
     ~GstAudioRecorderContext() override;
 
@@ -33,6 +64,32 @@ public:
     void                pause() override;
     void                stop() override;
     Error               errorCode() const override;
+
+signals:
+    void started();
+    void preferencesUpdated();
+    void stopped();
+    void paused();
+    void error();
+
+private slots:
+    void pipeline_started();
+    void pipeline_paused();
+    void pipeline_error(int code);
+    void writer_finished();
+
+private:
+    enum State { Idle, Starting, Recording, Paused, Stopping };
+
+    std::shared_ptr<AudioRecorderPipeline> pipeline;
+    AudioRecorderWriter *                  writer = nullptr;
+    QString                                deviceId;
+    PAudioParams                           params;
+    State                                  state      = Idle;
+    Error                                  errorCode_ = ErrorGeneric;
+
+    void exec(std::function<void(AudioRecorderPipeline *)> &&f);
+    void prepare();
 };
 
 } // namespace PsiMedia
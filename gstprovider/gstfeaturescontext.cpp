@@ -2,8 +2,11 @@
 
 #include "devices.h"
 #include "gstthread.h"
+#include "logging.h"
 #include "modes.h"
 
+#include <algorithm>
+
 namespace PsiMedia {
 
 static PDevice gstDeviceToPDevice(const GstDevice &dev, PDevice::Type type)
@@ -16,6 +19,42 @@ static PDevice gstDeviceToPDevice(const GstDevice &dev, PDevice::Type type)
     return out;
 }
 
+// what it takes to get from one list to the other, matched by id
+static PDeviceChanges diffDevices(const QList<PDevice> &from, const QList<PDevice> &to)
+{
+    PDeviceChanges changes;
+    for (const PDevice &dev : to) {
+        auto it = std::find_if(from.cbegin(), from.cend(), [&dev](const PDevice &i) { return i.id == dev.id; });
+        if (it == from.cend())
+            changes.added += dev;
+        else if (it->name != dev.name || it->isDefault != dev.isDefault)
+            changes.changed += dev;
+    }
+    for (const PDevice &dev : from) {
+        if (std::none_of(to.cbegin(), to.cend(), [&dev](const PDevice &i) { return i.id == dev.id; }))
+            changes.removed += dev;
+    }
+    return changes;
+}
+
+// the part of update a monitor of types asked for
+static PFeaturesUpdate filterUpdate(const PFeaturesUpdate &update, int types)
+{
+    PFeaturesUpdate out;
+    out.types = update.types & types;
+    if (out.types & FeaturesContext::AudioOut)
+        out.audioOutputDevices = update.audioOutputDevices;
+    if (out.types & FeaturesContext::AudioIn)
+        out.audioInputDevices = update.audioInputDevices;
+    if (out.types & FeaturesContext::VideoIn)
+        out.videoInputDevices = update.videoInputDevices;
+    if (out.types & FeaturesContext::AudioModes)
+        out.supportedAudioModes = update.supportedAudioModes;
+    if (out.types & FeaturesContext::VideoModes)
+        out.supportedVideoModes = update.supportedVideoModes;
+    return out;
+}
+
 GstFeaturesContext::GstFeaturesContext(GstMainLoop *_gstLoop, DeviceMonitor *deviceMonitor, QObject *parent) :
     QObject(parent), gstLoop(_gstLoop), deviceMonitor(deviceMonitor)
 {
@@ -30,31 +69,35 @@ QObject *GstFeaturesContext::qobject() { return this; }
 
 void GstFeaturesContext::lookup(int types, QObject *receiver, std::function<void(const PFeatures &)> &&callback)
 {
-    watchers.emplace_back(types, true, QPointer<QObject>(receiver), std::move(callback));
-    watch();
+    if (updated) {
+        callback(features);
+        return;
+    }
+    lookups.emplace_back(types, QPointer<QObject>(receiver), std::move(callback));
 }
 
-void GstFeaturesContext::monitor(int types, QObject *receiver, std::function<void(const PFeatures &)> &&callback)
+void GstFeaturesContext::monitor(int types, QObject *receiver, std::function<void(const PFeaturesUpdate &)> &&callback)
 {
-    watchers.emplace_back(types, false, QPointer<QObject>(receiver), std::move(callback));
+    monitors.emplace_back(types, QPointer<QObject>(receiver), std::move(callback));
 }
 
-void GstFeaturesContext::watch()
+void GstFeaturesContext::notify(const PFeaturesUpdate &update)
 {
-    if (!updated)
-        return;
-    auto it = watchers.cbegin();
-    while (it != watchers.cend()) {
+    std::list<Watcher<PFeatures>> pending;
+    pending.swap(lookups);
+    for (const auto &w : pending) {
+        if (w.context)
+            w.callback(features);
+    }
+
+    auto it = monitors.cbegin();
+    while (it != monitors.cend()) {
         if (!it->context) {
-            it = watchers.erase(it);
-            continue;
-        }
-        // we should check updated flags/types here when implemented
-        it->callback(features);
-        if (it->oneShot) {
-            it = watchers.erase(it);
+            it = monitors.erase(it);
             continue;
         }
+        if (it->types & update.types)
+            it->callback(filterUpdate(update, it->types));
         ++it;
     }
 }
@@ -63,7 +106,7 @@ QList<PDevice> GstFeaturesContext::audioOutputDevices()
 {
     QList<PDevice> list;
     if (!deviceMonitor) {
-        qCritical("device monitor is not initialized or destroyed");
+        qCCritical(lcDevices, "device monitor is not initialized or destroyed");
         return list;
     }
     foreach (const GstDevice &i, deviceMonitor->devices(PDevice::AudioOut))
@@ -75,7 +118,7 @@ QList<PDevice> GstFeaturesContext::audioInputDevices()
 {
     QList<PDevice> list;
     if (!deviceMonitor) {
-        qCritical("device monitor is not initialized or destroyed");
+        qCCritical(lcDevices, "device monitor is not initialized or destroyed");
         return list;
     }
     foreach (const GstDevice &i, deviceMonitor->devices(PDevice::AudioIn))
@@ -87,7 +130,7 @@ QList<PDevice> GstFeaturesContext::videoInputDevices()
 {
     QList<PDevice> list;
     if (!deviceMonitor) {
-        qCritical("device monitor is not initialized or destroyed");
+        qCCritical(lcDevices, "device monitor is not initialized or destroyed");
         return list;
     }
     foreach (const GstDevice &i, deviceMonitor->devices(PDevice::VideoIn))
@@ -97,13 +140,42 @@ QList<PDevice> GstFeaturesContext::videoInputDevices()
 
 void GstFeaturesContext::updateDevices()
 {
-    updated                      = true;
-    features.audioInputDevices   = audioInputDevices();
-    features.audioOutputDevices  = audioOutputDevices();
-    features.videoInputDevices   = videoInputDevices();
-    features.supportedAudioModes = modes_supportedAudio();
-    features.supportedVideoModes = modes_supportedVideo();
-    watch();
+    // lookups wait for the first complete device list rather than being
+    //   answered with an empty one
+    if (!deviceMonitor->isReady())
+        return;
+
+    QList<PDevice> audioIn  = audioInputDevices();
+    QList<PDevice> audioOut = audioOutputDevices();
+    QList<PDevice> videoIn  = videoInputDevices();
+
+    PFeaturesUpdate update;
+    update.audioInputDevices  = diffDevices(features.audioInputDevices, audioIn);
+    update.audioOutputDevices = diffDevices(features.audioOutputDevices, audioOut);
+    update.videoInputDevices  = diffDevices(features.videoInputDevices, videoIn);
+    if (!update.audioInputDevices.isEmpty())
+        update.types |= AudioIn;
+    if (!update.audioOutputDevices.isEmpty())
+        update.types |= AudioOut;
+    if (!update.videoInputDevices.isEmpty())
+        update.types |= VideoIn;
+
+    // the modes only depend on the installed plugins
+    if (!updated) {
+        features.supportedAudioModes = modes_supportedAudio();
+        features.supportedVideoModes = modes_supportedVideo();
+        update.supportedAudioModes   = features.supportedAudioModes;
+        update.supportedVideoModes   = features.supportedVideoModes;
+        update.types |= AudioModes | VideoModes;
+    }
+
+    if (updated && !update.types)
+        return;
+    updated                     = true;
+    features.audioInputDevices  = audioIn;
+    features.audioOutputDevices = audioOut;
+    features.videoInputDevices  = videoIn;
+    notify(update);
 }
 
 } // namespace PsiMedia
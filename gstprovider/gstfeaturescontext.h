@@ -18,33 +18,30 @@ class GstFeaturesContext : public QObject, public FeaturesContext {
     Q_OBJECT
     Q_INTERFACES(PsiMedia::FeaturesContext)
 
-    struct Watcher {
-        Watcher(int types, bool oneShot, QPointer<QObject> context, std::function<void(const PFeatures &)> &&callback) :
-            types(types), oneShot(oneShot), context(context), callback(std::move(callback))
+    template <typename T> struct Watcher {
+        Watcher(int types, QPointer<QObject> context, std::function<void(const T &)> &&callback) :
+            types(types), context(context), callback(std::move(callback))
         {
         }
-        int                                    types   = 0;
-        bool                                   oneShot = true;
-        QPointer<QObject>                      context;
-        std::function<void(const PFeatures &)> callback;
+        int                            types = 0;
+        QPointer<QObject>              context;
+        std::function<void(const T &)> callback;
     };
 
 public:
-    QPointer<GstMainLoop> gstLoop;
-    DeviceMonitor *       deviceMonitor = nullptr;
-    PFeatures             features;
-    bool                  updated = false;
-    std::list<Watcher>    watchers;
+    QPointer<GstMainLoop>               gstLoop;
+    DeviceMonitor *                     deviceMonitor = nullptr;
+    PFeatures                           features;
+    bool                                updated = false;
+    std::list<Watcher<PFeatures>>       lookups; // until the first update
+    std::list<Watcher<PFeaturesUpdate>> monitors;
 
     explicit GstFeaturesContext(GstMainLoop *_gstLoop, DeviceMonitor *deviceMonitor, QObject *parent = nullptr);
 
     QObject *qobject() override;
 
     void lookup(int types, QObject *receiver, std::function<void(const PFeatures &)> &&callback) override;
-    void monitor(int types, QObject *receiver, std::function<void(const PFeatures &)> &&callback) override;
-
-private slots:
-    void watch();
+    void monitor(int types, QObject *receiver, std::function<void(const PFeaturesUpdate &)> &&callback) override;
 
 private:
     QList<PDevice> audioOutputDevices();
@@ -52,6 +49,7 @@ private:
     QList<PDevice> videoInputDevices();
 
     void updateDevices();
+    void notify(const PFeaturesUpdate &update);
 };
 
 } // namespace PsiMedia
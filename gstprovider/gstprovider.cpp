@@ -22,11 +22,13 @@
 #include "psimediaprovider.h"
 
 #include "devices.h"
+#include "eventrecorder.h"
 #include "gstaudiorecordercontext.h"
 #include "gstfeaturescontext.h"
 #include "gstprovider.h"
 #include "gstrtpsessioncontext.h"
 #include "gstthread.h"
+#include "logging.h"
 
 #include <QtPlugin>
 
@@ -52,7 +54,7 @@ GstProvider::GstProvider(const QVariantMap &params)
             connect(gstEventLoop, &GstMainLoop::started, this, &GstProvider::initialized, Qt::QueuedConnection);
             // do any custom stuff here before glib event loop started. it's already initialized
             if (!gstEventLoop->start()) {
-                qWarning("glib event loop failed to initialize");
+                qCWarning(lcThread, "glib event loop failed to initialize");
                 gstEventLoopThread.exit(1); // noop if ~GstProvider() was called first?
                 return;
             }
@@ -99,4 +101,6 @@ RtpSessionContext *GstProvider::createRtpSession() { return new GstRtpSessionCon
 
 AudioRecorderContext *GstProvider::createAudioRecorder() { return new GstAudioRecorderContext(gstEventLoop); }
 
+bool GstProvider::writeEventTrace(const QString &fileName) { return EventRecorder::writeChromeTrace(fileName); }
+
 }
@@ -49,6 +49,7 @@ public:
     FeaturesContext *     createFeatures() override;
     RtpSessionContext *   createRtpSession() override;
     AudioRecorderContext *createAudioRecorder() override;
+    bool                  writeEventTrace(const QString &fileName) override;
 
 signals:
     void initialized();
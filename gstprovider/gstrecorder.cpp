@@ -20,6 +20,7 @@
 
 #include "gstrecorder.h"
 
+#include "eventrecorder.h"
 #include "rwcontrol.h"
 
 namespace PsiMedia {
@@ -79,6 +80,8 @@ void GstRecorder::startNext()
 
 void GstRecorder::push_data_for_read(const QByteArray &buf)
 {
+    EventRecorder::record("recorder", "data", EventRecorder::Instant, buf.size());
+
     QMutexLocker locker(&m);
     pending_in += buf;
     if (!wake_pending) {
@@ -95,6 +98,8 @@ void GstRecorder::processIn()
     pending_in.clear();
     m.unlock();
 
+    EventRecorder::record("recorder", "write", EventRecorder::Instant, in.count());
+
     QPointer<QObject> self = this;
 
     while (!in.isEmpty()) {
@@ -20,6 +20,7 @@
 
 #include "gstrtpchannel.h"
 
+#include "eventrecorder.h"
 #include "gstrtpsessioncontext.h"
 
 //----------------------------------------------------------------------------
@@ -65,6 +66,7 @@ void GstRtpChannel::write(const PRtpPacket &rtp)
         return;
     m.unlock();
 
+    EventRecorder::record("channel", "write", EventRecorder::Instant, rtp.rawValue.size());
     receiver_push_packet_for_write(rtp);
     ++written_pending;
 
@@ -73,15 +75,60 @@ void GstRtpChannel::write(const PRtpPacket &rtp)
         QMetaObject::invokeMethod(this, "processOut", Qt::QueuedConnection);
 }
 
+void GstRtpChannel::setReadCallback(std::function<void(const PRtpPacket &)> &&callback)
+{
+    // called from inside the callback: callback_m is already held by this
+    //   thread and the running callback can't be destroyed under itself, so
+    //   the new one is swapped in once the running one returns
+    if (callbackThread.loadAcquire() == QThread::currentThread()) {
+        nextReadCallback   = std::move(callback);
+        readCallbackQueued = true;
+        return;
+    }
+
+    // blocks while the old callback is running
+    QMutexLocker locker(&callback_m);
+    readCallback = std::move(callback);
+}
+
 void GstRtpChannel::push_packet_for_read(const PRtpPacket &rtp)
 {
+    EventRecorder::record("channel", "push", EventRecorder::Instant, rtp.rawValue.size());
+
+    // a disabled channel drops packets in direct mode too
+    m.lock();
+    bool on = enabled;
+    m.unlock();
+    if (!on)
+        return;
+
+    {
+        // direct mode: no queuing and no event loop hop. the callback is
+        //   called with callback_m held, so it can't be replaced under us
+        QMutexLocker locker(&callback_m);
+        if (readCallback) {
+            callbackThread.storeRelease(QThread::currentThread());
+            readCallback(rtp);
+            callbackThread.storeRelease(nullptr);
+            if (readCallbackQueued) {
+                readCallback       = std::move(nextReadCallback);
+                nextReadCallback   = nullptr;
+                readCallbackQueued = false;
+            }
+            return;
+        }
+    }
+
     QMutexLocker locker(&m);
     if (!enabled)
         return;
 
     // if the queue is full, bump off the oldest to make room
-    if (pending_in.count() >= QUEUE_PACKET_MAX)
+    if (!lossless && pending_in.count() >= QUEUE_PACKET_MAX) {
         pending_in.removeFirst();
+        dropped.ref();
+        EventRecorder::record("channel", "drop");
+    }
 
     pending_in += rtp;
 
@@ -103,6 +150,7 @@ void GstRtpChannel::processIn()
     pending_in.clear();
     m.unlock();
 
+    EventRecorder::record("channel", "deliver", EventRecorder::Instant, in.count() - oldcount);
     if (in.count() > oldcount)
         emit readyRead();
 }
@@ -23,8 +23,11 @@
 
 #include "psimediaprovider.h"
 
+#include <QAtomicInt>
+#include <QAtomicPointer>
 #include <QMutex>
 #include <QObject>
+#include <QThread>
 
 namespace PsiMedia {
 
@@ -43,9 +46,17 @@ public:
     // QTime wake_time;
     bool              wake_pending = false;
     QList<PRtpPacket> pending_in;
+    QAtomicInt        dropped;          // bumped off pending_in before the app read them
+    bool              lossless = false; // offline, pending_in is not capped
 
     int written_pending = 0;
 
+    QMutex                                  callback_m;
+    std::function<void(const PRtpPacket &)> readCallback;
+    QAtomicPointer<QThread>                 callbackThread;     // running readCallback, if any
+    std::function<void(const PRtpPacket &)> nextReadCallback;   // set from inside readCallback
+    bool                                    readCallbackQueued = false;
+
     GstRtpChannel();
 
     virtual QObject *qobject();
@@ -58,6 +69,8 @@ public:
 
     virtual void write(const PRtpPacket &rtp);
 
+    virtual void setReadCallback(std::function<void(const PRtpPacket &)> &&callback);
+
     // session calls this, which may be in another thread
     void push_packet_for_read(const PRtpPacket &rtp);
 
@@ -1,6 +1,8 @@
 #include "gstrtpsessioncontext.h"
 
+#include "bins.h"
 #include "gstthread.h"
+#include "logging.h"
 #ifdef QT_GUI_LIB
 #include "gstvideowidget.h"
 #endif
@@ -9,7 +11,7 @@ namespace PsiMedia {
 
 GstRtpSessionContext::GstRtpSessionContext(GstMainLoop *_gstLoop, QObject *parent) :
     QObject(parent), gstLoop(_gstLoop), control(nullptr), isStarted(false), isStopping(false), pending_status(false),
-    recorder(this), allow_writes(false)
+    framesDisplayed(0), latencyTracing(false), recorder(this), allow_writes(false)
 {
 #ifdef QT_GUI_LIB
     outputWidget  = nullptr;
@@ -47,6 +49,12 @@ void GstRtpSessionContext::cleanup()
 
     recorder.control = nullptr;
 
+    if (control) {
+        lastLatencyStages = control->latencyStages();
+        lastAudioMetrics  = audioStreamMetrics();
+        lastVideoMetrics  = videoStreamMetrics();
+    }
+
     write_mutex.lock();
     allow_writes = false;
     delete control;
@@ -106,6 +114,12 @@ void GstRtpSessionContext::setFileLoopEnabled(bool enabled)
         control->updateDevices(devices);
 }
 
+void GstRtpSessionContext::setOfflineMode(bool enabled)
+{
+    // only read when the pipelines are built
+    devices.offline = enabled;
+}
+
 void GstRtpSessionContext::setVideoOutputWidget(VideoWidgetContext *widget)
 {
     // no change?
@@ -136,14 +150,43 @@ void GstRtpSessionContext::setVideoPreviewWidget(VideoWidgetContext *widget)
     delete previewWidget;
     previewWidget = nullptr;
 
-    if (widget)
+    if (widget) {
         previewWidget = new GstVideoWidget(widget, this);
+        connect(previewWidget, SIGNAL(desiredSizeChanged(const QSize &)), SLOT(updatePreviewSize()));
+    }
 
     devices.useVideoPreview = widget != nullptr;
+    devices.previewSize     = desiredPreviewSize();
     if (control)
         control->updateDevices(devices);
 }
 
+void GstRtpSessionContext::setVideoPreviewSize(const QSize &size)
+{
+    previewSize = size;
+    updatePreviewSize();
+}
+
+QSize GstRtpSessionContext::desiredPreviewSize() const
+{
+    if (previewSize.isValid())
+        return previewSize;
+    if (previewWidget)
+        return previewWidget->desired_size();
+    return QSize();
+}
+
+void GstRtpSessionContext::updatePreviewSize()
+{
+    QSize size = desiredPreviewSize();
+    if (size == devices.previewSize)
+        return;
+
+    devices.previewSize = size;
+    if (control)
+        control->setPreviewSize(size);
+}
+
 void GstRtpSessionContext::setRecorder(QIODevice *recordDevice)
 {
     // can't assign a new recording device after stopping
@@ -168,6 +211,29 @@ void GstRtpSessionContext::setLocalVideoPreferences(const QList<PVideoParams> &p
 
 void GstRtpSessionContext::setMaximumSendingBitrate(int kbps) { codecs.maximumSendingBitrate = kbps; }
 
+void GstRtpSessionContext::setVideoEncodingCpuBudget(int percent) { codecs.videoEncodingCpuBudget = percent; }
+
+void GstRtpSessionContext::setSrtpParameters(const PSrtpParams &local, const PSrtpParams &remote)
+{
+    if (!bins_srtp_params_valid(local) || !bins_srtp_params_valid(remote))
+        return;
+
+    // once started, only rekeying is possible
+    if (control
+        && (local.key.isEmpty() != codecs.localSrtp.key.isEmpty()
+            || remote.key.isEmpty() != codecs.remoteSrtp.key.isEmpty())) {
+        qCWarning(lcWorker, "srtp: encryption can only be turned on or off before starting");
+        return;
+    }
+
+    codecs.localSrtp  = local;
+    codecs.remoteSrtp = remote;
+    if (control)
+        control->updateSrtp(local, remote);
+    else
+        warnEncryptedCapture();
+}
+
 void GstRtpSessionContext::setRemoteAudioPreferences(const QList<PPayloadInfo> &info)
 {
     codecs.useRemoteAudioPayloadInfo = true;
@@ -192,6 +258,10 @@ void GstRtpSessionContext::start()
     connect(control, SIGNAL(outputFrame(const QImage &)), SLOT(control_outputFrame(const QImage &)));
     connect(control, SIGNAL(audioOutputIntensityChanged(int)), SLOT(control_audioOutputIntensityChanged(int)));
     connect(control, SIGNAL(audioInputIntensityChanged(int)), SLOT(control_audioInputIntensityChanged(int)));
+    connect(control, SIGNAL(videoAdaptationChanged(const QSize &, int, bool)),
+            SLOT(control_videoAdaptationChanged(const QSize &, int, bool)));
+    connect(control, SIGNAL(offlineProgress(qint64, qint64, qint64)),
+            SLOT(control_offlineProgress(qint64, qint64, qint64)));
 
     control->app            = this;
     control->cb_rtpAudioOut = cb_control_rtpAudioOut;
@@ -203,10 +273,32 @@ void GstRtpSessionContext::start()
 
     recorder.control = control;
 
-    lastStatus     = RwControlStatus();
-    isStarted      = false;
-    pending_status = true;
+    lastStatus      = RwControlStatus();
+    isStarted       = false;
+    pending_status  = true;
+    framesDisplayed = 0;
+    lastLatencyStages.clear();
+    lastAudioMetrics = PStreamMetrics();
+    lastVideoMetrics = PStreamMetrics();
+    audioRtp.dropped.storeRelease(0);
+    videoRtp.dropped.storeRelease(0);
+    for (GstRtpChannel *channel : { &audioRtp, &videoRtp }) {
+        QMutexLocker locker(&channel->m);
+        channel->lossless = devices.offline;
+    }
     control->start(devices, codecs);
+    if (latencyTracing)
+        control->setLatencyTracing(true);
+
+    // capture every session, "%1" is replaced by a counter
+    static QAtomicInt captures;
+    QString           captureName = QString::fromLocal8Bit(qgetenv("PSI_RTP_CAPTURE"));
+    if (!captureName.isEmpty() && !capture.isOpen()) {
+        if (captureName.contains("%1"))
+            captureName = captureName.arg(captures.fetchAndAddRelaxed(1) + 1);
+        capture.open(captureName);
+    }
+    warnEncryptedCapture();
 }
 
 void GstRtpSessionContext::updatePreferences()
@@ -241,6 +333,13 @@ void GstRtpSessionContext::pauseVideo()
     control->setTransmit(transmit);
 }
 
+void GstRtpSessionContext::requestKeyframe()
+{
+    QMutexLocker locker(&write_mutex);
+    if (allow_writes && control)
+        control->requestKeyframe();
+}
+
 void GstRtpSessionContext::stop()
 {
     Q_ASSERT(control && !isStopping);
@@ -290,6 +389,84 @@ void GstRtpSessionContext::setInputVolume(int level)
 
 RtpSessionContext::Error GstRtpSessionContext::errorCode() const { return static_cast<Error>(lastStatus.errorCode); }
 
+PVideoOutputStats GstRtpSessionContext::videoOutputStats() const
+{
+    if (!control)
+        return PVideoOutputStats();
+
+    // the worker counts frames handed to us. frames we never saw because
+    //   a newer one replaced them in the queue were dropped as well
+    PVideoOutputStats stats = control->videoOutputStats();
+    stats.droppedLate += qMax(0, stats.displayed - framesDisplayed);
+    stats.displayed = framesDisplayed;
+    return stats;
+}
+
+PStreamMetrics GstRtpSessionContext::audioStreamMetrics() const
+{
+    if (!control)
+        return lastAudioMetrics;
+
+    PStreamMetrics m = control->audioStreamMetrics();
+    m.packetsDropped = audioRtp.dropped.loadAcquire();
+    return m;
+}
+
+PStreamMetrics GstRtpSessionContext::videoStreamMetrics() const
+{
+    if (!control)
+        return lastVideoMetrics;
+
+    PStreamMetrics m = control->videoStreamMetrics();
+    m.packetsDropped = videoRtp.dropped.loadAcquire();
+    return m;
+}
+
+void GstRtpSessionContext::setLatencyTracing(bool enabled)
+{
+    latencyTracing = enabled;
+    lastLatencyStages.clear();
+    if (control)
+        control->setLatencyTracing(enabled);
+}
+
+bool GstRtpSessionContext::setRtpCapture(const QString &fileName)
+{
+    if (fileName.isEmpty()) {
+        capture.close();
+        return true;
+    }
+
+    if (!capture.open(fileName))
+        return false;
+    warnEncryptedCapture();
+    if (isStarted)
+        capturePayloadInfo();
+    return true;
+}
+
+void GstRtpSessionContext::capturePayloadInfo()
+{
+    capture.writePayloadInfo(lastStatus.localAudioPayloadInfo, lastStatus.localVideoPayloadInfo,
+                             lastStatus.remoteAudioPayloadInfo, lastStatus.remoteVideoPayloadInfo);
+}
+
+// the capture is taken where the channels meet the app, so with srtp it holds
+//   the packets as they go over the wire, and no keys
+void GstRtpSessionContext::warnEncryptedCapture()
+{
+    if (capture.isOpen() && (!codecs.localSrtp.key.isEmpty() || !codecs.remoteSrtp.key.isEmpty()))
+        qCWarning(lcWorker, "rtp capture: the session uses srtp, the capture holds encrypted packets");
+}
+
+QList<PLatencyStage> GstRtpSessionContext::latencyStages() const
+{
+    // the worker goes away on stop, so its results are kept from cleanup()
+    if (control)
+        return control->latencyStages();
+    return lastLatencyStages;
+}
+
 RtpChannelContext *GstRtpSessionContext::audioRtpChannel() { return &audioRtp; }
 
 RtpChannelContext *GstRtpSessionContext::videoRtpChannel() { return &videoRtp; }
@@ -302,12 +479,21 @@ void GstRtpSessionContext::dumpPipeline(std::function<void(const QStringList &)>
         callback(QStringList());
 }
 
+void GstRtpSessionContext::pipelineSnapshot(std::function<void(const QVariantMap &)> callback)
+{
+    if (control)
+        control->pipelineSnapshot(callback);
+    else
+        callback(QVariantMap());
+}
+
 void GstRtpSessionContext::push_packet_for_write(GstRtpChannel *from, const PRtpPacket &rtp)
 {
     QMutexLocker locker(&write_mutex);
     if (!allow_writes || !control)
         return;
 
+    capture.writePacket(from == &videoRtp ? PRtpCapture::Video : 0, rtp);
     if (from == &audioRtp)
         control->rtpAudioIn(rtp);
     else if (from == &videoRtp)
@@ -342,6 +528,7 @@ void GstRtpSessionContext::control_statusReady(const RwControlStatus &status)
 
         pending_status = false;
 
+        capturePayloadInfo();
         if (!isStarted) {
             isStarted = true;
 
@@ -362,6 +549,7 @@ void GstRtpSessionContext::control_previewFrame(const QImage &img)
 
 void GstRtpSessionContext::control_outputFrame(const QImage &img)
 {
+    ++framesDisplayed;
     if (outputWidget)
         outputWidget->show_frame(img);
 }
@@ -376,6 +564,16 @@ void GstRtpSessionContext::control_audioInputIntensityChanged(int intensity)
     emit audioInputIntensityChanged(intensity);
 }
 
+void GstRtpSessionContext::control_videoAdaptationChanged(const QSize &size, int fps, bool degraded)
+{
+    emit videoAdaptationChanged(size, fps, degraded);
+}
+
+void GstRtpSessionContext::control_offlineProgress(qint64 position, qint64 duration, qint64 remaining)
+{
+    emit offlineProgress(position, duration, remaining);
+}
+
 void GstRtpSessionContext::recorder_stopped() { emit stoppedRecording(); }
 
 void GstRtpSessionContext::cb_control_rtpAudioOut(const PRtpPacket &packet, void *app)
@@ -393,9 +591,17 @@ void GstRtpSessionContext::cb_control_recordData(const QByteArray &packet, void
     static_cast<GstRtpSessionContext *>(app)->control_recordData(packet);
 }
 
-void GstRtpSessionContext::control_rtpAudioOut(const PRtpPacket &packet) { audioRtp.push_packet_for_read(packet); }
+void GstRtpSessionContext::control_rtpAudioOut(const PRtpPacket &packet)
+{
+    capture.writePacket(PRtpCapture::Sent, packet);
+    audioRtp.push_packet_for_read(packet);
+}
 
-void GstRtpSessionContext::control_rtpVideoOut(const PRtpPacket &packet) { videoRtp.push_packet_for_read(packet); }
+void GstRtpSessionContext::control_rtpVideoOut(const PRtpPacket &packet)
+{
+    capture.writePacket(PRtpCapture::Video | PRtpCapture::Sent, packet);
+    videoRtp.push_packet_for_read(packet);
+}
 
 void GstRtpSessionContext::control_recordData(const QByteArray &packet) { recorder.push_data_for_read(packet); }
 
@@ -25,6 +25,7 @@
 
 #include "gstrecorder.h"
 #include "gstrtpchannel.h"
+#include "rtpcapture.h"
 #include "rwcontrol.h"
 
 namespace PsiMedia {
@@ -50,6 +51,11 @@ public:
     bool                   isStarted;
     bool                   isStopping;
     bool                   pending_status;
+    int                    framesDisplayed; // output frames that reached us, see videoOutputStats()
+    QSize                  previewSize;     // as set by the user, see desiredPreviewSize()
+    bool                   latencyTracing;
+    QList<PLatencyStage>   lastLatencyStages;
+    PStreamMetrics         lastAudioMetrics, lastVideoMetrics;
 
 #ifdef QT_GUI_LIB
     GstVideoWidget *outputWidget, *previewWidget;
@@ -57,6 +63,9 @@ public:
 
     GstRecorder recorder;
 
+    // rtp of both channels, see setRtpCapture()
+    RtpCaptureFile capture;
+
     // keep these parentless, so they can switch threads
     GstRtpChannel audioRtp;
     GstRtpChannel videoRtp;
@@ -76,42 +85,54 @@ public:
     void setFileInput(const QString &fileName) override;
     void setFileDataInput(const QByteArray &fileData) override;
     void setFileLoopEnabled(bool enabled) override;
+    void setOfflineMode(bool enabled) override;
 
 #ifdef QT_GUI_LIB
     void setVideoOutputWidget(VideoWidgetContext *widget) override;
     void setVideoPreviewWidget(VideoWidgetContext *widget) override;
 #endif
-
-    void                setRecorder(QIODevice *recordDevice) override;
-    void                stopRecording() override;
-    void                setLocalAudioPreferences(const QList<PAudioParams> &params) override;
-    void                setLocalVideoPreferences(const QList<PVideoParams> &params) override;
-    void                setMaximumSendingBitrate(int kbps) override;
-    void                setRemoteAudioPreferences(const QList<PPayloadInfo> &info) override;
-    void                setRemoteVideoPreferences(const QList<PPayloadInfo> &info) override;
-    void                start() override;
-    void                updatePreferences() override;
-    void                transmitAudio() override;
-    void                transmitVideo() override;
-    void                pauseAudio() override;
-    void                pauseVideo() override;
-    void                stop() override;
-    QList<PPayloadInfo> localAudioPayloadInfo() const override;
-    QList<PPayloadInfo> localVideoPayloadInfo() const override;
-    QList<PPayloadInfo> remoteAudioPayloadInfo() const override;
-    QList<PPayloadInfo> remoteVideoPayloadInfo() const override;
-    QList<PAudioParams> audioParams() const override;
-    QList<PVideoParams> videoParams() const override;
-    bool                canTransmitAudio() const override;
-    bool                canTransmitVideo() const override;
-    int                 outputVolume() const override;
-    void                setOutputVolume(int level) override;
-    int                 inputVolume() const override;
-    void                setInputVolume(int level) override;
-    Error               errorCode() const override;
-    RtpChannelContext * audioRtpChannel() override;
-    RtpChannelContext * videoRtpChannel() override;
-    void                dumpPipeline(std::function<void(const QStringList &)> callback) override;
+    void setVideoPreviewSize(const QSize &size) override;
+
+    void                 setRecorder(QIODevice *recordDevice) override;
+    void                 stopRecording() override;
+    void                 setLocalAudioPreferences(const QList<PAudioParams> &params) override;
+    void                 setLocalVideoPreferences(const QList<PVideoParams> &params) override;
+    void                 setMaximumSendingBitrate(int kbps) override;
+    void                 setVideoEncodingCpuBudget(int percent) override;
+    void                 setSrtpParameters(const PSrtpParams &local, const PSrtpParams &remote) override;
+    void                 setRemoteAudioPreferences(const QList<PPayloadInfo> &info) override;
+    void                 setRemoteVideoPreferences(const QList<PPayloadInfo> &info) override;
+    void                 start() override;
+    void                 updatePreferences() override;
+    void                 transmitAudio() override;
+    void                 transmitVideo() override;
+    void                 pauseAudio() override;
+    void                 pauseVideo() override;
+    void                 requestKeyframe() override;
+    void                 stop() override;
+    QList<PPayloadInfo>  localAudioPayloadInfo() const override;
+    QList<PPayloadInfo>  localVideoPayloadInfo() const override;
+    QList<PPayloadInfo>  remoteAudioPayloadInfo() const override;
+    QList<PPayloadInfo>  remoteVideoPayloadInfo() const override;
+    QList<PAudioParams>  audioParams() const override;
+    QList<PVideoParams>  videoParams() const override;
+    bool                 canTransmitAudio() const override;
+    bool                 canTransmitVideo() const override;
+    int                  outputVolume() const override;
+    void                 setOutputVolume(int level) override;
+    int                  inputVolume() const override;
+    void                 setInputVolume(int level) override;
+    Error                errorCode() const override;
+    PVideoOutputStats    videoOutputStats() const override;
+    PStreamMetrics       audioStreamMetrics() const override;
+    PStreamMetrics       videoStreamMetrics() const override;
+    void                 setLatencyTracing(bool enabled) override;
+    QList<PLatencyStage> latencyStages() const override;
+    bool                 setRtpCapture(const QString &fileName) override;
+    RtpChannelContext *  audioRtpChannel() override;
+    RtpChannelContext *  videoRtpChannel() override;
+    void                 dumpPipeline(std::function<void(const QStringList &)> callback) override;
+    void                 pipelineSnapshot(std::function<void(const QVariantMap &)> callback) override;
 
     // channel calls this, which may be in another thread
     void push_packet_for_write(GstRtpChannel *from, const PRtpPacket &rtp);
@@ -121,6 +142,8 @@ signals:
     void preferencesUpdated();
     void audioOutputIntensityChanged(int intensity);
     void audioInputIntensityChanged(int intensity);
+    void videoAdaptationChanged(const QSize &size, int fps, bool degraded);
+    void offlineProgress(qint64 position, qint64 duration, qint64 remaining);
     void stoppedRecording();
     void stopped();
     void finished();
@@ -132,9 +155,16 @@ private slots:
     void control_outputFrame(const QImage &img);
     void control_audioOutputIntensityChanged(int intensity);
     void control_audioInputIntensityChanged(int intensity);
+    void control_videoAdaptationChanged(const QSize &size, int fps, bool degraded);
+    void control_offlineProgress(qint64 position, qint64 duration, qint64 remaining);
     void recorder_stopped();
+    void updatePreviewSize();
 
 private:
+    QSize desiredPreviewSize() const;
+    void  capturePayloadInfo();
+    void  warnEncryptedCapture();
+
     static void cb_control_rtpAudioOut(const PRtpPacket &packet, void *app);
     static void cb_control_rtpVideoOut(const PRtpPacket &packet, void *app);
     static void cb_control_recordData(const QByteArray &packet, void *app);
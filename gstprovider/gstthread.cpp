@@ -20,6 +20,7 @@
 
 #include "gstthread.h"
 
+#include "logging.h"
 #include <QCoreApplication>
 #include <QDir>
 #include <QIcon>
@@ -176,7 +177,7 @@ public:
         uint need_min = 4;
         uint need_mic = 0;
         if (compare_gst_version(major, minor, micro, need_maj, need_min, need_mic) < 0) {
-            qDebug("Need GStreamer version %d.%d.%d", need_maj, need_min, need_mic);
+            qCWarning(lcThread, "Need GStreamer version %d.%d.%d", need_maj, need_min, need_mic);
             success = false;
             return;
         }
@@ -218,7 +219,7 @@ public:
         foreach (const QString &name, reqelem) {
             GstElement *e = gst_element_factory_make(name.toLatin1().data(), nullptr);
             if (!e) {
-                qDebug("Unable to load element '%s'.", qPrintable(name));
+                qCWarning(lcThread, "Unable to load element '%s'.", qPrintable(name));
                 success = false;
                 return;
             }
@@ -369,7 +370,7 @@ void GstMainLoop::stop()
         bool       stopped = execInContext(
             [this, &stopSem](void *) {
                 g_main_loop_quit(d->mainLoop);
-                qDebug("g_main_loop_quit");
+                qCDebug(lcThread, "g_main_loop_quit");
                 stopSem.release(1);
             },
             this);
@@ -377,7 +378,7 @@ void GstMainLoop::stop()
         if (stopped) // if stop event really was scheduled to glib main loop.
             stopSem.acquire(1);
 
-        qDebug("GstMainLoop::stop() finished");
+        qCDebug(lcThread, "GstMainLoop::stop() finished");
     }
     d->stateMutex.unlock();
 }
@@ -401,7 +402,7 @@ bool GstMainLoop::execInContext(const ContextCallback &cb, void *userData)
 
 bool GstMainLoop::start()
 {
-    qDebug("GStreamer thread started");
+    qCDebug(lcThread, "GStreamer thread started");
 
     // this will be unlocked as soon as the mainloop runs
     d->stateMutex.lock();
@@ -417,7 +418,7 @@ bool GstMainLoop::start()
         d->success = false;
         delete d->gstSession;
         d->gstSession = nullptr;
-        qWarning("GStreamer thread completed (error)");
+        qCWarning(lcThread, "GStreamer thread completed (error)");
         d->stateMutex.unlock();
         return false;
     }
@@ -437,7 +438,7 @@ bool GstMainLoop::start()
     g_source_set_callback(timer, GstMainLoop::Private::cb_loop_started, d, nullptr);
     // d->stateMutex.unlock();
 
-    qDebug("kick off glib event loop");
+    qCDebug(lcThread, "kick off glib event loop");
     // kick off the event loop
     g_main_loop_run(d->mainLoop);
 
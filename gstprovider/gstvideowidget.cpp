@@ -24,6 +24,10 @@
 #include <QPalette>
 #include <QWidget>
 
+// above this frame rate scaling quality is not worth its cost, the
+//   picture is replaced before anyone can tell
+#define SMOOTH_SCALING_MAX_FPS 20
+
 namespace PsiMedia {
 
 GstVideoWidget::GstVideoWidget(VideoWidgetContext *_context, QObject *parent) : QObject(parent), context(_context)
@@ -39,19 +43,29 @@ GstVideoWidget::GstVideoWidget(VideoWidgetContext *_context, QObject *parent) :
 
 void GstVideoWidget::show_frame(const QImage &image)
 {
-    curImage = image;
-    context->qwidget()->update();
-}
+    // same frame again, nothing to repaint
+    if (!curImage.isNull() && image.cacheKey() == curImage.cacheKey())
+        return;
 
-void GstVideoWidget::context_resized(const QSize &newSize) { Q_UNUSED(newSize); }
+    if (frameTimer.isValid()) {
+        int ms        = int(frameTimer.restart());
+        frameInterval = frameInterval ? (frameInterval * 7 + ms) / 8 : ms;
+    } else
+        frameTimer.start();
 
-void GstVideoWidget::context_paintEvent(QPainter *p)
-{
-    if (curImage.isNull())
-        return;
+    curImage    = image;
+    scaledImage = QImage();
 
+    // only the picture area changes, plus whatever the previous frame
+    //   covered if the geometry changed
+    QRect r = imageRect(image.size());
+    context->qwidget()->update(lastRect.isNull() ? r : r.united(lastRect));
+}
+
+QRect GstVideoWidget::imageRect(const QSize &imageSize) const
+{
     QSize size    = context->qwidget()->size();
-    QSize newSize = curImage.size();
+    QSize newSize = imageSize;
     newSize.scale(size, Qt::KeepAspectRatio);
     int xoff = 0;
     int yoff = 0;
@@ -59,18 +73,38 @@ void GstVideoWidget::context_paintEvent(QPainter *p)
         xoff = (size.width() - newSize.width()) / 2;
     else if (newSize.height() < size.height())
         yoff = (size.height() - newSize.height()) / 2;
+    return QRect(QPoint(xoff, yoff), newSize);
+}
+
+QSize GstVideoWidget::desired_size() const { return context->qwidget()->size(); }
+
+void GstVideoWidget::context_resized(const QSize &newSize) { emit desiredSizeChanged(newSize); }
+
+void GstVideoWidget::context_paintEvent(QPainter *p)
+{
+    if (curImage.isNull())
+        return;
+
+    QRect r = imageRect(curImage.size());
 
     // ideally, the backend will follow desired_size() and give
-    //   us images that generally don't need resizing
-    QImage i;
-    if (curImage.size() != newSize) {
-        // the IgnoreAspectRatio is okay here, since we
-        //   used KeepAspectRatio earlier
-        i = curImage.scaled(newSize, Qt::IgnoreAspectRatio, Qt::SmoothTransformation);
-    } else
-        i = curImage;
+    //   us images that generally don't need resizing.  otherwise
+    //   scale once per frame and size, not on every expose
+    if (curImage.size() == r.size())
+        scaledImage = curImage;
+    else {
+        bool smooth = !frameInterval || frameInterval > 1000 / SMOOTH_SCALING_MAX_FPS;
+        if (scaledImage.size() != r.size() || (smooth && !scaledSmooth)) {
+            // the IgnoreAspectRatio is okay here, since we
+            //   used KeepAspectRatio earlier
+            scaledImage  = curImage.scaled(r.size(), Qt::IgnoreAspectRatio,
+                                           smooth ? Qt::SmoothTransformation : Qt::FastTransformation);
+            scaledSmooth = smooth;
+        }
+    }
 
-    p->drawImage(xoff, yoff, i);
+    p->drawImage(r.topLeft(), scaledImage);
+    lastRect = r;
 }
 
 } // namespace PsiMedia
@@ -23,6 +23,7 @@
 
 #include "psimediaprovider.h"
 
+#include <QElapsedTimer>
 #include <QImage>
 
 namespace PsiMedia {
@@ -41,9 +42,26 @@ public:
 
     void show_frame(const QImage &image);
 
+    // size frames are best delivered in
+    QSize desired_size() const;
+
+Q_SIGNALS:
+    void desiredSizeChanged(const QSize &size);
+
 private Q_SLOTS:
     void context_resized(const QSize &newSize);
     void context_paintEvent(QPainter *p);
+
+private:
+    // curImage fitted into the widget, rebuilt only for a new frame or size
+    QImage scaledImage;
+    bool   scaledSmooth = false;
+    QRect  lastRect; // where the previous frame was drawn
+
+    QElapsedTimer frameTimer;
+    int           frameInterval = 0; // smoothed, in ms
+
+    QRect imageRect(const QSize &imageSize) const;
 };
 
 } // namespace PsiMedia
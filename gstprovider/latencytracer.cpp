@@ -0,0 +1,566 @@
+/*
+ * Copyright (C) 2026  Psi IM Team
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301  USA
+ *
+ */
+
+#include "latencytracer.h"
+
+#include <QMutexLocker>
+#include <gst/rtp/rtp.h>
+
+namespace PsiMedia {
+
+// upper bounds of the histogram buckets, in us.  the last bucket is open
+static const int bucket_limits[] = { 1000, 2000, 5000, 10000, 20000, 50000, 100000, 200000, 500000 };
+
+static int bucket_of(gint64 latency)
+{
+    int bucket = 0;
+    while (bucket < int(sizeof(bucket_limits) / sizeof(bucket_limits[0])) && latency > bucket_limits[bucket])
+        ++bucket;
+    return bucket;
+}
+
+static GstClockTime running_time(GstElement *e)
+{
+    GstClock *clock = gst_element_get_clock(e);
+    if (!clock)
+        return GST_CLOCK_TIME_NONE;
+    GstClockTime now = gst_clock_get_time(clock);
+    gst_object_unref(clock);
+
+    GstClockTime base = gst_element_get_base_time(e);
+    return now > base ? now - base : 0;
+}
+
+LatencyTracer::~LatencyTracer() { detach(); }
+
+int LatencyTracer::addStage(const QString &stream, const QString &name, GstElement *element)
+{
+    Stage s;
+    s.stream  = stream;
+    s.name    = name;
+    s.element = GST_ELEMENT(gst_object_ref(element));
+    for (int n = 0; n < RecentSize; ++n) {
+        s.recentPts[n]  = GST_CLOCK_TIME_NONE;
+        s.recentTime[n] = GST_CLOCK_TIME_NONE;
+    }
+    for (int n = 0; n < BucketCount; ++n)
+        s.histogram[n] = 0;
+    for (int n = list.count() - 1; n >= 0; --n) {
+        if (list[n].stream == stream) {
+            s.previous = n;
+            break;
+        }
+    }
+    list += s;
+    attached.storeRelease(1);
+    return list.count() - 1;
+}
+
+// called with the mutex held
+void LatencyTracer::addProbe(int index, GstPad *pad, GstPadProbeType type)
+{
+    auto hook        = new Hook;
+    hook->tracer     = this;
+    hook->index      = index;
+    hook->generation = generation;
+
+    list[index].pad   = pad;
+    list[index].probe = gst_pad_add_probe(pad, type, cb_probe, hook, cb_free_hook);
+}
+
+void LatencyTracer::addPadStage(const QString &stream, const QString &name, GstElement *element, const char *padName)
+{
+    GstPad *pad = gst_element_get_static_pad(element, padName);
+    if (!pad)
+        return;
+
+    QMutexLocker locker(&mutex);
+    int          index = addStage(stream, name, element);
+    addProbe(index, pad, GstPadProbeType(GST_PAD_PROBE_TYPE_BUFFER | GST_PAD_PROBE_TYPE_BUFFER_LIST));
+}
+
+void LatencyTracer::addSinkStage(const QString &stream, const QString &name, GstElement *element, const char *padName)
+{
+    GstPad *pad = gst_element_get_static_pad(element, padName);
+    if (!pad)
+        return;
+
+    QMutexLocker locker(&mutex);
+    int          index = addStage(stream, name, element);
+
+    list[index].untilDue = true;
+
+    // the pipeline latency is announced to the sinks, and passes on upstream
+    //   from there
+    auto type = GST_PAD_PROBE_TYPE_BUFFER | GST_PAD_PROBE_TYPE_BUFFER_LIST | GST_PAD_PROBE_TYPE_EVENT_UPSTREAM;
+    addProbe(index, pad, GstPadProbeType(type));
+}
+
+void LatencyTracer::addMarkStage(const QString &stream, const QString &name, GstElement *element, int tag)
+{
+    QMutexLocker locker(&mutex);
+    int          index = addStage(stream, name, element);
+    list[index].tag    = tag;
+}
+
+void LatencyTracer::mark(int tag, GstClockTime pts)
+{
+    if (!attached.loadAcquire())
+        return;
+
+    QMutexLocker locker(&mutex);
+    for (int n = 0; n < list.count(); ++n) {
+        if (list[n].tag == tag && list[n].element) {
+            int gen = generation;
+            locker.unlock();
+            record(n, gen, pts);
+            return;
+        }
+    }
+}
+
+void LatencyTracer::detach()
+{
+    QMutexLocker locker(&mutex);
+    attached.storeRelease(0);
+    for (Stage &s : list) {
+        if (s.pad) {
+            gst_pad_remove_probe(s.pad, s.probe);
+            gst_object_unref(s.pad);
+            s.pad   = nullptr;
+            s.probe = 0;
+        }
+        if (s.element) {
+            gst_object_unref(s.element);
+            s.element = nullptr;
+        }
+    }
+}
+
+void LatencyTracer::clear()
+{
+    detach();
+    QMutexLocker locker(&mutex);
+    list.clear();
+    ++generation;
+}
+
+QList<PLatencyStage> LatencyTracer::stages() const
+{
+    QMutexLocker         locker(&mutex);
+    QList<PLatencyStage> out;
+    for (const Stage &s : list) {
+        PLatencyStage p;
+        p.stream = s.stream;
+        p.name   = s.name;
+        p.count  = s.count;
+        p.mean   = s.count > 0 ? int(s.total / s.count) : 0;
+        p.max    = int(s.max);
+        for (int n = 0; n < BucketCount; ++n)
+            p.histogram += s.histogram[n];
+        for (int limit : bucket_limits)
+            p.bucketLimits += limit;
+        out += p;
+    }
+    return out;
+}
+
+void LatencyTracer::record(int index, int gen, GstClockTime pts)
+{
+    if (!GST_CLOCK_TIME_IS_VALID(pts) || !attached.loadAcquire())
+        return;
+
+    QMutexLocker locker(&mutex);
+    if (gen != generation || index >= list.count())
+        return;
+
+    Stage &s = list[index];
+    if (!s.element)
+        return;
+    GstClockTime now = running_time(s.element);
+    if (!GST_CLOCK_TIME_IS_VALID(now))
+        return;
+
+    // the sink renders at the timestamp plus the pipeline latency
+    if (s.untilDue && pts + s.outputLatency > now)
+        now = pts + s.outputLatency;
+
+    s.recentPts[s.recentAt]  = pts;
+    s.recentTime[s.recentAt] = now;
+    s.recentAt               = (s.recentAt + 1) % RecentSize;
+    if (s.recentCount < RecentSize)
+        ++s.recentCount;
+
+    // when did this media leave the previous stage?  encoders and payloaders
+    //   may regroup buffers, so take the latest one starting at or before
+    //   this one
+    GstClockTime start = pts;
+    if (s.previous != -1) {
+        const Stage &p     = list[s.previous];
+        GstClockTime found = GST_CLOCK_TIME_NONE;
+        start              = GST_CLOCK_TIME_NONE;
+        for (int n = 0; n < p.recentCount; ++n) {
+            if (p.recentPts[n] <= pts && (!GST_CLOCK_TIME_IS_VALID(found) || p.recentPts[n] > found)) {
+                found = p.recentPts[n];
+                start = p.recentTime[n];
+            }
+        }
+        if (!GST_CLOCK_TIME_IS_VALID(start))
+            return;
+    }
+
+    gint64 latency = now > start ? gint64(GST_TIME_AS_USECONDS(now - start)) : 0;
+
+    ++s.count;
+    s.total += latency;
+    s.max = qMax(s.max, latency);
+    ++s.histogram[bucket_of(latency)];
+}
+
+GstPadProbeReturn LatencyTracer::cb_probe(GstPad *pad, GstPadProbeInfo *info, gpointer data)
+{
+    Q_UNUSED(pad)
+    auto           hook   = static_cast<Hook *>(data);
+    LatencyTracer *tracer = hook->tracer;
+    if (!tracer->attached.loadAcquire())
+        return GST_PAD_PROBE_OK;
+
+    if (GST_PAD_PROBE_INFO_TYPE(info) & GST_PAD_PROBE_TYPE_EVENT_UPSTREAM) {
+        GstEvent *event = GST_PAD_PROBE_INFO_EVENT(info);
+        if (GST_EVENT_TYPE(event) == GST_EVENT_LATENCY) {
+            GstClockTime latency;
+            gst_event_parse_latency(event, &latency);
+            QMutexLocker locker(&tracer->mutex);
+            if (hook->generation == tracer->generation && hook->index < tracer->list.count())
+                tracer->list[hook->index].outputLatency = latency;
+        }
+        return GST_PAD_PROBE_OK;
+    }
+
+    GstClockTime pts = GST_CLOCK_TIME_NONE;
+    if (GST_PAD_PROBE_INFO_TYPE(info) & GST_PAD_PROBE_TYPE_BUFFER_LIST) {
+        GstBufferList *list = GST_PAD_PROBE_INFO_BUFFER_LIST(info);
+        if (gst_buffer_list_length(list) > 0)
+            pts = GST_BUFFER_PTS(gst_buffer_list_get(list, 0));
+    } else
+        pts = GST_BUFFER_PTS(GST_PAD_PROBE_INFO_BUFFER(info));
+
+    tracer->record(hook->index, hook->generation, pts);
+    return GST_PAD_PROBE_OK;
+}
+
+void LatencyTracer::cb_free_hook(gpointer data) { delete static_cast<Hook *>(data); }
+
+//----------------------------------------------------------------------------
+// GlassToGlassTracer
+//----------------------------------------------------------------------------
+// seconds from the ntp epoch (1900) to the unix one
+static const guint64 ntp_unix_offset = 2208988800ULL;
+
+// wall clock time minus running time of element, in us
+static bool wall_offset(GstElement *e, gint64 *offset)
+{
+    GstClockTime now = running_time(e);
+    if (!GST_CLOCK_TIME_IS_VALID(now))
+        return false;
+    *offset = g_get_real_time() - gint64(GST_TIME_AS_USECONDS(now));
+    return true;
+}
+
+GlassToGlassTracer::~GlassToGlassTracer() { detach(); }
+
+void GlassToGlassTracer::addProbe(Kind kind, Stream stream, GstElement *element, const char *padName)
+{
+    GstPad *pad = nullptr;
+    if (padName) {
+        pad = gst_element_get_static_pad(element, padName);
+        if (!pad)
+            return;
+    }
+
+    QMutexLocker locker(&mutex);
+    Probe        p;
+    p.kind    = kind;
+    p.stream  = stream;
+    p.element = GST_ELEMENT(gst_object_ref(element));
+    if (kind == Reader)
+        results[stream].active = true;
+
+    if (pad) {
+        auto hook        = new Hook;
+        hook->tracer     = this;
+        hook->index      = list.count();
+        hook->generation = generation;
+
+        auto type = GstPadProbeType(GST_PAD_PROBE_TYPE_BUFFER | GST_PAD_PROBE_TYPE_BUFFER_LIST);
+        // the pipeline latency is announced to the sinks, and passes on
+        //   upstream from there
+        if (kind == OutputPad)
+            type = GstPadProbeType(type | GST_PAD_PROBE_TYPE_EVENT_UPSTREAM);
+        p.pad   = pad;
+        p.probe = gst_pad_add_probe(pad, type, cb_probe, hook, cb_free_hook);
+    }
+    list += p;
+    attached.storeRelease(1);
+}
+
+void GlassToGlassTracer::addStamper(Stream stream, GstElement *element, const char *padName)
+{
+    addProbe(Stamper, stream, element, padName);
+}
+
+void GlassToGlassTracer::addReader(Stream stream, GstElement *element, const char *padName)
+{
+    addProbe(Reader, stream, element, padName);
+}
+
+void GlassToGlassTracer::addOutputPad(Stream stream, GstElement *element, const char *padName)
+{
+    addProbe(OutputPad, stream, element, padName);
+}
+
+void GlassToGlassTracer::addOutputMark(Stream stream, GstElement *element)
+{
+    addProbe(OutputMark, stream, element, nullptr);
+}
+
+void GlassToGlassTracer::mark(Stream stream, GstClockTime pts)
+{
+    if (!attached.loadAcquire())
+        return;
+
+    QMutexLocker locker(&mutex);
+    for (const Probe &p : qAsConst(list)) {
+        if (p.kind == OutputMark && p.stream == stream && p.element) {
+            output(stream, p.element, pts, false);
+            return;
+        }
+    }
+}
+
+void GlassToGlassTracer::detach()
+{
+    QMutexLocker locker(&mutex);
+    attached.storeRelease(0);
+    for (Probe &p : list) {
+        if (p.pad) {
+            gst_pad_remove_probe(p.pad, p.probe);
+            gst_object_unref(p.pad);
+        }
+        gst_object_unref(p.element);
+    }
+    list.clear();
+    ++generation;
+}
+
+void GlassToGlassTracer::clear()
+{
+    detach();
+    QMutexLocker locker(&mutex);
+    for (Result &r : results)
+        r = Result();
+}
+
+QList<PLatencyStage> GlassToGlassTracer::stages() const
+{
+    QMutexLocker         locker(&mutex);
+    QList<PLatencyStage> out;
+    for (int n = 0; n < 2; ++n) {
+        const Result &r = results[n];
+        if (!r.active)
+            continue;
+        PLatencyStage p;
+        p.stream = n == Audio ? "audio-e2e" : "video-e2e";
+        p.name   = "glass-to-glass";
+        p.count  = r.count;
+        p.mean   = r.count > 0 ? int(r.total / r.count) : 0;
+        p.max    = int(r.max);
+        for (int b = 0; b < BucketCount; ++b)
+            p.histogram += r.histogram[b];
+        for (int limit : bucket_limits)
+            p.bucketLimits += limit;
+        out += p;
+    }
+    return out;
+}
+
+// called with the mutex held
+void GlassToGlassTracer::read(int index, int gen, GstBuffer *buffer)
+{
+    GstClockTime pts = GST_BUFFER_PTS(buffer);
+    if (!GST_CLOCK_TIME_IS_VALID(pts) || gen != generation || index >= list.count())
+        return;
+
+    GstRTPBuffer rtp = GST_RTP_BUFFER_INIT;
+    if (!gst_rtp_buffer_map(buffer, GST_MAP_READ, &rtp))
+        return;
+    gpointer data = nullptr;
+    guint    size = 0;
+    bool     ok   = gst_rtp_buffer_get_extension_onebyte_header(&rtp, ExtensionId, 0, &data, &size) && size >= 8;
+    guint64  ntp  = ok ? GST_READ_UINT64_BE(data) : 0;
+    gst_rtp_buffer_unmap(&rtp);
+    if (!ok)
+        return;
+
+    gint64 capture = gint64((ntp >> 32) - ntp_unix_offset) * G_USEC_PER_SEC
+        + gint64(((ntp & G_GUINT64_CONSTANT(0xffffffff)) * G_USEC_PER_SEC) >> 32);
+
+    // every packet of a frame carries the same stamp, keep it once
+    Result &r    = results[list[index].stream];
+    int     last = (r.recentAt + RecentSize - 1) % RecentSize;
+    if (r.recentCount > 0 && r.recentPts[last] == pts)
+        return;
+    r.recentPts[r.recentAt]     = pts;
+    r.recentCapture[r.recentAt] = capture;
+    r.recentAt                  = (r.recentAt + 1) % RecentSize;
+    if (r.recentCount < RecentSize)
+        ++r.recentCount;
+}
+
+// called with the mutex held
+void GlassToGlassTracer::output(Stream stream, GstElement *element, GstClockTime pts, bool untilDue)
+{
+    if (!GST_CLOCK_TIME_IS_VALID(pts))
+        return;
+
+    // decoders may regroup buffers, so take the latest one starting at or
+    //   before this one
+    Result &     r       = results[stream];
+    GstClockTime found   = GST_CLOCK_TIME_NONE;
+    gint64       capture = 0;
+    for (int n = 0; n < r.recentCount; ++n) {
+        if (r.recentPts[n] <= pts && (!GST_CLOCK_TIME_IS_VALID(found) || r.recentPts[n] > found)) {
+            found   = r.recentPts[n];
+            capture = r.recentCapture[n];
+        }
+    }
+    if (!GST_CLOCK_TIME_IS_VALID(found))
+        return;
+
+    gint64 now = g_get_real_time();
+    if (untilDue) {
+        // the sink renders at the timestamp plus the pipeline latency
+        GstClockTime running = running_time(element);
+        if (!GST_CLOCK_TIME_IS_VALID(running))
+            return;
+        GstClockTime due = pts + r.outputLatency;
+        if (due > running)
+            now += gint64(GST_TIME_AS_USECONDS(due - running));
+    }
+
+    gint64 latency = qMax(gint64(0), now - capture);
+    ++r.count;
+    r.total += latency;
+    r.max = qMax(r.max, latency);
+    ++r.histogram[bucket_of(latency)];
+}
+
+void GlassToGlassTracer::stamp(GstBuffer *buffer, gint64 offset)
+{
+    GstClockTime pts = GST_BUFFER_PTS(buffer);
+    if (!GST_CLOCK_TIME_IS_VALID(pts))
+        return;
+
+    // abs-capture-time carries the ntp time as 32.32 fixed point
+    gint64  capture = offset + gint64(GST_TIME_AS_USECONDS(pts));
+    guint64 ntp     = (guint64(capture / G_USEC_PER_SEC) + ntp_unix_offset) << 32;
+    ntp |= (guint64(capture % G_USEC_PER_SEC) << 32) / G_USEC_PER_SEC;
+    guint8 data[8];
+    GST_WRITE_UINT64_BE(data, ntp);
+
+    GstRTPBuffer rtp = GST_RTP_BUFFER_INIT;
+    if (!gst_rtp_buffer_map(buffer, GST_MAP_READWRITE, &rtp))
+        return;
+    gst_rtp_buffer_add_extension_onebyte_header(&rtp, ExtensionId, data, sizeof(data));
+    gst_rtp_buffer_unmap(&rtp);
+}
+
+GstPadProbeReturn GlassToGlassTracer::cb_probe(GstPad *pad, GstPadProbeInfo *info, gpointer data)
+{
+    Q_UNUSED(pad)
+    auto                hook   = static_cast<Hook *>(data);
+    GlassToGlassTracer *tracer = hook->tracer;
+    if (!tracer->attached.loadAcquire())
+        return GST_PAD_PROBE_OK;
+
+    QMutexLocker locker(&tracer->mutex);
+    if (hook->generation != tracer->generation || hook->index >= tracer->list.count())
+        return GST_PAD_PROBE_OK;
+    const Probe &p = tracer->list[hook->index];
+
+    if (GST_PAD_PROBE_INFO_TYPE(info) & GST_PAD_PROBE_TYPE_EVENT_UPSTREAM) {
+        GstEvent *event = GST_PAD_PROBE_INFO_EVENT(info);
+        if (GST_EVENT_TYPE(event) == GST_EVENT_LATENCY) {
+            GstClockTime latency;
+            gst_event_parse_latency(event, &latency);
+            tracer->results[p.stream].outputLatency = latency;
+        }
+        return GST_PAD_PROBE_OK;
+    }
+
+    bool       isList  = GST_PAD_PROBE_INFO_TYPE(info) & GST_PAD_PROBE_TYPE_BUFFER_LIST;
+    GstBuffer *first   = nullptr;
+    guint      buffers = 1;
+    if (isList) {
+        buffers = gst_buffer_list_length(GST_PAD_PROBE_INFO_BUFFER_LIST(info));
+        if (buffers == 0)
+            return GST_PAD_PROBE_OK;
+        first = gst_buffer_list_get(GST_PAD_PROBE_INFO_BUFFER_LIST(info), 0);
+    } else
+        first = GST_PAD_PROBE_INFO_BUFFER(info);
+
+    switch (p.kind) {
+    case Stamper: {
+        gint64 offset;
+        if (!wall_offset(p.element, &offset))
+            break;
+        locker.unlock();
+
+        // the stamp goes into the packets themselves, so they need to be
+        //   writable
+        if (isList) {
+            GstBufferList *list = gst_buffer_list_make_writable(GST_PAD_PROBE_INFO_BUFFER_LIST(info));
+            GST_PAD_PROBE_INFO_DATA(info) = list;
+            for (guint n = 0; n < buffers; ++n)
+                stamp(gst_buffer_list_get_writable(list, n), offset);
+        } else {
+            GstBuffer *buffer             = gst_buffer_make_writable(GST_PAD_PROBE_INFO_BUFFER(info));
+            GST_PAD_PROBE_INFO_DATA(info) = buffer;
+            stamp(buffer, offset);
+        }
+        break;
+    }
+    case Reader:
+        for (guint n = 0; n < buffers; ++n)
+            tracer->read(hook->index, hook->generation,
+                         isList ? gst_buffer_list_get(GST_PAD_PROBE_INFO_BUFFER_LIST(info), n) : first);
+        break;
+    case OutputPad:
+        tracer->output(p.stream, p.element, GST_BUFFER_PTS(first), true);
+        break;
+    case OutputMark:
+        break;
+    }
+    return GST_PAD_PROBE_OK;
+}
+
+void GlassToGlassTracer::cb_free_hook(gpointer data) { delete static_cast<Hook *>(data); }
+
+}
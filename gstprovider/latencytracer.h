@@ -0,0 +1,228 @@
+/*
+ * Copyright (C) 2026  Psi IM Team
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301  USA
+ *
+ */
+
+#ifndef PSIMEDIA_LATENCYTRACER_H
+#define PSIMEDIA_LATENCYTRACER_H
+
+#include "psimediaprovider.h"
+
+#include <QAtomicInt>
+#include <QList>
+#include <QMutex>
+#include <gst/gst.h>
+
+namespace PsiMedia {
+
+//----------------------------------------------------------------------------
+// LatencyTracer
+//----------------------------------------------------------------------------
+// attributes the latency of a stream to the stages it passes through.
+//   stages of a stream are added in flow order.  the first stage of a stream
+//   measures from the buffer timestamp (capture time on the send side,
+//   arrival time after the jitterbuffer on the receive side) to the end of
+//   the stage.  every other stage measures from the time the same media left
+//   the previous stage, matched by timestamp.  a sink stage ends when the
+//   sink is due to render the media instead.
+//
+// stages are added and detached from the worker thread.  buffers are seen
+//   from the streaming threads, results can be read from any thread.  while
+//   nothing is attached, buffers are let through without taking the lock.
+class LatencyTracer {
+public:
+    LatencyTracer() = default;
+    ~LatencyTracer();
+
+    LatencyTracer(const LatencyTracer &) = delete;
+    LatencyTracer &operator=(const LatencyTracer &) = delete;
+
+    // stage ending at the given static pad of element, seen by a buffer probe
+    void addPadStage(const QString &stream, const QString &name, GstElement *element, const char *padName);
+
+    // stage ending when the sink downstream of the given static pad is due
+    //   to render what passes it
+    void addSinkStage(const QString &stream, const QString &name, GstElement *element, const char *padName);
+
+    // stage ending wherever mark() is called with tag.  element is only used
+    //   for its clock
+    void addMarkStage(const QString &stream, const QString &name, GstElement *element, int tag);
+    void mark(int tag, GstClockTime pts);
+
+    // removes the probes and releases the elements, but keeps the results
+    void detach();
+
+    // detaches and forgets all stages and results
+    void clear();
+
+    QList<PLatencyStage> stages() const;
+
+private:
+    enum { RecentSize = 32, BucketCount = 10 };
+
+    class Stage {
+    public:
+        QString     stream;
+        QString     name;
+        int         previous = -1; // stage before this one in the same stream
+        int         tag      = -1;
+        bool        untilDue = false;
+        GstElement *element  = nullptr;
+        GstPad *    pad      = nullptr;
+        gulong      probe    = 0;
+
+        GstClockTime outputLatency = 0; // of the pipeline, for sink stages
+
+        // when recent media left this stage, for the next one
+        GstClockTime recentPts[RecentSize];
+        GstClockTime recentTime[RecentSize];
+        int          recentAt    = 0;
+        int          recentCount = 0;
+
+        int    count = 0;
+        gint64 total = 0; // us
+        gint64 max   = 0; // us
+        int    histogram[BucketCount];
+    };
+
+    class Hook {
+    public:
+        LatencyTracer *tracer;
+        int            index;
+        int            generation;
+    };
+
+    mutable QMutex mutex;
+    QList<Stage>   list;
+    int            generation = 0; // bumped on clear, so late probe calls are ignored
+    QAtomicInt     attached;       // any stage still has its element
+
+    int  addStage(const QString &stream, const QString &name, GstElement *element);
+    void addProbe(int index, GstPad *pad, GstPadProbeType type);
+    void record(int index, int generation, GstClockTime pts);
+
+    static GstPadProbeReturn cb_probe(GstPad *pad, GstPadProbeInfo *info, gpointer data);
+    static void              cb_free_hook(gpointer data);
+};
+
+//----------------------------------------------------------------------------
+// GlassToGlassTracer
+//----------------------------------------------------------------------------
+// measures from capture on the sending side to output on the receiving side,
+//   network included.  the sender writes the wall clock capture time into
+//   every rtp packet as an abs-capture-time header extension, the receiver
+//   reads it back after the jitterbuffer and compares it with the wall clock
+//   when the same media is output, matched by timestamp.  both sides need it
+//   enabled, and their wall clocks need to agree, as they do in loopback.
+//
+// there is no extmap negotiation, so the extension always uses the same
+//   one-byte id.  threading is the same as for LatencyTracer.
+class GlassToGlassTracer {
+public:
+    enum Stream { Audio, Video };
+    enum { ExtensionId = 7 };
+
+    GlassToGlassTracer() = default;
+    ~GlassToGlassTracer();
+
+    GlassToGlassTracer(const GlassToGlassTracer &) = delete;
+    GlassToGlassTracer &operator=(const GlassToGlassTracer &) = delete;
+
+    // sending side: stamps the rtp leaving the given pad.  must be ahead of
+    //   srtp, which authenticates the header
+    void addStamper(Stream stream, GstElement *element, const char *padName);
+
+    // receiving side: reads the stamps of the rtp passing the given pad
+    void addReader(Stream stream, GstElement *element, const char *padName);
+
+    // receiving side: output is where media passes the given pad, plus the
+    //   time until the sink is due to render it.  for audio handed off to an
+    //   output device
+    void addOutputPad(Stream stream, GstElement *element, const char *padName);
+
+    // receiving side: output is wherever mark() is called, for synchronized
+    //   appsinks.  element is only used for its clock
+    void addOutputMark(Stream stream, GstElement *element);
+    void mark(Stream stream, GstClockTime pts);
+
+    // removes the probes and releases the elements, but keeps the results
+    void detach();
+
+    // detaches and forgets all results
+    void clear();
+
+    // one "glass-to-glass" stage per received stream, in "audio-e2e" and
+    //   "video-e2e"
+    QList<PLatencyStage> stages() const;
+
+private:
+    enum { RecentSize = 64, BucketCount = 10 };
+    enum Kind { Stamper, Reader, OutputPad, OutputMark };
+
+    class Probe {
+    public:
+        Kind        kind;
+        Stream      stream;
+        GstElement *element = nullptr;
+        GstPad *    pad     = nullptr;
+        gulong      probe   = 0;
+    };
+
+    class Result {
+    public:
+        bool active = false; // has a reader
+
+        // capture times of recently read media, in us of wall clock
+        GstClockTime recentPts[RecentSize]     = {};
+        gint64       recentCapture[RecentSize] = {};
+        int          recentAt    = 0;
+        int          recentCount = 0;
+
+        GstClockTime outputLatency = 0; // of the pipeline, for OutputPad
+
+        int    count = 0;
+        gint64 total = 0; // us
+        gint64 max   = 0; // us
+        int    histogram[BucketCount] = {};
+    };
+
+    class Hook {
+    public:
+        GlassToGlassTracer *tracer;
+        int                 index;
+        int                 generation;
+    };
+
+    mutable QMutex mutex;
+    QList<Probe>   list;
+    Result         results[2];
+    int            generation = 0;
+    QAtomicInt     attached; // list is not empty
+
+    void addProbe(Kind kind, Stream stream, GstElement *element, const char *padName);
+    void read(int index, int generation, GstBuffer *buffer);
+    void output(Stream stream, GstElement *element, GstClockTime pts, bool untilDue);
+
+    static void              stamp(GstBuffer *buffer, gint64 offset);
+    static GstPadProbeReturn cb_probe(GstPad *pad, GstPadProbeInfo *info, gpointer data);
+    static void              cb_free_hook(gpointer data);
+};
+
+}
+
+#endif // PSIMEDIA_LATENCYTRACER_H
@@ -0,0 +1,44 @@
+/*
+ * Copyright (C) 2026  Psi IM Team
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301  USA
+ *
+ */
+
+#include "logging.h"
+
+// the old compile time switches now just enable debug output by default
+#ifdef RTPWORKER_DEBUG
+#define WORKER_LOG_LEVEL QtDebugMsg
+#else
+#define WORKER_LOG_LEVEL QtInfoMsg
+#endif
+
+#ifdef PIPELINE_DEBUG
+#define PIPELINE_LOG_LEVEL QtDebugMsg
+#else
+#define PIPELINE_LOG_LEVEL QtInfoMsg
+#endif
+
+namespace PsiMedia {
+
+Q_LOGGING_CATEGORY(lcWorker, "psimedia.worker", WORKER_LOG_LEVEL)
+Q_LOGGING_CATEGORY(lcPipeline, "psimedia.pipeline", PIPELINE_LOG_LEVEL)
+Q_LOGGING_CATEGORY(lcDevices, "psimedia.devices", QtInfoMsg)
+Q_LOGGING_CATEGORY(lcRwControl, "psimedia.rwcontrol", QtInfoMsg)
+Q_LOGGING_CATEGORY(lcThread, "psimedia.thread", QtInfoMsg)
+
+}
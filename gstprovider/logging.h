@@ -0,0 +1,40 @@
+/*
+ * Copyright (C) 2026  Psi IM Team
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301  USA
+ *
+ */
+
+#ifndef PSIMEDIA_LOGGING_H
+#define PSIMEDIA_LOGGING_H
+
+#include <QLoggingCategory>
+
+namespace PsiMedia {
+
+// debug output of the provider is off by default and can be switched on at
+//   runtime, e.g. QT_LOGGING_RULES="psimedia.worker.debug=true" or
+//   QLoggingCategory::setFilterRules().  a disabled message costs a single
+//   check of the category, its arguments are not evaluated
+Q_DECLARE_LOGGING_CATEGORY(lcWorker)
+Q_DECLARE_LOGGING_CATEGORY(lcPipeline)
+Q_DECLARE_LOGGING_CATEGORY(lcDevices)
+Q_DECLARE_LOGGING_CATEGORY(lcRwControl)
+Q_DECLARE_LOGGING_CATEGORY(lcThread)
+
+}
+
+#endif // PSIMEDIA_LOGGING_H
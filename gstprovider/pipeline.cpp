@@ -21,6 +21,7 @@
 #include "pipeline.h"
 
 #include "devices.h"
+#include "logging.h"
 #include <QList>
 #include <QSet>
 #include <cstdio>
@@ -30,8 +31,6 @@
 //   all of my attempts at a dynamic pipeline were futile.  someday we
 //   can uncomment and clean this up...
 
-#define PIPELINE_DEBUG
-
 // rates lower than 22050 (e.g. 16000) might not work with echo-cancel
 #define DEFAULT_FIXED_RATE 22050
 
@@ -211,7 +210,8 @@ private:
         // explicitly set audio devices to be low-latency
         if (/*type == PDevice::AudioIn ||*/ type == PDevice::AudioOut) {
             int latency_ms = get_latency_time();
-            if (latency_ms > 0) {
+            // not all sinks have it, virtual ones don't
+            if (latency_ms > 0 && g_object_class_find_property(G_OBJECT_GET_CLASS(e), "latency-time")) {
                 gint64 lt = latency_ms * 1000; // microseconds
                 g_object_set(G_OBJECT(e), "latency-time", lt, nullptr);
                 // g_object_set(G_OBJECT(e), "buffer-time", 2 * lt, nullptr);
@@ -301,7 +301,8 @@ private:
                 webrtcEchoProbeName = QString::fromLatin1(name_value);
                 g_free(name_value);
             } else {
-                qWarning("Failed to create GStreamer webrtcechoprobe element instance. Echo cancellation was disabled");
+                qCWarning(lcPipeline,
+                          "Failed to create GStreamer webrtcechoprobe element instance. Echo cancellation was disabled");
             }
 
             GstElement *capsfilter = nullptr;
@@ -345,7 +346,7 @@ public:
 
         device_bin = makeDeviceBin(context->opts);
         if (!device_bin) {
-            qWarning("Failed to create device");
+            qCWarning(lcPipeline, "Failed to create device");
             return;
         }
 
@@ -540,7 +541,7 @@ NULL
         if (type == PDevice::AudioIn && ctx.options().aec && !webrtcdspInitialized) {
             // seems like we want to enable AEC. for this we have to modify already running pipeline
             if (!aindev) {
-                qWarning("AudioIn device is not found. failed to insert DSP element");
+                qCWarning(lcPipeline, "AudioIn device is not found. failed to insert DSP element");
                 return;
             }
             webrtcEchoProbeName  = ctx.options().echoProberName;
@@ -683,9 +684,7 @@ PipelineDeviceContext *PipelineDeviceContext::create(PipelineContext *pipeline,
 
     that->d->device = dev;
 
-#ifdef PIPELINE_DEBUG
-    qDebug("Readying %s:[%s], refs=%d", type_to_str(dev->type), qPrintable(dev->id), dev->refs);
-#endif
+    qCDebug(lcPipeline, "Readying %s:[%s], refs=%d", type_to_str(dev->type), qPrintable(dev->id), dev->refs);
     return that;
 }
 
@@ -695,9 +694,7 @@ PipelineDeviceContext::~PipelineDeviceContext()
 
     if (dev) {
         dev->removeRef(d);
-#ifdef PIPELINE_DEBUG
-        qDebug("Releasing %s:[%s], refs=%d", type_to_str(dev->type), qPrintable(dev->id), dev->refs);
-#endif
+        qCDebug(lcPipeline, "Releasing %s:[%s], refs=%d", type_to_str(dev->type), qPrintable(dev->id), dev->refs);
         if (dev->refs == 0) {
             d->pipeline->d->devices.remove(dev);
             delete dev;
@@ -0,0 +1,157 @@
+/*
+ * Copyright (C) 2026  Psi IM Team
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301  USA
+ *
+ */
+
+#include "pipelinesnapshot.h"
+
+#include <QVariantList>
+#include <gst/gst.h>
+
+namespace PsiMedia {
+
+static QString object_name(GstObject *obj)
+{
+    gchar * name = gst_object_get_name(obj);
+    QString ret  = QString::fromUtf8(name);
+    g_free(name);
+    return ret;
+}
+
+static QVariantMap pad_snapshot(GstPad *pad)
+{
+    QVariantMap ret;
+    ret["name"]      = object_name(GST_OBJECT(pad));
+    ret["direction"] = QString::fromLatin1(GST_PAD_IS_SRC(pad) ? "src" : (GST_PAD_IS_SINK(pad) ? "sink" : "unknown"));
+
+    QString  caps;
+    GstCaps *current = gst_pad_get_current_caps(pad);
+    if (current) {
+        gchar *str = gst_caps_to_string(current);
+        caps       = QString::fromUtf8(str);
+        g_free(str);
+        gst_caps_unref(current);
+    }
+    ret["caps"] = caps;
+
+    QString peer;
+    GstPad *peerpad = gst_pad_get_peer(pad);
+    if (peerpad) {
+        GstElement *parent = gst_pad_get_parent_element(peerpad);
+        if (parent) {
+            peer = object_name(GST_OBJECT(parent)) + ':';
+            gst_object_unref(parent);
+        }
+        peer += object_name(GST_OBJECT(peerpad));
+        gst_object_unref(peerpad);
+    }
+    ret["peer"] = peer;
+    return ret;
+}
+
+static void snapshot_pads_each(const GValue *value, gpointer data)
+{
+    auto pad = static_cast<GstPad *>(g_value_get_object(value));
+    static_cast<QVariantList *>(data)->append(pad_snapshot(pad));
+}
+
+// queue and queue2 share these property names
+static bool queue_snapshot(GstElement *e, QVariantMap *out)
+{
+    if (!g_object_class_find_property(G_OBJECT_GET_CLASS(e), "current-level-buffers"))
+        return false;
+
+    guint   buffers = 0, bytes = 0, maxBuffers = 0, maxBytes = 0;
+    guint64 time = 0, maxTime = 0;
+    g_object_get(G_OBJECT(e), "current-level-buffers", &buffers, "current-level-bytes", &bytes, "current-level-time",
+                 &time, "max-size-buffers", &maxBuffers, "max-size-bytes", &maxBytes, "max-size-time", &maxTime,
+                 nullptr);
+
+    QVariantMap queue;
+    queue["buffers"]    = buffers;
+    queue["bytes"]      = bytes;
+    queue["time"]       = qulonglong(time);
+    queue["maxBuffers"] = maxBuffers;
+    queue["maxBytes"]   = maxBytes;
+    queue["maxTime"]    = qulonglong(maxTime);
+    (*out)["queue"]     = queue;
+    return true;
+}
+
+static QVariantMap element_snapshot(GstElement *e);
+
+static void snapshot_children_each(const GValue *value, gpointer data)
+{
+    auto e = static_cast<GstElement *>(g_value_get_object(value));
+    static_cast<QVariantList *>(data)->append(element_snapshot(e));
+}
+
+static QVariantMap element_snapshot(GstElement *e)
+{
+    QVariantMap ret;
+    ret["name"] = object_name(GST_OBJECT(e));
+
+    GstElementFactory *factory = gst_element_get_factory(e);
+    ret["factory"] = factory ? QString::fromUtf8(GST_OBJECT_NAME(factory)) : QString();
+
+    // don't wait for async state changes, we want to see them as they are
+    GstState state   = GST_STATE_VOID_PENDING;
+    GstState pending = GST_STATE_VOID_PENDING;
+    gst_element_get_state(e, &state, &pending, 0);
+    ret["state"]        = QString::fromLatin1(gst_element_state_get_name(state));
+    ret["pendingState"] = QString::fromLatin1(gst_element_state_get_name(pending));
+
+    QVariantList pads;
+    GstIterator *it = gst_element_iterate_pads(e);
+    gst_iterator_foreach(it, snapshot_pads_each, &pads);
+    gst_iterator_free(it);
+    ret["pads"] = pads;
+
+    queue_snapshot(e, &ret);
+
+    if (GST_IS_BIN(e)) {
+        QVariantList children;
+        it = gst_bin_iterate_elements(GST_BIN(e));
+        gst_iterator_foreach(it, snapshot_children_each, &children);
+        gst_iterator_free(it);
+        ret["children"] = children;
+    }
+    return ret;
+}
+
+QVariantMap pipeline_snapshot(GstElement *element)
+{
+    QVariantMap ret = element_snapshot(element);
+
+    GstQuery *query = gst_query_new_latency();
+    if (gst_element_query(element, query)) {
+        gboolean     live   = FALSE;
+        GstClockTime minLat = 0, maxLat = 0;
+        gst_query_parse_latency(query, &live, &minLat, &maxLat);
+
+        QVariantMap latency;
+        latency["live"] = bool(live);
+        latency["min"]  = qulonglong(minLat);
+        latency["max"]  = GST_CLOCK_TIME_IS_VALID(maxLat) ? qlonglong(maxLat) : qlonglong(-1);
+        ret["latency"]  = latency;
+    }
+    gst_query_unref(query);
+    return ret;
+}
+
+}
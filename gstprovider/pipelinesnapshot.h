@@ -0,0 +1,44 @@
+/*
+ * Copyright (C) 2026  Psi IM Team
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301  USA
+ *
+ */
+
+#ifndef PSIMEDIA_PIPELINESNAPSHOT_H
+#define PSIMEDIA_PIPELINESNAPSHOT_H
+
+#include <QVariantMap>
+#include <gst/gstelement.h>
+
+namespace PsiMedia {
+
+// structured description of a running element or bin, cheap enough to be
+//   polled while live.  keys:
+//   name, factory, state, pendingState - strings
+//   pads     - list of maps: name, direction, caps (negotiated, or empty),
+//              peer ("element:pad", or empty if unlinked)
+//   queue    - for queue-like elements: buffers, bytes, time (ns) and
+//              maxBuffers, maxBytes, maxTime (ns)
+//   latency  - for the element passed in only: live, min (ns), max (ns, -1
+//              if unbounded).  missing if the query failed
+//   children - for bins, list of maps like this one
+// must be called from the thread that owns the pipeline
+QVariantMap pipeline_snapshot(GstElement *element);
+
+}
+
+#endif // PSIMEDIA_PIPELINESNAPSHOT_H
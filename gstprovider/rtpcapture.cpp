@@ -0,0 +1,189 @@
+/*
+ * Copyright (C) 2026  Psi IM Team
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301  USA
+ *
+ */
+
+#include "rtpcapture.h"
+
+#include "logging.h"
+
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QMutexLocker>
+#include <QThread>
+#include <QtEndian>
+
+// queued records beyond which packets are dropped rather than held in memory
+#define CAPTURE_PENDING_MAX (32 * 1024 * 1024)
+
+namespace PsiMedia {
+
+static QJsonArray payload_info_to_json(const QList<PPayloadInfo> &list)
+{
+    QJsonArray out;
+    for (const PPayloadInfo &pi : list) {
+        QJsonArray parameters;
+        for (const PPayloadInfo::Parameter &p : pi.parameters)
+            parameters += QJsonObject { { "name", p.name }, { "value", p.value } };
+
+        QJsonObject o;
+        o["id"]         = pi.id;
+        o["name"]       = pi.name;
+        o["clockrate"]  = pi.clockrate;
+        o["channels"]   = pi.channels;
+        o["ptime"]      = pi.ptime;
+        o["maxptime"]   = pi.maxptime;
+        o["parameters"] = parameters;
+        out += o;
+    }
+    return out;
+}
+
+//----------------------------------------------------------------------------
+// RtpCaptureFile
+//----------------------------------------------------------------------------
+class RtpCaptureFile::Writer : public QThread {
+public:
+    RtpCaptureFile *capture;
+
+    explicit Writer(RtpCaptureFile *_capture) : capture(_capture) { setObjectName("RtpCapture"); }
+
+protected:
+    void run() override { capture->writeLoop(); }
+};
+
+RtpCaptureFile::~RtpCaptureFile() { close(); }
+
+bool RtpCaptureFile::open(const QString &fileName)
+{
+    close();
+
+    file.setFileName(fileName);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate))
+        return false;
+    if (file.write(PSIMEDIA_RTPCAPTURE_MAGIC, 8) != 8) {
+        file.close();
+        return false;
+    }
+
+    QMutexLocker locker(&mutex);
+    pending.clear();
+    stopping = false;
+    dropped  = 0;
+    clock.start();
+    writer = new Writer(this);
+    writer->start();
+    return true;
+}
+
+// writes out what is still queued first
+void RtpCaptureFile::close()
+{
+    mutex.lock();
+    Writer *w = writer;
+    writer    = nullptr;
+    stopping  = true;
+    wake.wakeAll();
+    mutex.unlock();
+    if (!w)
+        return;
+
+    w->wait();
+    delete w;
+    file.close();
+    if (dropped > 0)
+        qCWarning(lcWorker, "rtp capture: %d packets dropped, the disk was too slow", dropped);
+}
+
+bool RtpCaptureFile::isOpen() const
+{
+    QMutexLocker locker(&mutex);
+    return writer != nullptr;
+}
+
+// called with the mutex held
+void RtpCaptureFile::queueRecord(PRtpCapture::Record type, const QByteArray &body)
+{
+    char head[9];
+    head[0] = char(type);
+    qToBigEndian<quint64>(quint64(clock.nsecsElapsed() / 1000), head + 1);
+    pending.append(head, sizeof(head));
+    pending.append(body);
+    wake.wakeAll();
+}
+
+// in the writer thread
+void RtpCaptureFile::writeLoop()
+{
+    QMutexLocker locker(&mutex);
+    while (true) {
+        while (pending.isEmpty() && !stopping)
+            wake.wait(&mutex);
+        if (pending.isEmpty())
+            break;
+
+        QByteArray out;
+        out.swap(pending);
+        locker.unlock();
+        file.write(out);
+        locker.relock();
+    }
+}
+
+void RtpCaptureFile::writePacket(int flags, const PRtpPacket &packet)
+{
+    // the size has to fit in 16 bits, rtp over udp always does
+    if (packet.rawValue.size() > 0xffff)
+        return;
+
+    QMutexLocker locker(&mutex);
+    if (!writer)
+        return;
+    if (pending.size() > CAPTURE_PENDING_MAX) {
+        ++dropped;
+        return;
+    }
+
+    char head[4];
+    head[0] = char(flags);
+    head[1] = char(packet.portOffset);
+    qToBigEndian<quint16>(quint16(packet.rawValue.size()), head + 2);
+    queueRecord(PRtpCapture::PacketRecord, QByteArray(head, sizeof(head)) + packet.rawValue);
+}
+
+void RtpCaptureFile::writePayloadInfo(const QList<PPayloadInfo> &localAudio, const QList<PPayloadInfo> &localVideo,
+                                      const QList<PPayloadInfo> &remoteAudio, const QList<PPayloadInfo> &remoteVideo)
+{
+    QJsonObject info;
+    info["localAudio"]  = payload_info_to_json(localAudio);
+    info["localVideo"]  = payload_info_to_json(localVideo);
+    info["remoteAudio"] = payload_info_to_json(remoteAudio);
+    info["remoteVideo"] = payload_info_to_json(remoteVideo);
+    QByteArray json     = QJsonDocument(info).toJson(QJsonDocument::Compact);
+
+    QMutexLocker locker(&mutex);
+    if (!writer)
+        return;
+
+    char size[4];
+    qToBigEndian<quint32>(quint32(json.size()), size);
+    queueRecord(PRtpCapture::PayloadInfoRecord, QByteArray(size, sizeof(size)) + json);
+}
+
+}
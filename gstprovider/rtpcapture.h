@@ -0,0 +1,76 @@
+/*
+ * Copyright (C) 2026  Psi IM Team
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301  USA
+ *
+ */
+
+#ifndef PSIMEDIA_RTPCAPTURE_H
+#define PSIMEDIA_RTPCAPTURE_H
+
+#include "psimediaprovider.h"
+
+#include <QElapsedTimer>
+#include <QFile>
+#include <QMutex>
+#include <QWaitCondition>
+
+namespace PsiMedia {
+
+//----------------------------------------------------------------------------
+// RtpCaptureFile
+//----------------------------------------------------------------------------
+// writes the rtp of a session to a capture file, see PRtpCapture.  packets
+//   may be written from any thread, they are timed as they are written.
+//   the records are only queued there, a thread of the capture's own does
+//   the file i/o, so a slow disk doesn't hold up the streaming threads.
+//   writing to a closed capture does nothing
+class RtpCaptureFile {
+public:
+    RtpCaptureFile() = default;
+    ~RtpCaptureFile();
+
+    RtpCaptureFile(const RtpCaptureFile &) = delete;
+    RtpCaptureFile &operator=(const RtpCaptureFile &) = delete;
+
+    // closes any previous capture first
+    bool open(const QString &fileName);
+    void close();
+    bool isOpen() const;
+
+    void writePacket(int flags, const PRtpPacket &packet);
+    void writePayloadInfo(const QList<PPayloadInfo> &localAudio, const QList<PPayloadInfo> &localVideo,
+                          const QList<PPayloadInfo> &remoteAudio, const QList<PPayloadInfo> &remoteVideo);
+
+private:
+    class Writer;
+
+    mutable QMutex mutex; // of everything but file, which only the writer uses
+    QWaitCondition wake;
+    QFile          file;
+    QElapsedTimer  clock;
+    Writer *       writer = nullptr;
+    QByteArray     pending; // records not written yet
+    bool           stopping = false;
+    int            dropped  = 0; // packets, while pending was full
+
+    void queueRecord(PRtpCapture::Record type, const QByteArray &body);
+    void writeLoop();
+};
+
+}
+
+#endif // PSIMEDIA_RTPCAPTURE_H
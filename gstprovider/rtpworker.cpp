@@ -21,20 +21,34 @@
 #include "rtpworker.h"
 
 #include <QDir>
-#include <QElapsedTimer>
 #include <QStringList>
+#include <QtEndian>
 #include <cstring>
 #include <gst/app/gstappsrc.h>
+#include <gst/video/video.h>
 
 #include "bins.h"
 //#include "devices.h"
+#include "eventrecorder.h"
+#include "logging.h"
 #include "payloadinfo.h"
 #include "pipeline.h"
+#include "pipelinesnapshot.h"
 
 // TODO: support playing from bytearray
 // TODO: support recording
 
-#define RTPWORKER_DEBUG
+// minimum time between two keyframes forced on the encoder, and between two
+//   keyframe requests sent to the remote side (ms)
+#define KEYFRAME_REQUEST_INTERVAL 1000
+
+// rtcp payload-specific feedback (rfc 4585) and the message types we use
+#define RTCP_PSFB 206
+#define RTCP_PSFB_PLI 1
+#define RTCP_PSFB_FIR 4 // rfc 5104
+
+// how often offline progress is reported (ms)
+#define OFFLINE_PROGRESS_INTERVAL 500
 
 namespace PsiMedia {
 
@@ -64,66 +78,16 @@ static const char *state_to_str(GstState state)
     }
 }
 
-class Stats {
-public:
-    QString       name;
-    int           calls;
-    int           sizes[30];
-    int           sizes_at;
-    QElapsedTimer calltime;
-
-    Stats(const QString &_name) : name(_name), calls(-1), sizes_at(0)
-    {
-        for (int k = 0; k < 30; ++k)
-            sizes[k] = 0;
-    }
-
-    void print_stats(int current_size)
-    {
-        // -2 means quit
-        if (calls == -2)
-            return;
-
-        if (sizes_at >= 30) {
-            memmove(sizes, sizes + 1, sizeof(int) * quintptr(sizes_at - 1));
-            --sizes_at;
-        }
-        sizes[sizes_at++] = current_size;
-
-        // set timer on first call
-        if (calls == -1) {
-            calls = 0;
-            calltime.start();
-        }
-
-        // print bitrate after 10 seconds
-        if (calltime.elapsed() >= 10000) {
-            int avg = 0;
-            for (int n = 0; n < sizes_at; ++n)
-                avg += sizes[n];
-            avg /= sizes_at;
-            int bytesPerSec = (calls * avg) / 10;
-            int bps         = bytesPerSec * 10;
-            int kbps        = bps / 1000;
-            calls           = -2;
-            calltime.restart();
-            qDebug("%s: average packet size=%d, kbps=%d", qPrintable(name), avg, kbps);
-        } else
-            ++calls;
-    }
-};
-
-#ifdef RTPWORKER_DEBUG
 static void dump_pipeline(GstElement *in, int indent = 1);
 static void dump_pipeline_each(const GValue *value, gpointer data)
 {
     auto e      = static_cast<GstElement *>(g_value_get_object(value));
     int  indent = *(static_cast<int *>(data));
     if (GST_IS_BIN(e)) {
-        qDebug("%s%s:", qPrintable(QString(indent, ' ')), gst_element_get_name(e));
+        qCDebug(lcWorker, "%s%s:", qPrintable(QString(indent, ' ')), gst_element_get_name(e));
         dump_pipeline(e, indent + 2);
     } else
-        qDebug("%s%s", qPrintable(QString(indent, ' ')), gst_element_get_name(e));
+        qCDebug(lcWorker, "%s%s", qPrintable(QString(indent, ' ')), gst_element_get_name(e));
 }
 
 static void dump_pipeline(GstElement *in, int indent)
@@ -132,7 +96,6 @@ static void dump_pipeline(GstElement *in, int indent)
     gst_iterator_foreach(it, dump_pipeline_each, &indent);
     gst_iterator_free(it);
 }
-#endif
 
 //----------------------------------------------------------------------------
 // RtpWorker
@@ -154,16 +117,18 @@ static bool      send_clock_is_shared = false;
 RtpWorker::RtpWorker(GMainContext *mainContext) :
     app(nullptr), loopFile(false), maxbitrate(-1), canTransmitAudio(false), canTransmitVideo(false), outputVolume(100),
     inputVolume(100), error(0), cb_started(nullptr), cb_updated(nullptr), cb_stopped(nullptr), cb_finished(nullptr),
-    cb_error(nullptr), cb_audioOutputIntensity(nullptr), cb_audioInputIntensity(nullptr), cb_previewFrame(nullptr),
-    cb_outputFrame(nullptr), cb_rtpAudioOut(nullptr), cb_rtpVideoOut(nullptr), cb_recordData(nullptr),
-    mainContext_(mainContext), timer(nullptr), pd_audiosrc(nullptr), pd_videosrc(nullptr), pd_audiosink(nullptr),
-    sendbin(nullptr), recvbin(nullptr), fileDemux(nullptr), audiosrc(nullptr), videosrc(nullptr), audiortpsrc(nullptr),
-    videortpsrc(nullptr), audiortppay(nullptr), videortppay(nullptr), volumein(nullptr), volumeout(nullptr),
-    rtpaudioout(false), rtpvideoout(false)
+    cb_error(nullptr), cb_audioOutputIntensity(nullptr), cb_audioInputIntensity(nullptr), cb_videoAdaptation(nullptr),
+    cb_offlineProgress(nullptr), cb_previewFrame(nullptr), cb_outputFrame(nullptr), cb_rtpAudioOut(nullptr),
+    cb_rtpVideoOut(nullptr), cb_recordData(nullptr), mainContext_(mainContext), timer(nullptr), pd_audiosrc(nullptr),
+    pd_videosrc(nullptr), pd_audiosink(nullptr), sendbin(nullptr), recvbin(nullptr), fileDemux(nullptr),
+    audiosrc(nullptr), videosrc(nullptr), audiortpsrc(nullptr), videortpsrc(nullptr), audiortppay(nullptr),
+    videortppay(nullptr), volumein(nullptr), volumeout(nullptr), rtpaudioout(false), rtpvideoout(false)
 // recordTimer(0)
 {
-    audioStats = new Stats("audio");
-    videoStats = new Stats("video");
+    // used as the sender of our feedback until we send video ourselves
+    localVideoSsrc = g_random_int();
+
+    latencyTracing = !qgetenv("PSI_LATENCY_TRACE").isEmpty();
 
     if (worker_refs == 0) {
         send_pipelineContext = new PipelineContext;
@@ -213,16 +178,11 @@ RtpWorker::~RtpWorker()
 
         // sbus = 0;
     }
-
-    delete audioStats;
-    delete videoStats;
 }
 
 void RtpWorker::cleanup()
 {
-#ifdef RTPWORKER_DEBUG
-    qDebug("cleaning up...");
-#endif
+    qCDebug(lcWorker, "cleaning up...");
     volumein_mutex.lock();
     volumein = nullptr;
     volumein_mutex.unlock();
@@ -247,6 +207,35 @@ void RtpWorker::cleanup()
     rtpvideoout = false;
     rtpvideoout_mutex.unlock();
 
+    srtp_mutex.lock();
+    audiosrtpenc = nullptr;
+    videosrtpenc = nullptr;
+    audiosrtpdec = nullptr;
+    videosrtpdec = nullptr;
+    srtp_mutex.unlock();
+
+    if (loadTimer) {
+        g_source_destroy(loadTimer);
+        loadTimer = nullptr;
+    }
+    if (offlineTimer) {
+        g_source_destroy(offlineTimer);
+        offlineTimer = nullptr;
+    }
+    videoprepbin  = nullptr;
+    videortpqueue = nullptr;
+    previewfilter = nullptr;
+
+    keyframe_mutex.lock();
+    videoencbin  = nullptr;
+    lastKeyframe = 0;
+    lastPli      = 0;
+    keyframe_mutex.unlock();
+
+    // keep the results readable after stopping
+    latencyTracer.detach();
+    glassTracer.detach();
+
     // if(pd_audiosrc)
     //    pd_audiosrc->deactivate();
 
@@ -260,7 +249,7 @@ void RtpWorker::cleanup()
             send_clock_is_shared = false;
 
             if (recv_in_use) {
-                qDebug("recv clock reverts to auto");
+                qCDebug(lcWorker, "recv clock reverts to auto");
                 gst_element_set_state(rpipeline, GST_STATE_READY);
                 gst_element_get_state(rpipeline, nullptr, nullptr, GST_CLOCK_TIME_NONE);
                 gst_pipeline_auto_clock(GST_PIPELINE(rpipeline));
@@ -296,7 +285,7 @@ void RtpWorker::cleanup()
             {
                 // FIXME: do we really need to restart the pipeline?
 
-                qDebug("send clock becomes master");
+                qCDebug(lcWorker, "send clock becomes master");
                 send_pipelineContext->deactivate();
                 gst_pipeline_auto_clock(GST_PIPELINE(spipeline));
                 send_pipelineContext->activate();
@@ -336,9 +325,7 @@ void RtpWorker::cleanup()
         pd_audiosink = nullptr;
     }
 
-#ifdef RTPWORKER_DEBUG
-    qDebug("cleaning done.");
-#endif
+    qCDebug(lcWorker, "cleaning done.");
 }
 
 void RtpWorker::start()
@@ -392,7 +379,7 @@ void RtpWorker::stop()
     g_source_attach(timer, mainContext_);
 }
 
-static GstBuffer *makeGstBuffer(const PRtpPacket &packet)
+GstBuffer *RtpWorker::makeGstBuffer(const PRtpPacket &packet)
 {
     GstBuffer *buffer;
     GstMemory *memory;
@@ -415,6 +402,68 @@ static GstBuffer *makeGstBuffer(const PRtpPacket &packet)
     return nullptr;
 }
 
+GstClockTime RtpWorker::MediaClock::stamp(const QByteArray &rtp, qint64 sessionTime)
+{
+    if (rtp.size() < 12 || clockRate <= 0)
+        return GST_CLOCK_TIME_NONE;
+
+    // the signed difference takes care of wraparound and reordering
+    quint32 ts = qFromBigEndian<quint32>(rtp.constData() + 4);
+    if (started)
+        ticks += qint32(ts - last);
+    else
+        base = sessionTime;
+    started = true;
+    last    = ts;
+    return GstClockTime(base)
+        + gst_util_uint64_scale(quint64(qMax(qint64(0), ticks)), GST_SECOND, quint64(clockRate));
+}
+
+// called with the mutex of appsrc held by locker
+void RtpWorker::pushRtp(QMutexLocker *locker, GstElement *appsrc, MediaClock *clock, const PRtpPacket &packet)
+{
+    GstBuffer *buffer = makeGstBuffer(packet);
+    if (!buffer)
+        return;
+    if (!offline) {
+        gst_app_src_push_buffer((GstAppSrc *)appsrc, buffer);
+        return;
+    }
+
+    // the streams are under different mutexes, so the furthest time only
+    //   ever moves forward
+    GstClockTime time      = clock->stamp(packet.rawValue, receivedTime.loadAcquire());
+    GST_BUFFER_PTS(buffer) = time;
+    GST_BUFFER_DTS(buffer) = time;
+    if (GST_CLOCK_TIME_IS_VALID(time)) {
+        qint64 seen = receivedTime.loadAcquire();
+        while (qint64(time) > seen) {
+            if (receivedTime.testAndSetOrdered(seen, qint64(time), seen))
+                break;
+        }
+    }
+
+    // the appsrc blocks while the pipeline is behind.  cleanup takes the
+    //   mutex before it stops the pipeline (which unblocks us), so let go
+    gst_object_ref(GST_OBJECT(appsrc));
+    locker->unlock();
+    gst_app_src_push_buffer((GstAppSrc *)appsrc, buffer);
+    gst_object_unref(GST_OBJECT(appsrc));
+}
+
+GstElement *RtpWorker::makeSrtpDecoder()
+{
+    GstElement *srtpdec = bins_srtpdec_create();
+    if (!srtpdec)
+        return nullptr;
+
+    // keys are handed out per ssrc on demand, and asked again on rekey
+    //   (after clear-keys) or when a key reaches its usage limit
+    g_signal_connect(G_OBJECT(srtpdec), "request-key", G_CALLBACK(cb_srtpdec_request_key), this);
+    g_signal_connect(G_OBJECT(srtpdec), "hard-limit", G_CALLBACK(cb_srtpdec_request_key), this);
+    return srtpdec;
+}
+
 GstAppSink *RtpWorker::makeVideoPlayAppSink(const gchar *name)
 {
     GstElement *videoplaysink = gst_element_factory_make("appsink", name); // was appvideosink
@@ -432,15 +481,152 @@ void RtpWorker::rtpAudioIn(const PRtpPacket &packet)
 {
     QMutexLocker locker(&audiortpsrc_mutex);
     if (packet.portOffset == 0 && audiortpsrc) {
-        gst_app_src_push_buffer((GstAppSrc *)audiortpsrc, makeGstBuffer(packet));
+        audioMetrics.packetIn(packet.rawValue);
+        EventRecorder::record("worker", "rtp audio in", EventRecorder::Instant, packet.rawValue.size());
+        pushRtp(&locker, audiortpsrc, &audioInClock, packet);
     }
 }
 
 void RtpWorker::rtpVideoIn(const PRtpPacket &packet)
 {
+    if (packet.portOffset == 1) {
+        videoRtcpIn(packet.rawValue);
+        return;
+    }
+
     QMutexLocker locker(&videortpsrc_mutex);
-    if (packet.portOffset == 0 && videortpsrc)
-        gst_app_src_push_buffer((GstAppSrc *)videortpsrc, makeGstBuffer(packet));
+    if (packet.portOffset == 0 && videortpsrc) {
+        if (packet.rawValue.size() >= 12)
+            remoteVideoSsrc = qFromBigEndian<quint32>(packet.rawValue.constData() + 8);
+        videoMetrics.packetIn(packet.rawValue);
+        EventRecorder::record("worker", "rtp video in", EventRecorder::Instant, packet.rawValue.size());
+        pushRtp(&locker, videortpsrc, &videoInClock, packet);
+    }
+}
+
+PVideoOutputStats RtpWorker::videoOutputStats() const
+{
+    PVideoOutputStats stats;
+    stats.decoded   = videoFramesDecoded.loadAcquire();
+    stats.displayed = videoFramesShown.loadAcquire();
+
+    // whatever went in and never came out was dropped, either by the
+    //   decoder or after it. frames still in flight are off by a few
+    stats.droppedLate = qMax(0, videoFramesIn.loadAcquire() - stats.displayed);
+    return stats;
+}
+
+PStreamMetrics RtpWorker::audioStreamMetrics() const { return audioMetrics.metrics(); }
+
+PStreamMetrics RtpWorker::videoStreamMetrics() const
+{
+    PStreamMetrics m = videoMetrics.metrics();
+    m.framesDecoded  = videoFramesDecoded.loadAcquire();
+    m.decodeTime     = decodeTime.loadAcquire();
+
+    QMutexLocker locker(&videoload_mutex);
+    m.encodeTime = int(encodeTime);
+    return m;
+}
+
+void RtpWorker::requestKeyframe()
+{
+    GstPad *pad = nullptr;
+    {
+        QMutexLocker locker(&keyframe_mutex);
+        if (!videoencbin)
+            return;
+
+        gint64 now = g_get_monotonic_time();
+        if (lastKeyframe && now - lastKeyframe < KEYFRAME_REQUEST_INTERVAL * 1000)
+            return;
+        lastKeyframe = now;
+
+        pad = gst_element_get_static_pad(videoencbin, "src");
+    }
+
+    qCDebug(lcWorker, "forcing a video keyframe");
+
+    // travels upstream through the payloader into the encoder
+    gst_pad_send_event(pad, gst_video_event_new_upstream_force_key_unit(GST_CLOCK_TIME_NONE, TRUE, 0));
+    gst_object_unref(GST_OBJECT(pad));
+}
+
+// rtcp comes as compound packets.  all we look for is feedback asking
+//   for a new keyframe, anything else is left for the application
+void RtpWorker::videoRtcpIn(const QByteArray &buf)
+{
+    {
+        // srtcp encrypts all but the first header, the rest would be read
+        //   as garbage
+        QMutexLocker locker(&srtp_mutex);
+        if (!remoteSrtp.key.isEmpty())
+            return;
+    }
+
+    auto p   = reinterpret_cast<const quint8 *>(buf.constData());
+    int  at  = 0;
+    int  len = 0;
+    for (; at + 4 <= buf.size(); at += len) {
+        // version 2 only
+        if ((p[at] >> 6) != 2)
+            break;
+
+        int fmt = p[at] & 0x1f;
+        int pt  = p[at + 1];
+        len     = (((p[at + 2] << 8) | p[at + 3]) + 1) * 4;
+        if (pt == RTCP_PSFB && (fmt == RTCP_PSFB_PLI || fmt == RTCP_PSFB_FIR)) {
+            requestKeyframe();
+            break;
+        }
+    }
+}
+
+// note: this is executed from the streaming thread
+void RtpWorker::sendPictureLossIndication()
+{
+    {
+        // we have no way to protect rtcp, so don't send it in the clear
+        //   next to an encrypted stream
+        QMutexLocker locker(&srtp_mutex);
+        if (!localSrtp.key.isEmpty())
+            return;
+    }
+
+    quint32 media;
+    videortpsrc_mutex.lock();
+    media = remoteVideoSsrc;
+    videortpsrc_mutex.unlock();
+
+    // nothing received yet, so nothing to complain about
+    if (!media)
+        return;
+
+    {
+        QMutexLocker locker(&keyframe_mutex);
+        gint64       now = g_get_monotonic_time();
+        if (lastPli && now - lastPli < KEYFRAME_REQUEST_INTERVAL * 1000)
+            return;
+        lastPli = now;
+    }
+
+    qCDebug(lcWorker, "requesting a video keyframe from ssrc %08x", media);
+
+    QByteArray pli(12, 0);
+    auto       p = reinterpret_cast<uchar *>(pli.data());
+    p[0]         = 0x80 | RTCP_PSFB_PLI;
+    p[1]         = RTCP_PSFB;
+    p[3]         = 2; // length in 32-bit words, minus one
+    qToBigEndian<quint32>(media, p + 8);
+
+    QMutexLocker locker(&rtpvideoout_mutex);
+    qToBigEndian<quint32>(localVideoSsrc, p + 4);
+
+    PRtpPacket packet;
+    packet.rawValue   = pli;
+    packet.portOffset = 1;
+    if (cb_rtpVideoOut)
+        cb_rtpVideoOut(packet, app);
 }
 
 void RtpWorker::setOutputVolume(int level)
@@ -453,6 +639,33 @@ void RtpWorker::setOutputVolume(int level)
     }
 }
 
+void RtpWorker::setCpuBudget(int percent)
+{
+    if (percent == cpuBudget)
+        return;
+
+    cpuBudget = percent;
+    retuneVideoEncoder();
+}
+
+// the encoder gets its cpu budget from the size and rate it encodes, so
+//   it is tuned again whenever any of them changes
+void RtpWorker::retuneVideoEncoder()
+{
+    QMutexLocker locker(&keyframe_mutex);
+    if (videoencbin)
+        bins_videoenc_retune(videoencbin, videoEncCodec, videoEncSize, videoEncFps, cpuBudget);
+}
+
+void RtpWorker::setPreviewSize(const QSize &size)
+{
+    if (size == previewSize)
+        return;
+
+    previewSize = size;
+    applyPreviewSize();
+}
+
 void RtpWorker::setInputVolume(int level)
 {
     QMutexLocker locker(&volumein_mutex);
@@ -463,6 +676,65 @@ void RtpWorker::setInputVolume(int level)
     }
 }
 
+static bool srtpParamsEqual(const PSrtpParams &a, const PSrtpParams &b)
+{
+    return a.cipher == b.cipher && a.auth == b.auth && a.key == b.key;
+}
+
+void RtpWorker::setSrtpParameters(const PSrtpParams &local, const PSrtpParams &remote)
+{
+    // encryption can't be switched on or off for running streams: a stream
+    //   started later would disagree with the ones already going.  the
+    //   stream pointers only change in this thread
+    bool sending   = audiortppay || videortppay;
+    bool receiving = audiortpsrc || videortpsrc;
+
+    QList<GstElement *> decoders;
+    {
+        QMutexLocker locker(&srtp_mutex);
+        bool         localOk  = bins_srtp_params_valid(local);
+        bool         remoteOk = bins_srtp_params_valid(remote);
+        if (localOk && sending && local.key.isEmpty() != !(audiosrtpenc || videosrtpenc)) {
+            qCWarning(lcWorker, "srtp: can't turn encryption %s for streams already sent",
+                      local.key.isEmpty() ? "off" : "on");
+            localOk = false;
+        }
+        if (remoteOk && receiving && remote.key.isEmpty() != !(audiosrtpdec || videosrtpdec)) {
+            qCWarning(lcWorker, "srtp: can't turn decryption %s for streams already received",
+                      remote.key.isEmpty() ? "off" : "on");
+            remoteOk = false;
+        }
+
+        bool localChanged  = localOk && !srtpParamsEqual(localSrtp, local);
+        bool remoteChanged = remoteOk && !srtpParamsEqual(remoteSrtp, remote);
+        if (localChanged)
+            localSrtp = local;
+        if (remoteChanged)
+            remoteSrtp = remote;
+
+        if (localChanged) {
+            if (audiosrtpenc)
+                bins_srtpenc_setkey(audiosrtpenc, localSrtp);
+            if (videosrtpenc)
+                bins_srtpenc_setkey(videosrtpenc, localSrtp);
+        }
+
+        if (remoteChanged) {
+            if (audiosrtpdec)
+                decoders += GST_ELEMENT(gst_object_ref(audiosrtpdec));
+            if (videosrtpdec)
+                decoders += GST_ELEMENT(gst_object_ref(videosrtpdec));
+        }
+    }
+
+    // srtpdec asks for the new key through request-key on the next packet.
+    //   don't hold srtp_mutex here, the request comes from the streaming thread
+    for (GstElement *srtpdec : decoders) {
+        g_signal_emit_by_name(srtpdec, "clear-keys");
+        gst_object_unref(srtpdec);
+    }
+}
+
 void RtpWorker::recordStart()
 {
     // FIXME: for now we just send EOF/error
@@ -493,6 +765,32 @@ void RtpWorker::dumpPipeline(std::function<void(const QStringList &)> callback)
     callback(ret);
 }
 
+void RtpWorker::pipelineSnapshot(std::function<void(const QVariantMap &)> callback)
+{
+    QVariantMap ret;
+    if (spipeline)
+        ret["send"] = pipeline_snapshot(spipeline);
+    if (rpipeline)
+        ret["receive"] = pipeline_snapshot(rpipeline);
+    callback(ret);
+}
+
+void RtpWorker::setLatencyTracing(bool enabled)
+{
+    latencyTracing = enabled;
+    latencyTracer.clear();
+    glassTracer.clear();
+    if (!enabled)
+        return;
+
+    if (sendbin)
+        traceSendLatency();
+    if (recvbin)
+        traceRecvLatency();
+}
+
+QList<PLatencyStage> RtpWorker::latencyStages() const { return latencyTracer.stages() + glassTracer.stages(); }
+
 gboolean RtpWorker::cb_doStart(gpointer data) { return static_cast<RtpWorker *>(data)->doStart(); }
 
 gboolean RtpWorker::cb_doUpdate(gpointer data) { return static_cast<RtpWorker *>(data)->doUpdate(); }
@@ -543,7 +841,7 @@ GstFlowReturn RtpWorker::cb_packet_ready_preroll_stub(GstAppSink *appsink, gpoin
 {
     Q_UNUSED(appsink)
     Q_UNUSED(data)
-    qDebug("RtpWorker::cb_packet_ready_preroll_stub");
+    qCDebug(lcWorker, "RtpWorker::cb_packet_ready_preroll_stub");
     return GST_FLOW_OK;
 }
 
@@ -551,11 +849,81 @@ void RtpWorker::cb_packet_ready_eos_stub(GstAppSink *appsink, gpointer data)
 {
     Q_UNUSED(appsink)
     Q_UNUSED(data)
-    qDebug("RtpWorker::cb_packet_ready_eos_stub");
+    qCDebug(lcWorker, "RtpWorker::cb_packet_ready_eos_stub");
+}
+
+void RtpWorker::cb_packet_ready_eos_rtp(GstAppSink *appsink, gpointer data)
+{
+    Q_UNUSED(appsink)
+    static_cast<RtpWorker *>(data)->rtpSinksAtEos.ref();
 }
 
 gboolean RtpWorker::cb_fileReady(gpointer data) { return static_cast<RtpWorker *>(data)->fileReady(); }
 
+GstCaps *RtpWorker::cb_srtpdec_request_key(GstElement *element, guint ssrc, gpointer data)
+{
+    return static_cast<RtpWorker *>(data)->srtpdec_request_key(element, ssrc);
+}
+
+gboolean RtpWorker::cb_checkVideoLoad(gpointer data) { return static_cast<RtpWorker *>(data)->checkVideoLoad(); }
+
+gboolean RtpWorker::cb_checkOfflineProgress(gpointer data)
+{
+    return static_cast<RtpWorker *>(data)->checkOfflineProgress();
+}
+
+GstPadProbeReturn RtpWorker::cb_videoenc_in_probe(GstPad *pad, GstPadProbeInfo *info, gpointer data)
+{
+    Q_UNUSED(pad)
+    static_cast<RtpWorker *>(data)->videoenc_in(GST_PAD_PROBE_INFO_BUFFER(info));
+    return GST_PAD_PROBE_OK;
+}
+
+GstPadProbeReturn RtpWorker::cb_videoenc_out_probe(GstPad *pad, GstPadProbeInfo *info, gpointer data)
+{
+    Q_UNUSED(pad)
+    GstBuffer *buffer = nullptr;
+    if (GST_PAD_PROBE_INFO_TYPE(info) & GST_PAD_PROBE_TYPE_BUFFER_LIST) {
+        GstBufferList *list = GST_PAD_PROBE_INFO_BUFFER_LIST(info);
+        if (gst_buffer_list_length(list) > 0)
+            buffer = gst_buffer_list_get(list, 0);
+    } else
+        buffer = GST_PAD_PROBE_INFO_BUFFER(info);
+
+    if (buffer)
+        static_cast<RtpWorker *>(data)->videoenc_out(buffer);
+    return GST_PAD_PROBE_OK;
+}
+
+GstPadProbeReturn RtpWorker::cb_videoenc_qos_probe(GstPad *pad, GstPadProbeInfo *info, gpointer data)
+{
+    Q_UNUSED(pad)
+    if (GST_EVENT_TYPE(GST_PAD_PROBE_INFO_EVENT(info)) == GST_EVENT_QOS)
+        static_cast<RtpWorker *>(data)->videoenc_qos();
+    return GST_PAD_PROBE_OK;
+}
+
+GstPadProbeReturn RtpWorker::cb_videodec_event_probe(GstPad *pad, GstPadProbeInfo *info, gpointer data)
+{
+    Q_UNUSED(pad)
+    static_cast<RtpWorker *>(data)->videodec_event(GST_PAD_PROBE_INFO_EVENT(info));
+    return GST_PAD_PROBE_OK;
+}
+
+GstPadProbeReturn RtpWorker::cb_videodec_in_probe(GstPad *pad, GstPadProbeInfo *info, gpointer data)
+{
+    Q_UNUSED(pad)
+    static_cast<RtpWorker *>(data)->videodec_in(GST_PAD_PROBE_INFO_BUFFER(info));
+    return GST_PAD_PROBE_OK;
+}
+
+GstPadProbeReturn RtpWorker::cb_videodec_out_probe(GstPad *pad, GstPadProbeInfo *info, gpointer data)
+{
+    Q_UNUSED(pad)
+    static_cast<RtpWorker *>(data)->videodec_out(GST_PAD_PROBE_INFO_BUFFER(info));
+    return GST_PAD_PROBE_OK;
+}
+
 gboolean RtpWorker::doStart()
 {
     timer = nullptr;
@@ -568,11 +936,19 @@ gboolean RtpWorker::doStart()
     audiortppay = nullptr;
     videortppay = nullptr;
 
+    rtpSinks = 0;
+    rtpSinksAtEos.storeRelease(0);
+    receivedTime.storeRelease(0);
+
     // default to 400kbps
     if (maxbitrate == -1)
         maxbitrate = 400;
 
-    if (!setupSendRecv()) {
+    EventRecorder::record("worker", "start", EventRecorder::Begin);
+    bool ok = setupSendRecv();
+    EventRecorder::record("worker", "start", EventRecorder::End);
+
+    if (!ok) {
         if (cb_error)
             cb_error(app);
     } else {
@@ -588,7 +964,11 @@ gboolean RtpWorker::doUpdate()
 {
     timer = nullptr;
 
-    if (!setupSendRecv()) {
+    EventRecorder::record("worker", "update", EventRecorder::Begin);
+    bool ok = setupSendRecv();
+    EventRecorder::record("worker", "update", EventRecorder::End);
+
+    if (!ok) {
         if (cb_error)
             cb_error(app);
     } else {
@@ -603,7 +983,9 @@ gboolean RtpWorker::doStop()
 {
     timer = nullptr;
 
+    EventRecorder::record("worker", "stop", EventRecorder::Begin);
     cleanup();
+    EventRecorder::record("worker", "stop", EventRecorder::End);
 
     if (cb_stopped)
         cb_stopped(app);
@@ -614,9 +996,7 @@ gboolean RtpWorker::doStop()
 void RtpWorker::fileDemux_no_more_pads(GstElement *element)
 {
     Q_UNUSED(element);
-#ifdef RTPWORKER_DEBUG
-    qDebug("no more pads");
-#endif
+    qCDebug(lcWorker, "no more pads");
 
     // FIXME: make this get canceled on cleanup?
     GSource *ftimer = g_timeout_source_new(0);
@@ -628,19 +1008,15 @@ void RtpWorker::fileDemux_pad_added(GstElement *element, GstPad *pad)
 {
     Q_UNUSED(element);
 
-#ifdef RTPWORKER_DEBUG
-    gchar *name = gst_pad_get_name(pad);
-    qDebug("pad-added: %s", name);
-    g_free(name);
-#endif
-
     GstCaps *caps = gst_pad_query_caps(pad, nullptr);
-#ifdef RTPWORKER_DEBUG
-    gchar * gstr       = gst_caps_to_string(caps);
-    QString capsString = QString::fromUtf8(gstr);
-    g_free(gstr);
-    qDebug("  caps: [%s]", qPrintable(capsString));
-#endif
+    if (lcWorker().isDebugEnabled()) {
+        gchar *name = gst_pad_get_name(pad);
+        gchar *gstr = gst_caps_to_string(caps);
+        qCDebug(lcWorker, "pad-added: %s", name);
+        qCDebug(lcWorker, "  caps: [%s]", gstr);
+        g_free(gstr);
+        g_free(name);
+    }
 
     guint num = gst_caps_get_size(caps);
     for (guint n = 0; n < num; ++n) {
@@ -708,11 +1084,11 @@ void RtpWorker::fileDemux_pad_removed(GstElement *element, GstPad *pad)
 
     // TODO: do we need to do anything here?
 
-#ifdef RTPWORKER_DEBUG
-    gchar *name = gst_pad_get_name(pad);
-    qDebug("pad-removed: %s", name);
-    g_free(name);
-#endif
+    if (lcWorker().isDebugEnabled()) {
+        gchar *name = gst_pad_get_name(pad);
+        qCDebug(lcWorker, "pad-removed: %s", name);
+        g_free(name);
+    }
 }
 
 gboolean RtpWorker::bus_call(GstBus *bus, GstMessage *msg)
@@ -721,7 +1097,7 @@ gboolean RtpWorker::bus_call(GstBus *bus, GstMessage *msg)
     // GMainLoop *loop = static_cast<GMainLoop *>(data);
     switch (GST_MESSAGE_TYPE(msg)) {
     case GST_MESSAGE_EOS: {
-        qDebug("End-of-stream");
+        qCDebug(lcWorker, "End-of-stream");
         // g_main_loop_quit(loop);
         break;
     }
@@ -732,7 +1108,7 @@ gboolean RtpWorker::bus_call(GstBus *bus, GstMessage *msg)
         gst_message_parse_error(msg, &err, &debug);
         g_free(debug);
 
-        qDebug("Error: %s: %s", gst_element_get_name(GST_MESSAGE_SRC(msg)), err->message);
+        qCWarning(lcWorker, "Error: %s: %s", gst_element_get_name(GST_MESSAGE_SRC(msg)), err->message);
         g_error_free(err);
 
         // g_main_loop_quit(loop);
@@ -740,7 +1116,7 @@ gboolean RtpWorker::bus_call(GstBus *bus, GstMessage *msg)
     }
     case GST_MESSAGE_SEGMENT_DONE: {
         // FIXME: we seem to get this event too often?
-        qDebug("Segment-done");
+        qCDebug(lcWorker, "Segment-done");
         /*gst_element_seek(sendPipeline, 1, GST_FORMAT_TIME,
                 (GstSeekFlags)(GST_SEEK_FLAG_SEGMENT),
                 GST_SEEK_TYPE_SET, 0, GST_SEEK_TYPE_END, 0);*/
@@ -753,7 +1129,7 @@ gboolean RtpWorker::bus_call(GstBus *bus, GstMessage *msg)
         gst_message_parse_warning(msg, &err, &debug);
         g_free(debug);
 
-        qDebug("Warning: %s: %s", gst_element_get_name(GST_MESSAGE_SRC(msg)), err->message);
+        qCWarning(lcWorker, "Warning: %s: %s", gst_element_get_name(GST_MESSAGE_SRC(msg)), err->message);
         g_error_free(err);
 
         // g_main_loop_quit(loop);
@@ -763,18 +1139,18 @@ gboolean RtpWorker::bus_call(GstBus *bus, GstMessage *msg)
         GstState oldstate, newstate, pending;
 
         gst_message_parse_state_changed(msg, &oldstate, &newstate, &pending);
-        qDebug("State changed: %s: %s->%s", gst_element_get_name(GST_MESSAGE_SRC(msg)), state_to_str(oldstate),
-               state_to_str(newstate));
+        qCDebug(lcWorker, "State changed: %s: %s->%s", gst_element_get_name(GST_MESSAGE_SRC(msg)),
+                state_to_str(oldstate), state_to_str(newstate));
         if (pending != GST_STATE_VOID_PENDING)
-            qDebug(" (%s)", state_to_str(pending));
+            qCDebug(lcWorker, " (%s)", state_to_str(pending));
         break;
     }
     case GST_MESSAGE_ASYNC_DONE: {
-        qDebug("Async done: %s", gst_element_get_name(GST_MESSAGE_SRC(msg)));
+        qCDebug(lcWorker, "Async done: %s", gst_element_get_name(GST_MESSAGE_SRC(msg)));
         break;
     }
     default:
-        qDebug("Bus message: %s", GST_MESSAGE_TYPE_NAME(msg));
+        qCDebug(lcWorker, "Bus message: %s", GST_MESSAGE_TYPE_NAME(msg));
         break;
     }
 
@@ -788,6 +1164,7 @@ GstFlowReturn RtpWorker::show_frame_preview(GstAppSink *appsink)
         return GST_FLOW_ERROR;
     }
 
+    EventRecorder::record("worker", "preview frame");
     if (cb_previewFrame)
         cb_previewFrame(frame, app);
 
@@ -801,6 +1178,10 @@ GstFlowReturn RtpWorker::show_frame_output(GstAppSink *appsink)
         return GST_FLOW_ERROR;
     }
 
+    videoFramesShown.ref();
+    EventRecorder::record("worker", "output frame");
+    latencyTracer.mark(VideoSinkMark, frame.pts);
+    glassTracer.mark(GlassToGlassTracer::Video, frame.pts);
     if (cb_outputFrame)
         cb_outputFrame(frame, app);
 
@@ -815,15 +1196,15 @@ GstFlowReturn RtpWorker::packet_ready_rtp_audio(GstAppSink *appsink)
     QByteArray ba;
     ba.resize(sz);
     gst_buffer_extract(buffer, 0, ba.data(), gsize(sz));
+    latencyTracer.mark(AudioHandoffMark, GST_BUFFER_PTS(buffer));
     gst_sample_unref(sample);
 
     PRtpPacket packet;
     packet.rawValue   = ba;
     packet.portOffset = 0;
 
-#ifdef RTPWORKER_DEBUG
-    audioStats->print_stats(packet.rawValue.size());
-#endif
+    audioMetrics.packetOut(ba);
+    EventRecorder::record("worker", "rtp audio out", EventRecorder::Instant, sz);
 
     QMutexLocker locker(&rtpaudioout_mutex);
     if (cb_rtpAudioOut && rtpaudioout)
@@ -840,17 +1221,19 @@ GstFlowReturn RtpWorker::packet_ready_rtp_video(GstAppSink *appsink)
     QByteArray ba;
     ba.resize(sz);
     gst_buffer_extract(buffer, 0, ba.data(), gsize(sz));
+    latencyTracer.mark(VideoHandoffMark, GST_BUFFER_PTS(buffer));
     gst_sample_unref(sample);
 
     PRtpPacket packet;
     packet.rawValue   = ba;
     packet.portOffset = 0;
 
-#ifdef RTPWORKER_DEBUG
-    videoStats->print_stats(packet.rawValue.size());
-#endif
+    videoMetrics.packetOut(ba);
+    EventRecorder::record("worker", "rtp video out", EventRecorder::Instant, sz);
 
     QMutexLocker locker(&rtpvideoout_mutex);
+    if (ba.size() >= 12)
+        localVideoSsrc = qFromBigEndian<quint32>(ba.constData() + 8);
     if (cb_rtpVideoOut && rtpvideoout)
         cb_rtpVideoOut(packet, app);
 
@@ -880,11 +1263,466 @@ gboolean RtpWorker::fileReady()
         return FALSE;
     }
 
+    if (offline)
+        startOfflineProgress();
+
     if (cb_started)
         cb_started(app);
     return FALSE;
 }
 
+// note: this is executed from the streaming thread
+GstCaps *RtpWorker::srtpdec_request_key(GstElement *element, guint ssrc)
+{
+    Q_UNUSED(element);
+    qCDebug(lcWorker, "srtp key requested for ssrc %08x", ssrc);
+
+    QMutexLocker locker(&srtp_mutex);
+    return bins_srtpdec_keycaps(remoteSrtp);
+}
+
+// steps taken when the encoder can't keep up, in percent of the
+//   configured size and frame rate
+static const struct {
+    int scale;
+    int rate;
+} video_levels[] = { { 100, 100 }, { 100, 66 }, { 75, 66 }, { 50, 50 }, { 50, 33 }, { 25, 33 } };
+
+static const int video_level_count = sizeof(video_levels) / sizeof(video_levels[0]);
+
+static QSize video_level_size(const QSize &base, int level)
+{
+    int w = base.width() * video_levels[level].scale / 100;
+    int h = base.height() * video_levels[level].scale / 100;
+
+    // keep dimensions even for the chroma subsampling
+    return QSize(qMax(2, w & ~1), qMax(2, h & ~1));
+}
+
+static int video_level_fps(int base, int level) { return qMax(5, base * video_levels[level].rate / 100); }
+
+// note: this is executed from the streaming thread.  the decoder hands
+//   its frames on from the thread that feeds it, so in and out never race
+void RtpWorker::videodec_in(GstBuffer *buffer)
+{
+    videoFramesIn.ref();
+
+    GstClockTime pts = GST_BUFFER_PTS(buffer);
+    if (!GST_CLOCK_TIME_IS_VALID(pts))
+        return;
+
+    decodeStarts += qMakePair(pts, g_get_monotonic_time());
+    while (decodeStarts.count() > 30)
+        decodeStarts.removeFirst();
+}
+
+// note: this is executed from the streaming thread
+void RtpWorker::videodec_out(GstBuffer *buffer)
+{
+    videoFramesDecoded.ref();
+
+    GstClockTime pts = GST_BUFFER_PTS(buffer);
+    if (!GST_CLOCK_TIME_IS_VALID(pts))
+        return;
+
+    for (int n = 0; n < decodeStarts.count(); ++n) {
+        if (decodeStarts[n].first != pts)
+            continue;
+
+        // a frame may span several depayloaded buffers, time it from the last one
+        int start = n;
+        while (start + 1 < decodeStarts.count() && decodeStarts[start + 1].first == pts)
+            ++start;
+        int sample = int(g_get_monotonic_time() - decodeStarts[start].second);
+        decodeStarts.erase(decodeStarts.begin(), decodeStarts.begin() + start + 1);
+
+        int old = decodeTime.loadAcquire();
+        decodeTime.storeRelease(old ? (old * 7 + sample) / 8 : sample);
+        break;
+    }
+}
+
+// note: this is executed from the streaming thread
+void RtpWorker::videoenc_in(GstBuffer *buffer)
+{
+    GstClockTime pts = GST_BUFFER_PTS(buffer);
+    if (!GST_CLOCK_TIME_IS_VALID(pts))
+        return;
+
+    QMutexLocker locker(&videoload_mutex);
+    encodeStarts += qMakePair(pts, g_get_monotonic_time());
+
+    // frames the encoder decided to drop never come out, don't let
+    //   them pile up
+    while (encodeStarts.count() > 30)
+        encodeStarts.removeFirst();
+}
+
+// note: this is executed from the streaming thread
+void RtpWorker::videoenc_out(GstBuffer *buffer)
+{
+    GstClockTime pts = GST_BUFFER_PTS(buffer);
+    if (!GST_CLOCK_TIME_IS_VALID(pts))
+        return;
+
+    QMutexLocker locker(&videoload_mutex);
+    for (int n = 0; n < encodeStarts.count(); ++n) {
+        if (encodeStarts[n].first != pts)
+            continue;
+
+        // only the first packet of a frame counts, the rest of the
+        //   frame has no entry left to match
+        gint64 sample = g_get_monotonic_time() - encodeStarts[n].second;
+        encodeStarts.erase(encodeStarts.begin(), encodeStarts.begin() + n + 1);
+        encodeTime = encodeTime ? (encodeTime * 7 + sample) / 8 : sample;
+        break;
+    }
+}
+
+// note: this is executed from the streaming thread
+void RtpWorker::videoenc_qos()
+{
+    QMutexLocker locker(&videoload_mutex);
+    ++qosEvents;
+}
+
+// note: this is executed from the streaming thread
+void RtpWorker::videodec_event(GstEvent *event)
+{
+    // the depayloader or decoder ask upstream for a keyframe when they can't
+    //   go on.  lost packets reported downstream by the jitterbuffer only
+    //   come here for decoders that can't ask
+    if ((GST_EVENT_TYPE(event) == GST_EVENT_CUSTOM_DOWNSTREAM && gst_event_has_name(event, "GstRTPPacketLost"))
+        || gst_video_event_is_force_key_unit(event))
+        sendPictureLossIndication();
+}
+
+void RtpWorker::startVideoLoadMonitor(GstElement *prep, GstElement *queue, GstElement *enc, const QSize &size, int fps)
+{
+    videoprepbin   = prep;
+    videortpqueue  = queue;
+    videoBaseSize  = size;
+    videoBaseFps   = fps;
+    videoLevel     = 0;
+    overloadTicks  = 0;
+    underloadTicks = 0;
+
+    videoload_mutex.lock();
+    encodeStarts.clear();
+    encodeTime = 0;
+    qosEvents  = 0;
+    videoload_mutex.unlock();
+
+    GstPad *pad = gst_element_get_static_pad(enc, "sink");
+    gst_pad_add_probe(pad, GST_PAD_PROBE_TYPE_BUFFER, cb_videoenc_in_probe, this, nullptr);
+    gst_object_unref(GST_OBJECT(pad));
+
+    pad = gst_element_get_static_pad(enc, "src");
+    gst_pad_add_probe(pad, GstPadProbeType(GST_PAD_PROBE_TYPE_BUFFER | GST_PAD_PROBE_TYPE_BUFFER_LIST),
+                      cb_videoenc_out_probe, this, nullptr);
+    gst_object_unref(GST_OBJECT(pad));
+
+    // only qos from the encoder branch counts.  a slow local preview is no
+    //   reason to send less, it drops its own late frames
+    pad = gst_element_get_static_pad(queue, "sink");
+    gst_pad_add_probe(pad, GST_PAD_PROBE_TYPE_EVENT_UPSTREAM, cb_videoenc_qos_probe, this, nullptr);
+    gst_object_unref(GST_OBJECT(pad));
+
+    if (loadTimer)
+        g_source_destroy(loadTimer);
+    loadTimer = g_timeout_source_new(1000);
+    g_source_set_callback(loadTimer, cb_checkVideoLoad, this, nullptr);
+    g_source_attach(loadTimer, mainContext_);
+    g_source_unref(loadTimer); // the context keeps it alive until destroyed
+}
+
+gboolean RtpWorker::checkVideoLoad()
+{
+    videoload_mutex.lock();
+    gint64 encode = encodeTime;
+    int    qos    = qosEvents;
+    qosEvents     = 0;
+    videoload_mutex.unlock();
+
+    guint queued = 0, queueMax = 0;
+    g_object_get(G_OBJECT(videortpqueue), "current-level-buffers", &queued, "max-size-buffers", &queueMax, nullptr);
+
+    int    fps      = video_level_fps(videoBaseFps, videoLevel);
+    gint64 interval = G_USEC_PER_SEC / fps;
+    bool   queueing = queueMax > 0 && queued * 2 >= queueMax;
+
+    qCDebug(lcWorker, "video load: encode=%dus interval=%dus queued=%u qos=%d level=%d", int(encode), int(interval),
+            queued, qos, videoLevel);
+
+    if (encode > interval * 8 / 10 || queueing || qos > fps / 4) {
+        underloadTicks = 0;
+
+        // a single bad second is usually a hiccup, not a trend
+        if (++overloadTicks >= 2 && videoLevel + 1 < video_level_count)
+            setVideoLevel(videoLevel + 1);
+        return TRUE;
+    }
+
+    overloadTicks = 0;
+    if (videoLevel == 0 || encode == 0 || queued > 1 || qos > 0) {
+        underloadTicks = 0;
+        return TRUE;
+    }
+
+    if (++underloadTicks < 5)
+        return TRUE;
+
+    // only go back up if the previous level should fit comfortably,
+    //   assuming encode time follows the pixel count
+    QSize  cur       = video_level_size(videoBaseSize, videoLevel);
+    QSize  next      = video_level_size(videoBaseSize, videoLevel - 1);
+    gint64 predicted = encode * next.width() * next.height() / (cur.width() * cur.height());
+    if (predicted * 2 < G_USEC_PER_SEC / video_level_fps(videoBaseFps, videoLevel - 1))
+        setVideoLevel(videoLevel - 1);
+    else
+        underloadTicks = 0;
+
+    return TRUE;
+}
+
+// largest size with the aspect ratio of source that fits in target, or an
+//   invalid size if no downscaling is needed
+static QSize preview_fit_size(const QSize &source, const QSize &target)
+{
+    if (source.isEmpty() || target.isEmpty())
+        return QSize();
+
+    QSize size = source.scaled(target, Qt::KeepAspectRatio);
+    if (size.width() >= source.width())
+        return QSize();
+
+    return QSize(qMax(2, size.width() & ~1), qMax(2, size.height() & ~1));
+}
+
+void RtpWorker::applyPreviewSize()
+{
+    if (!previewfilter)
+        return;
+
+    GstCaps *caps;
+    QSize    size = preview_fit_size(previewSourceSize, previewSize);
+    if (size.isValid()) {
+        caps = gst_caps_new_simple("video/x-raw", "width", G_TYPE_INT, size.width(), "height", G_TYPE_INT,
+                                   size.height(), "pixel-aspect-ratio", GST_TYPE_FRACTION, 1, 1, nullptr);
+    } else
+        caps = gst_caps_new_any();
+
+    qCDebug(lcWorker, "preview size: %dx%d", size.width(), size.height());
+
+    // the converter renegotiates on the fly
+    g_object_set(G_OBJECT(previewfilter), "caps", caps, nullptr);
+    gst_caps_unref(caps);
+}
+
+void RtpWorker::startOfflineProgress()
+{
+    if (offlineTimer)
+        return;
+
+    offlineStart = g_get_monotonic_time();
+    offlineTimer = g_timeout_source_new(OFFLINE_PROGRESS_INTERVAL);
+    g_source_set_callback(offlineTimer, cb_checkOfflineProgress, this, nullptr);
+    g_source_attach(offlineTimer, mainContext_);
+    g_source_unref(offlineTimer); // the context keeps it alive until destroyed
+}
+
+// file input counts down to its duration, and is done once both rtp sinks
+//   saw the end of it.  received rtp only has a position, the caller knows
+//   when it stops writing
+gboolean RtpWorker::checkOfflineProgress()
+{
+    gint64 position = -1, duration = -1;
+    if (fileDemux) {
+        if (!gst_element_query_position(spipeline, GST_FORMAT_TIME, &position))
+            position = -1;
+        if (!gst_element_query_duration(spipeline, GST_FORMAT_TIME, &duration))
+            duration = -1;
+    } else
+        position = receivedTime.loadAcquire();
+
+    bool done = fileDemux && rtpSinks > 0 && rtpSinksAtEos.loadAcquire() >= rtpSinks;
+    if (done && duration >= 0)
+        position = duration;
+
+    // at the rate so far
+    qint64 remaining = -1;
+    if (done)
+        remaining = 0;
+    else if (position > 0 && duration >= position) {
+        gint64 elapsed = g_get_monotonic_time() - offlineStart;
+        remaining      = qint64(double(elapsed) * double(duration - position) / double(position)) / 1000;
+    }
+
+    if (cb_offlineProgress)
+        cb_offlineProgress(position < 0 ? -1 : position / GST_MSECOND, duration < 0 ? -1 : duration / GST_MSECOND,
+                           remaining, app);
+
+    if (!done)
+        return TRUE;
+
+    offlineTimer = nullptr;
+    if (cb_finished)
+        cb_finished(app);
+    return FALSE;
+}
+
+void RtpWorker::setVideoLevel(int level)
+{
+    QSize size = video_level_size(videoBaseSize, level);
+    int   fps  = video_level_fps(videoBaseFps, level);
+    if (!bins_videoprep_set(videoprepbin, size, fps))
+        return;
+
+    qCDebug(lcWorker, "video %s to %dx%d at %dfps", level > videoLevel ? "degraded" : "restored", size.width(),
+            size.height(), fps);
+
+    EventRecorder::record("worker", "video level", EventRecorder::Counter, level);
+
+    videoLevel     = level;
+    overloadTicks  = 0;
+    underloadTicks = 0;
+
+    // the preview is fed from behind the videoprep bin
+    previewSourceSize = size;
+    applyPreviewSize();
+
+    videoEncSize = size;
+    videoEncFps  = fps;
+    retuneVideoEncoder();
+
+    // measurements from the old level say nothing about the new one
+    videoload_mutex.lock();
+    encodeStarts.clear();
+    encodeTime = 0;
+    qosEvents  = 0;
+    videoload_mutex.unlock();
+
+    if (cb_videoAdaptation)
+        cb_videoAdaptation(size, fps, level > 0, app);
+}
+
+static gint compare_factory(gconstpointer a, gconstpointer b)
+{
+    auto               e       = static_cast<GstElement *>(g_value_get_object(static_cast<const GValue *>(a)));
+    GstElementFactory *factory = gst_element_get_factory(e);
+    return (factory && strcmp(GST_OBJECT_NAME(factory), static_cast<const char *>(b)) == 0) ? 0 : 1;
+}
+
+// first element made by the given factory anywhere inside bin, or null
+static GstElement *find_by_factory(GstElement *bin, const char *factoryName)
+{
+    GstElement * ret  = nullptr;
+    GValue       item = G_VALUE_INIT;
+    GstIterator *it   = gst_bin_iterate_recurse(GST_BIN(bin));
+    if (gst_iterator_find_custom(it, compare_factory, &item, const_cast<char *>(factoryName))) {
+        ret = static_cast<GstElement *>(g_value_dup_object(&item));
+        g_value_unset(&item);
+    }
+    gst_iterator_free(it);
+    return ret;
+}
+
+// latency stage ending at a pad of the named element inside bin, if any
+static void trace_child(LatencyTracer *tracer, GstElement *bin, const char *child, const char *padName,
+                        const QString &stream, const QString &name)
+{
+    GstElement *e = gst_bin_get_by_name(GST_BIN(bin), child);
+    if (!e)
+        return;
+    tracer->addPadStage(stream, name, e, padName);
+    gst_object_unref(GST_OBJECT(e));
+}
+
+// reads the capture time stamps where the depayloader takes the packets
+//   from the jitterbuffer, which keeps the arrival timestamps
+static void trace_glass(GlassToGlassTracer *tracer, GstElement *decbin, GlassToGlassTracer::Stream stream)
+{
+    GstElement *e = gst_bin_get_by_name(GST_BIN(decbin), "depayloader");
+    if (!e)
+        return;
+    tracer->addReader(stream, e, "sink");
+    gst_object_unref(GST_OBJECT(e));
+}
+
+void RtpWorker::traceSendLatency()
+{
+    // file input is not live, its timestamps say nothing about latency
+    if (fileDemux)
+        return;
+
+    GstElement *encbin = gst_bin_get_by_name(GST_BIN(sendbin), "audioencbin");
+    if (encbin) {
+        QString stream = "audio-send";
+
+        // with echo cancellation, the capture ends where webrtcdsp starts
+        GstElement *dsp = (audiosrc && GST_IS_BIN(audiosrc)) ? find_by_factory(audiosrc, "webrtcdsp") : nullptr;
+        if (dsp) {
+            latencyTracer.addPadStage(stream, "capture", dsp, "sink");
+            latencyTracer.addPadStage(stream, "aec", dsp, "src");
+            gst_object_unref(GST_OBJECT(dsp));
+        } else if (audiosrc)
+            latencyTracer.addPadStage(stream, "capture", audiosrc, "src");
+
+        trace_child(&latencyTracer, encbin, "encoder", "src", stream, "encode");
+        latencyTracer.addPadStage(stream, "pay", encbin, "src");
+        latencyTracer.addMarkStage(stream, "handoff", sendbin, AudioHandoffMark);
+        glassTracer.addStamper(GlassToGlassTracer::Audio, encbin, "src");
+        gst_object_unref(GST_OBJECT(encbin));
+    }
+
+    encbin = gst_bin_get_by_name(GST_BIN(sendbin), "videoencbin");
+    if (encbin) {
+        QString stream = "video-send";
+        if (videosrc)
+            latencyTracer.addPadStage(stream, "capture", videosrc, "src");
+        trace_child(&latencyTracer, sendbin, "videoprepbin", "src", stream, "prep");
+        trace_child(&latencyTracer, sendbin, "rtpqueue", "src", stream, "queue");
+        trace_child(&latencyTracer, encbin, "encoder", "src", stream, "encode");
+        latencyTracer.addPadStage(stream, "pay", encbin, "src");
+        latencyTracer.addMarkStage(stream, "handoff", sendbin, VideoHandoffMark);
+        glassTracer.addStamper(GlassToGlassTracer::Video, encbin, "src");
+        gst_object_unref(GST_OBJECT(encbin));
+    }
+}
+
+void RtpWorker::traceRecvLatency()
+{
+    // the jitterbuffer stamps packets with their arrival time, so the
+    //   receive side is measured from there
+    GstElement *decbin = gst_bin_get_by_name(GST_BIN(recvbin), "audiodecbin");
+    if (decbin) {
+        QString stream = "audio-recv";
+        trace_child(&latencyTracer, decbin, "jitterbuffer", "src", stream, "jitterbuffer");
+        trace_child(&latencyTracer, decbin, "depayloader", "src", stream, "depay");
+        latencyTracer.addPadStage(stream, "decode", decbin, "src");
+        // up to the handoff to the output device and until it plays, if
+        //   there is one
+        latencyTracer.addPadStage(stream, "convert", recvbin, "src");
+        latencyTracer.addSinkStage(stream, "sink", recvbin, "src");
+        trace_glass(&glassTracer, decbin, GlassToGlassTracer::Audio);
+        glassTracer.addOutputPad(GlassToGlassTracer::Audio, recvbin, "src");
+        gst_object_unref(GST_OBJECT(decbin));
+    }
+
+    decbin = gst_bin_get_by_name(GST_BIN(recvbin), "videodecbin");
+    if (decbin) {
+        QString stream = "video-recv";
+        trace_child(&latencyTracer, decbin, "jitterbuffer", "src", stream, "jitterbuffer");
+        trace_child(&latencyTracer, decbin, "depayloader", "src", stream, "depay");
+        latencyTracer.addPadStage(stream, "decode", decbin, "src");
+        trace_child(&latencyTracer, recvbin, "netvideoplay", "sink", stream, "convert");
+        latencyTracer.addMarkStage(stream, "sink", recvbin, VideoSinkMark);
+        trace_glass(&glassTracer, decbin, GlassToGlassTracer::Video);
+        glassTracer.addOutputMark(GlassToGlassTracer::Video, recvbin);
+        gst_object_unref(GST_OBJECT(decbin));
+    }
+}
+
 bool RtpWorker::setupSendRecv()
 {
     // FIXME:
@@ -907,6 +1745,8 @@ bool RtpWorker::setupSendRecv()
         if (!localAudioParams.isEmpty() || !localVideoParams.isEmpty()) {
             if (!startSend())
                 return false;
+            if (latencyTracing)
+                traceSendLatency();
         }
     } else {
         // TODO: support adding/removing audio/video to existing session
@@ -923,6 +1763,8 @@ bool RtpWorker::setupSendRecv()
             || (!localVideoParams.isEmpty() && !remoteVideoPayloadInfo.isEmpty())) {
             if (!startRecv())
                 return false;
+            if (latencyTracing)
+                traceRecvLatency();
         }
     } else {
         // TODO: support adding/removing audio/video to existing session
@@ -980,9 +1822,7 @@ bool RtpWorker::startSend(int rate)
 
             pd_audiosrc = PipelineDeviceContext::create(send_pipelineContext, ain, PDevice::AudioIn, options);
             if (!pd_audiosrc) {
-#ifdef RTPWORKER_DEBUG
-                qDebug("Failed to create audio input element '%s'.", qPrintable(ain));
-#endif
+                qCDebug(lcWorker, "Failed to create audio input element '%s'.", qPrintable(ain));
                 g_object_unref(G_OBJECT(sendbin));
                 sendbin = nullptr;
 
@@ -1000,9 +1840,7 @@ bool RtpWorker::startSend(int rate)
 
             pd_videosrc = PipelineDeviceContext::create(send_pipelineContext, vin, PDevice::VideoIn, opts);
             if (!pd_videosrc) {
-#ifdef RTPWORKER_DEBUG
-                qDebug("Failed to create video input element '%s'.", qPrintable(vin));
-#endif
+                qCDebug(lcWorker, "Failed to create video input element '%s'.", qPrintable(vin));
                 delete pd_audiosrc;
                 pd_audiosrc = nullptr;
                 g_object_unref(G_OBJECT(sendbin));
@@ -1052,6 +1890,11 @@ bool RtpWorker::startSend(int rate)
     gst_bin_add(GST_BIN(spipeline), sendbin);
 
     if (!audiosrc && !videosrc) {
+        // without a clock nothing waits, the file goes as fast as it
+        //   decodes and encodes
+        if (offline)
+            gst_pipeline_use_clock(GST_PIPELINE(spipeline), nullptr);
+
         // in the case of files, preroll
         gst_element_set_state(spipeline, GST_STATE_PAUSED);
         gst_element_get_state(spipeline, nullptr, nullptr, GST_CLOCK_TIME_NONE);
@@ -1069,9 +1912,7 @@ bool RtpWorker::startSend(int rate)
         // gst_element_set_state(sendbin, GST_STATE_READY);
         // gst_element_get_state(sendbin, nullptr, nullptr, GST_CLOCK_TIME_NONE);
 
-#ifdef RTPWORKER_DEBUG
-        qDebug("changing state...");
-#endif
+        qCDebug(lcWorker, "changing state...");
 
         // gst_element_set_state(sendbin, GST_STATE_PLAYING);
         if (audiosrc) {
@@ -1082,13 +1923,12 @@ bool RtpWorker::startSend(int rate)
             gst_element_link(videosrc, sendbin);
             // pd_videosrc->activate();
         }
-#ifdef RTPWORKER_DEBUG
-        GST_DEBUG_BIN_TO_DOT_FILE_WITH_TS(GST_BIN(spipeline), GST_DEBUG_GRAPH_SHOW_ALL, "psimedia_send_inactive");
-#endif
+        if (lcWorker().isDebugEnabled())
+            GST_DEBUG_BIN_TO_DOT_FILE_WITH_TS(GST_BIN(spipeline), GST_DEBUG_GRAPH_SHOW_ALL, "psimedia_send_inactive");
 
         /*if(shared_clock && recv_clock_is_shared)
         {
-            qDebug("send pipeline slaving to recv clock");
+            qCDebug(lcWorker, "send pipeline slaving to recv clock");
             gst_pipeline_use_clock(GST_PIPELINE(spipeline), shared_clock);
         }*/
 
@@ -1100,16 +1940,14 @@ bool RtpWorker::startSend(int rate)
         int ret = gst_element_get_state(spipeline, nullptr, nullptr, 10 * GST_SECOND);
         // gst_element_get_state(sendbin, nullptr, nullptr, GST_CLOCK_TIME_NONE);
         if (ret != GST_STATE_CHANGE_SUCCESS && ret != GST_STATE_CHANGE_NO_PREROLL) {
-#ifdef RTPWORKER_DEBUG
-            qDebug("error/timeout while setting send pipeline to PLAYING");
-#endif
+            qCDebug(lcWorker, "error/timeout while setting send pipeline to PLAYING");
             cleanup();
             error = RtpSessionContext::ErrorGeneric;
             return false;
         }
 
         if (!shared_clock && use_shared_clock) {
-            qDebug("send clock is master");
+            qCDebug(lcWorker, "send clock is master");
 
             shared_clock = gst_pipeline_get_clock(GST_PIPELINE(spipeline));
             gst_pipeline_use_clock(GST_PIPELINE(spipeline), shared_clock);
@@ -1117,7 +1955,7 @@ bool RtpWorker::startSend(int rate)
 
             // if recv active, apply this clock to it
             if (recv_in_use) {
-                qDebug("recv pipeline slaving to send clock");
+                qCDebug(lcWorker, "recv pipeline slaving to send clock");
                 gst_element_set_state(rpipeline, GST_STATE_READY);
                 gst_element_get_state(rpipeline, nullptr, nullptr, GST_CLOCK_TIME_NONE);
                 gst_pipeline_use_clock(GST_PIPELINE(rpipeline), shared_clock);
@@ -1125,14 +1963,13 @@ bool RtpWorker::startSend(int rate)
             }
         }
 
-#ifdef RTPWORKER_DEBUG
-        qDebug("state changed");
-
-        qDebug("Dumping send pipeline");
-        dump_pipeline(spipeline);
-        GST_DEBUG_BIN_TO_DOT_FILE_WITH_TS(GST_BIN(spipeline), GST_DEBUG_GRAPH_SHOW_ALL, "psimedia_send_active");
+        if (lcWorker().isDebugEnabled()) {
+            qCDebug(lcWorker, "state changed");
 
-#endif
+            qCDebug(lcWorker, "Dumping send pipeline");
+            dump_pipeline(spipeline);
+            GST_DEBUG_BIN_TO_DOT_FILE_WITH_TS(GST_BIN(spipeline), GST_DEBUG_GRAPH_SHOW_ALL, "psimedia_send_active");
+        }
 
         if (!getCaps()) {
             error = RtpSessionContext::ErrorCodec;
@@ -1151,6 +1988,11 @@ bool RtpWorker::startRecv()
     QString     acodec, vcodec;
     GstElement *audioout = nullptr;
     GstElement *asrc     = nullptr;
+    bool        srtp     = false;
+
+    srtp_mutex.lock();
+    srtp = !remoteSrtp.key.isEmpty();
+    srtp_mutex.unlock();
 
     // TODO: support more than opus
     int opus_at = -1;
@@ -1179,17 +2021,13 @@ bool RtpWorker::startRecv()
     }
 
     if (!remoteAudioPayloadInfo.isEmpty() && opus_at != -1) {
-#ifdef RTPWORKER_DEBUG
-        qDebug("setting up audio recv");
-#endif
+        qCDebug(lcWorker, "setting up audio recv");
 
         int at = opus_at;
 
         GstStructure *cs = payloadInfoToStructure(remoteAudioPayloadInfo[at], "audio");
         if (!cs) {
-#ifdef RTPWORKER_DEBUG
-            qDebug("cannot parse payload info");
-#endif
+            qCDebug(lcWorker, "cannot parse payload info");
             return false;
         }
 
@@ -1200,33 +2038,40 @@ bool RtpWorker::startRecv()
             recvbin = gst_bin_new("recvbin");
 
         audiortpsrc_mutex.lock();
-        audiortpsrc = gst_element_factory_make("appsrc", nullptr);
+        audiortpsrc            = gst_element_factory_make("appsrc", nullptr);
+        audioInClock           = MediaClock();
+        audioInClock.clockRate = remoteAudioPayloadInfo[at].clockrate;
         audiortpsrc_mutex.unlock();
 
+        // srtpdec takes the encrypted stream, and strips the srtp bits on output
+        if (srtp)
+            gst_structure_set_name(cs, "application/x-srtp");
+
         GstCaps *caps = gst_caps_new_empty();
         gst_caps_append_structure(caps, cs);
         g_object_set(G_OBJECT(audiortpsrc), "caps", caps, nullptr);
         gst_caps_unref(caps);
 
+        // buffers carry their rtp time, and writes wait for the pipeline
+        if (offline)
+            g_object_set(G_OBJECT(audiortpsrc), "format", GST_FORMAT_TIME, "block", TRUE, nullptr);
+
         // FIXME: what if we don't have a name and just id?
         //   it's okay, for now we only support opus which requires
         //   the name..
         // UPD 2016-04-16: it's not clear after migrating to opus
         acodec = remoteAudioPayloadInfo[at].name.toLower();
+        audioMetrics.setClockRate(remoteAudioPayloadInfo[at].clockrate);
     }
 
     if (!remoteVideoPayloadInfo.isEmpty() && theora_at != -1) {
-#ifdef RTPWORKER_DEBUG
-        qDebug("setting up video recv");
-#endif
+        qCDebug(lcWorker, "setting up video recv");
 
         int at = theora_at;
 
         GstStructure *cs = payloadInfoToStructure(remoteVideoPayloadInfo[at], "video");
         if (!cs) {
-#ifdef RTPWORKER_DEBUG
-            qDebug("cannot parse payload info");
-#endif
+            qCDebug(lcWorker, "cannot parse payload info");
             goto fail1;
         }
 
@@ -1237,18 +2082,27 @@ bool RtpWorker::startRecv()
             recvbin = gst_bin_new("recvbin");
 
         videortpsrc_mutex.lock();
-        videortpsrc = gst_element_factory_make("appsrc", nullptr);
+        videortpsrc            = gst_element_factory_make("appsrc", nullptr);
+        videoInClock           = MediaClock();
+        videoInClock.clockRate = remoteVideoPayloadInfo[at].clockrate;
         videortpsrc_mutex.unlock();
 
+        if (srtp)
+            gst_structure_set_name(cs, "application/x-srtp");
+
         GstCaps *caps = gst_caps_new_empty();
         gst_caps_append_structure(caps, cs);
         g_object_set(G_OBJECT(videortpsrc), "caps", caps, nullptr);
         gst_caps_unref(caps);
 
+        if (offline)
+            g_object_set(G_OBJECT(videortpsrc), "format", GST_FORMAT_TIME, "block", TRUE, nullptr);
+
         // FIXME: what if we don't have a name and just id?
         //   it's okay, for now we only really support theora which
         //   requires the name..
         vcodec = remoteVideoPayloadInfo[at].name;
+        videoMetrics.setClockRate(remoteVideoPayloadInfo[at].clockrate);
         if (vcodec == "H263-1998") // FIXME: gross
             vcodec = "h263p";
         else
@@ -1266,16 +2120,22 @@ bool RtpWorker::startRecv()
         if (!audiodec)
             goto fail1;
 
-        if (!aout.isEmpty()) {
-#ifdef RTPWORKER_DEBUG
-            qDebug("creating audioout");
-#endif
+        GstElement *srtpdec = nullptr;
+        if (srtp) {
+            srtpdec = makeSrtpDecoder();
+            if (!srtpdec) {
+                g_object_unref(G_OBJECT(audiodec));
+                goto fail1;
+            }
+        }
+
+        // offline, the sound card would pace the stream
+        if (!aout.isEmpty() && !offline) {
+            qCDebug(lcWorker, "creating audioout");
 
             pd_audiosink = PipelineDeviceContext::create(recv_pipelineContext, aout, PDevice::AudioOut);
             if (!pd_audiosink) {
-#ifdef RTPWORKER_DEBUG
-                qDebug("failed to create audio output element");
-#endif
+                qCDebug(lcWorker, "failed to create audio output element");
                 goto fail1;
             }
             if (pd_audiosrc) {
@@ -1302,6 +2162,8 @@ bool RtpWorker::startRecv()
             asrc = audioresample;
 
         gst_bin_add(GST_BIN(recvbin), audiortpsrc);
+        if (srtpdec)
+            gst_bin_add(GST_BIN(recvbin), srtpdec);
         gst_bin_add(GST_BIN(recvbin), audiodec);
         gst_bin_add(GST_BIN(recvbin), volumeout);
         gst_bin_add(GST_BIN(recvbin), audioconvert);
@@ -1309,7 +2171,15 @@ bool RtpWorker::startRecv()
         if (!asrc)
             gst_bin_add(GST_BIN(recvbin), audioout);
 
-        gst_element_link_many(audiortpsrc, audiodec, volumeout, audioconvert, audioresample, nullptr);
+        if (srtpdec) {
+            gst_element_link_pads(audiortpsrc, "src", srtpdec, "rtp_sink");
+            gst_element_link_pads(srtpdec, "rtp_src", audiodec, "sink");
+
+            QMutexLocker locker(&srtp_mutex);
+            audiosrtpdec = srtpdec;
+        } else
+            gst_element_link(audiortpsrc, audiodec);
+        gst_element_link_many(audiodec, volumeout, audioconvert, audioresample, nullptr);
         if (!asrc)
             gst_element_link(audioresample, audioout);
 
@@ -1321,9 +2191,29 @@ bool RtpWorker::startRecv()
         if (!videodec)
             goto fail1;
 
-        GstElement *videoconvert = gst_element_factory_make("videoconvert", nullptr);
+        GstElement *srtpdec = nullptr;
+        if (srtp) {
+            srtpdec = makeSrtpDecoder();
+            if (!srtpdec) {
+                g_object_unref(G_OBJECT(videodec));
+                goto fail1;
+            }
+        }
+
+        GstElement *videoconvert = bins_videoconvert_create(false);
         GstAppSink *appVideoSink = makeVideoPlayAppSink("netvideoplay");
 
+        // the sink reports how late frames are, so the decoder and the
+        //   converter can skip work that would only be thrown away. keep
+        //   at most a couple of frames queued and prefer the newest
+        //   offline, nothing is late and every frame is wanted
+        if (offline)
+            g_object_set(G_OBJECT(appVideoSink), "sync", FALSE, nullptr);
+        else {
+            g_object_set(G_OBJECT(videoconvert), "qos", TRUE, nullptr);
+            g_object_set(G_OBJECT(appVideoSink), "qos", TRUE, "max-buffers", 2, "drop", TRUE, nullptr);
+        }
+
         GstAppSinkCallbacks sinkVideoCb;
         sinkVideoCb.new_sample  = cb_show_frame_output;
         sinkVideoCb.eos         = cb_packet_ready_eos_stub;     // TODO
@@ -1331,11 +2221,53 @@ bool RtpWorker::startRecv()
         gst_app_sink_set_callbacks(appVideoSink, &sinkVideoCb, this, nullptr);
 
         gst_bin_add(GST_BIN(recvbin), videortpsrc);
+        if (srtpdec)
+            gst_bin_add(GST_BIN(recvbin), srtpdec);
         gst_bin_add(GST_BIN(recvbin), videodec);
         gst_bin_add(GST_BIN(recvbin), videoconvert);
         gst_bin_add(GST_BIN(recvbin), (GstElement *)appVideoSink);
 
-        gst_element_link_many(videortpsrc, videodec, videoconvert, (GstElement *)appVideoSink, nullptr);
+        if (srtpdec) {
+            gst_element_link_pads(videortpsrc, "src", srtpdec, "rtp_sink");
+            gst_element_link_pads(srtpdec, "rtp_src", videodec, "sink");
+
+            QMutexLocker locker(&srtp_mutex);
+            videosrtpdec = srtpdec;
+        } else
+            gst_element_link(videortpsrc, videodec);
+        gst_element_link_many(videodec, videoconvert, (GstElement *)appVideoSink, nullptr);
+
+        // turn decoder complaints into keyframe requests.  a decoder that
+        //   asks for a sync point does so when a frame can't be decoded, so
+        //   losses that didn't cost a frame don't count.  without that,
+        //   every loss reported by the jitterbuffer has to
+        GstPad *pad = gst_element_get_static_pad(videodec, "sink");
+        gst_pad_add_probe(pad, GST_PAD_PROBE_TYPE_EVENT_UPSTREAM, cb_videodec_event_probe, this, nullptr);
+        gst_object_unref(GST_OBJECT(pad));
+
+        GstElement *decoder = gst_bin_get_by_name(GST_BIN(videodec), "decoder");
+        bool        canAsk
+            = decoder && g_object_class_find_property(G_OBJECT_GET_CLASS(decoder), "automatic-request-sync-points");
+        GstElement *jitterbuffer = canAsk ? nullptr : gst_bin_get_by_name(GST_BIN(videodec), "jitterbuffer");
+        if (jitterbuffer) {
+            pad = gst_element_get_static_pad(jitterbuffer, "src");
+            gst_pad_add_probe(pad, GST_PAD_PROBE_TYPE_EVENT_DOWNSTREAM, cb_videodec_event_probe, this, nullptr);
+            gst_object_unref(GST_OBJECT(pad));
+            gst_object_unref(GST_OBJECT(jitterbuffer));
+        }
+
+        // frame counters: depayloaded frames going into the decoder, and
+        //   decoded frames coming out of the bin
+        if (decoder) {
+            pad = gst_element_get_static_pad(decoder, "sink");
+            gst_pad_add_probe(pad, GST_PAD_PROBE_TYPE_BUFFER, cb_videodec_in_probe, this, nullptr);
+            gst_object_unref(GST_OBJECT(pad));
+            gst_object_unref(GST_OBJECT(decoder));
+        }
+
+        pad = gst_element_get_static_pad(videodec, "src");
+        gst_pad_add_probe(pad, GST_PAD_PROBE_TYPE_BUFFER, cb_videodec_out_probe, this, nullptr);
+        gst_object_unref(GST_OBJECT(pad));
 
         actual_remoteVideoPayloadInfo = remoteVideoPayloadInfo;
     }
@@ -1352,16 +2284,16 @@ bool RtpWorker::startRecv()
         gst_element_link(recvbin, audioout);
     }
 
-    if (shared_clock && send_clock_is_shared) {
-        qDebug("recv pipeline slaving to send clock");
+    if (offline)
+        gst_pipeline_use_clock(GST_PIPELINE(rpipeline), nullptr);
+    else if (shared_clock && send_clock_is_shared) {
+        qCDebug(lcWorker, "recv pipeline slaving to send clock");
         gst_pipeline_use_clock(GST_PIPELINE(rpipeline), shared_clock);
     }
 
     // gst_element_set_locked_state(recvbin, FALSE);
     // gst_element_set_state(recvbin, GST_STATE_PLAYING);
-#ifdef RTPWORKER_DEBUG
-    qDebug("activating");
-#endif
+    qCDebug(lcWorker, "activating");
 
     gst_element_set_state(rpipeline, GST_STATE_READY);
     gst_element_get_state(rpipeline, nullptr, nullptr, GST_CLOCK_TIME_NONE);
@@ -1370,16 +2302,18 @@ bool RtpWorker::startRecv()
 
     /*if(!shared_clock && use_shared_clock)
     {
-        qDebug("recv clock is master");
+        qCDebug(lcWorker, "recv clock is master");
 
         shared_clock = gst_pipeline_get_clock(GST_PIPELINE(rpipeline));
         gst_pipeline_use_clock(GST_PIPELINE(rpipeline), shared_clock);
         recv_clock_is_shared = true;
     }*/
 
-#ifdef RTPWORKER_DEBUG
-    qDebug("receive pipeline started");
-#endif
+    // with file input, progress follows the file instead
+    if (offline && !fileDemux)
+        startOfflineProgress();
+
+    qCDebug(lcWorker, "receive pipeline started");
     return true;
 
 fail1:
@@ -1422,9 +2356,7 @@ bool RtpWorker::addAudioChain(int rate)
     // int rate = localAudioParams[0].sampleRate;
     // int size = localAudioParams[0].sampleSize;
     // int channels = localAudioParams[0].channels;
-#ifdef RTPWORKER_DEBUG
-    qDebug("codec=%s", qPrintable(codec));
-#endif
+    qCDebug(lcWorker, "codec=%s", qPrintable(codec));
 
     // see if we need to match a pt id
     int pt = -1;
@@ -1442,6 +2374,18 @@ bool RtpWorker::addAudioChain(int rate)
     if (!audioenc)
         return false;
 
+    GstElement *srtpenc = nullptr;
+    {
+        QMutexLocker locker(&srtp_mutex);
+        if (!localSrtp.key.isEmpty()) {
+            srtpenc = bins_srtpenc_create(localSrtp);
+            if (!srtpenc) {
+                g_object_unref(G_OBJECT(audioenc));
+                return false;
+            }
+        }
+    }
+
     {
         QMutexLocker locker(&volumein_mutex);
         volumein   = gst_element_factory_make("volume", nullptr);
@@ -1452,12 +2396,12 @@ bool RtpWorker::addAudioChain(int rate)
     GstElement *audiortpsink = gst_element_factory_make("appsink", nullptr);
     GstAppSink *appRtpSink   = reinterpret_cast<GstAppSink *>(audiortpsink);
 
-    if (!fileDemux)
+    if (!fileDemux || offline)
         g_object_set(G_OBJECT(appRtpSink), "sync", FALSE, nullptr);
 
     GstAppSinkCallbacks sinkCb;
     sinkCb.new_sample  = cb_packet_ready_rtp_audio;
-    sinkCb.eos         = cb_packet_ready_eos_stub;     // TODO
+    sinkCb.eos         = cb_packet_ready_eos_rtp;
     sinkCb.new_preroll = cb_packet_ready_preroll_stub; // TODO
     gst_app_sink_set_callbacks(appRtpSink, &sinkCb, this, nullptr);
 
@@ -1470,11 +2414,20 @@ bool RtpWorker::addAudioChain(int rate)
 
     gst_bin_add(GST_BIN(sendbin), volumein);
     gst_bin_add(GST_BIN(sendbin), audioenc);
+    if (srtpenc)
+        gst_bin_add(GST_BIN(sendbin), srtpenc);
     gst_bin_add(GST_BIN(sendbin), audiortpsink);
 
-    gst_element_link_many(volumein, audioenc, audiortpsink, nullptr);
+    if (srtpenc) {
+        gst_element_link_many(volumein, audioenc, srtpenc, audiortpsink, nullptr);
+
+        QMutexLocker locker(&srtp_mutex);
+        audiosrtpenc = srtpenc;
+    } else
+        gst_element_link_many(volumein, audioenc, audiortpsink, nullptr);
 
     audiortppay = audioenc;
+    ++rtpSinks;
 
     if (fileDemux) {
         gst_element_link(queue, volumein);
@@ -1482,6 +2435,8 @@ bool RtpWorker::addAudioChain(int rate)
         gst_element_set_state(queue, GST_STATE_PAUSED);
         gst_element_set_state(volumein, GST_STATE_PAUSED);
         gst_element_set_state(audioenc, GST_STATE_PAUSED);
+        if (srtpenc)
+            gst_element_set_state(srtpenc, GST_STATE_PAUSED);
         gst_element_set_state(audiortpsink, GST_STATE_PAUSED);
 
         gst_element_link(audiosrc, queue);
@@ -1506,9 +2461,7 @@ bool RtpWorker::addVideoChain()
     // QString codec = localVideoParams[0].codec;
     // QSize size = localVideoParams[0].size;
     // int fps = localVideoParams[0].fps;
-#ifdef RTPWORKER_DEBUG
-    qDebug("codec=%s", qPrintable(codec));
-#endif
+    qCDebug(lcWorker, "codec=%s", qPrintable(codec));
 
     // see if we need to match a pt id
     int pt = -1;
@@ -1530,7 +2483,7 @@ bool RtpWorker::addVideoChain()
     if (!videoprep)
         return false;
 #endif
-    GstElement *videoenc = bins_videoenc_create(codec, pt, videokbps);
+    GstElement *videoenc = bins_videoenc_create(codec, pt, videokbps, size, fps, cpuBudget);
     if (!videoenc) {
 #ifdef VIDEO_PREP
         g_object_unref(G_OBJECT(videoprep));
@@ -1538,10 +2491,28 @@ bool RtpWorker::addVideoChain()
         return false;
     }
 
+    GstElement *srtpenc = nullptr;
+    {
+        QMutexLocker locker(&srtp_mutex);
+        if (!localSrtp.key.isEmpty()) {
+            srtpenc = bins_srtpenc_create(localSrtp);
+            if (!srtpenc) {
+#ifdef VIDEO_PREP
+                g_object_unref(G_OBJECT(videoprep));
+#endif
+                g_object_unref(G_OBJECT(videoenc));
+                return false;
+            }
+        }
+    }
+
     GstElement *videotee = gst_element_factory_make("tee", nullptr);
 
+    // the preview is scaled down to the widget size before it is
+    //   converted, see applyPreviewSize()
     GstElement *playqueue        = gst_element_factory_make("queue", nullptr);
-    GstElement *videoconvertplay = gst_element_factory_make("videoconvert", nullptr);
+    GstElement *videoconvertplay = bins_videoconvert_create(true);
+    GstElement *playfilter       = gst_element_factory_make("capsfilter", nullptr);
     GstAppSink *appVideoSink     = makeVideoPlayAppSink("sourcevideoplay");
 
     GstAppSinkCallbacks sinkPreviewCb;
@@ -1550,15 +2521,27 @@ bool RtpWorker::addVideoChain()
     sinkPreviewCb.new_preroll = cb_packet_ready_preroll_stub; // TODO
     gst_app_sink_set_callbacks(appVideoSink, &sinkPreviewCb, this, nullptr);
 
-    GstElement *rtpqueue     = gst_element_factory_make("queue", nullptr);
+    GstElement *rtpqueue     = gst_element_factory_make("queue", "rtpqueue");
     GstElement *videortpsink = gst_element_factory_make("appsink", nullptr); // was apprtpsink
     auto        appRtpSink   = reinterpret_cast<GstAppSink *>(videortpsink);
-    if (!fileDemux)
+    if (!fileDemux) {
+        g_object_set(G_OBJECT(appRtpSink), "sync", FALSE, nullptr);
+
+        // when the encoder falls behind, drop old frames here rather than
+        //   let the backlog delay everything else. leaky=2 is downstream
+        g_object_set(G_OBJECT(rtpqueue), "leaky", 2, "max-size-buffers", 8, "max-size-bytes", 0, "max-size-time",
+                     G_GUINT64_CONSTANT(0), nullptr);
+
+        // lets the preview sink report late frames upstream
+        g_object_set(G_OBJECT(appVideoSink), "qos", TRUE, nullptr);
+    } else if (offline) {
         g_object_set(G_OBJECT(appRtpSink), "sync", FALSE, nullptr);
+        g_object_set(G_OBJECT(appVideoSink), "sync", FALSE, nullptr);
+    }
 
     GstAppSinkCallbacks sinkCb;
     sinkCb.new_sample  = cb_packet_ready_rtp_video;
-    sinkCb.eos         = cb_packet_ready_eos_stub;     // TODO
+    sinkCb.eos         = cb_packet_ready_eos_rtp;
     sinkCb.new_preroll = cb_packet_ready_preroll_stub; // TODO
     gst_app_sink_set_callbacks(appRtpSink, &sinkCb, this, nullptr);
 
@@ -1574,17 +2557,40 @@ bool RtpWorker::addVideoChain()
     gst_bin_add(GST_BIN(sendbin), videotee);
     gst_bin_add(GST_BIN(sendbin), playqueue);
     gst_bin_add(GST_BIN(sendbin), videoconvertplay);
+    gst_bin_add(GST_BIN(sendbin), playfilter);
     gst_bin_add(GST_BIN(sendbin), reinterpret_cast<GstElement *>(appVideoSink));
     gst_bin_add(GST_BIN(sendbin), rtpqueue);
     gst_bin_add(GST_BIN(sendbin), videoenc);
+    if (srtpenc)
+        gst_bin_add(GST_BIN(sendbin), srtpenc);
     gst_bin_add(GST_BIN(sendbin), videortpsink);
 #ifdef VIDEO_PREP
     gst_element_link(videoprep, videotee);
 #endif
-    gst_element_link_many(videotee, playqueue, videoconvertplay, reinterpret_cast<GstElement *>(appVideoSink), nullptr);
-    gst_element_link_many(videotee, rtpqueue, videoenc, videortpsink, nullptr); // FIXME!
+    gst_element_link_many(videotee, playqueue, videoconvertplay, playfilter,
+                          reinterpret_cast<GstElement *>(appVideoSink), nullptr);
+
+    previewfilter     = playfilter;
+    previewSourceSize = size;
+    applyPreviewSize();
+    if (srtpenc) {
+        gst_element_link_many(videotee, rtpqueue, videoenc, srtpenc, videortpsink, nullptr);
+
+        QMutexLocker locker(&srtp_mutex);
+        videosrtpenc = srtpenc;
+    } else
+        gst_element_link_many(videotee, rtpqueue, videoenc, videortpsink, nullptr); // FIXME!
 
     videortppay = videoenc;
+    ++rtpSinks;
+
+    keyframe_mutex.lock();
+    videoencbin = videoenc;
+    keyframe_mutex.unlock();
+
+    videoEncCodec = codec;
+    videoEncSize  = size;
+    videoEncFps   = fps;
 
     if (fileDemux) {
 #ifdef VIDEO_PREP
@@ -1600,9 +2606,12 @@ bool RtpWorker::addVideoChain()
         gst_element_set_state(videotee, GST_STATE_PAUSED);
         gst_element_set_state(playqueue, GST_STATE_PAUSED);
         gst_element_set_state(videoconvertplay, GST_STATE_PAUSED);
+        gst_element_set_state(playfilter, GST_STATE_PAUSED);
         gst_element_set_state(reinterpret_cast<GstElement *>(appVideoSink), GST_STATE_PAUSED);
         gst_element_set_state(rtpqueue, GST_STATE_PAUSED);
         gst_element_set_state(videoenc, GST_STATE_PAUSED);
+        if (srtpenc)
+            gst_element_set_state(srtpenc, GST_STATE_PAUSED);
         gst_element_set_state(videortpsink, GST_STATE_PAUSED);
 
         gst_element_link(videosrc, queue);
@@ -1616,6 +2625,11 @@ bool RtpWorker::addVideoChain()
             sendbin,
             gst_ghost_pad_new_from_template("sink1", pad, gst_static_pad_template_get(&raw_video_sink_template)));
         gst_object_unref(GST_OBJECT(pad));
+
+#ifdef VIDEO_PREP
+        if (qgetenv("PSI_NO_VIDEO_ADAPTATION").isEmpty())
+            startVideoLoadMonitor(videoprep, rtpqueue, videoenc, size, fps);
+#endif
     }
 
     return true;
@@ -1627,18 +2641,16 @@ bool RtpWorker::getCaps()
         GstPad * pad  = gst_element_get_static_pad(audiortppay, "src");
         GstCaps *caps = gst_pad_get_current_caps(pad);
         if (!caps) {
-#ifdef RTPWORKER_DEBUG
-            qDebug("can't get audio caps");
-#endif
+            qCDebug(lcWorker, "can't get audio caps");
             return false;
         }
 
-#ifdef RTPWORKER_DEBUG
-        gchar * gstr       = gst_caps_to_string(caps);
-        QString capsString = QString::fromUtf8(gstr);
-        g_free(gstr);
-        qDebug("rtppay caps audio: [%s]", qPrintable(capsString));
-#endif
+        if (lcWorker().isDebugEnabled()) {
+            gchar * gstr       = gst_caps_to_string(caps);
+            QString capsString = QString::fromUtf8(gstr);
+            g_free(gstr);
+            qCDebug(lcWorker, "rtppay caps audio: [%s]", qPrintable(capsString));
+        }
 
         gst_object_unref(pad);
 
@@ -1660,18 +2672,16 @@ bool RtpWorker::getCaps()
         GstPad * pad  = gst_element_get_static_pad(videortppay, "src");
         GstCaps *caps = gst_pad_get_current_caps(pad);
         if (!caps) {
-#ifdef RTPWORKER_DEBUG
-            qWarning("can't get video caps");
-#endif
+            qCWarning(lcWorker, "can't get video caps");
             return false;
         }
 
-#ifdef RTPWORKER_DEBUG
-        gchar * gstr       = gst_caps_to_string(caps);
-        QString capsString = QString::fromUtf8(gstr);
-        g_free(gstr);
-        qDebug("rtppay caps video: [%s]", qPrintable(capsString));
-#endif
+        if (lcWorker().isDebugEnabled()) {
+            gchar * gstr       = gst_caps_to_string(caps);
+            QString capsString = QString::fromUtf8(gstr);
+            g_free(gstr);
+            qCDebug(lcWorker, "rtppay caps video: [%s]", qPrintable(capsString));
+        }
 
         gst_object_unref(pad);
 
@@ -1713,15 +2723,20 @@ bool RtpWorker::updateTheoraConfig()
             && ri.id == actual_remoteVideoPayloadInfo[theora_at].id) {
             GstStructure *cs = payloadInfoToStructure(remoteVideoPayloadInfo[n], "video");
             if (!cs) {
-#ifdef RTPWORKER_DEBUG
-                qDebug("cannot parse payload info");
-#endif
+                qCDebug(lcWorker, "cannot parse payload info");
                 continue;
             }
 
             QMutexLocker locker(&videortpsrc_mutex);
-            if (!videortpsrc)
+            if (!videortpsrc) {
+                gst_structure_free(cs);
                 continue;
+            }
+
+            srtp_mutex.lock();
+            if (videosrtpdec)
+                gst_structure_set_name(cs, "application/x-srtp");
+            srtp_mutex.unlock();
 
             GstCaps *caps = gst_caps_new_empty();
 
@@ -1748,13 +2763,14 @@ RtpWorker::Frame RtpWorker::Frame::pullFromSink(GstAppSink *appsink)
     /*
     gchar *capsstr;
     capsstr = gst_caps_to_string(caps);
-    qDebug("recv video frame caps: %s", capsstr);
+    qCDebug(lcWorker, "recv video frame caps: %s", capsstr);
     g_free (capsstr);
 */
 
     GstStructure *capsStruct = gst_caps_get_structure(caps, 0);
     gst_structure_get_int(capsStruct, "width", &width);
     gst_structure_get_int(capsStruct, "height", &height);
+    frame.pts = GST_BUFFER_PTS(buffer);
 
     if (gsize(width * height * 4) == gst_buffer_get_size(buffer)) {
         QImage image(width, height, QImage::Format_RGB32);
@@ -1765,10 +2781,11 @@ RtpWorker::Frame RtpWorker::Frame::pullFromSink(GstAppSink *appsink)
 #endif
         frame.image = image;
     } else {
-        qDebug("wrong size of received buffer: %x != %lx", (width * height * 4), gst_buffer_get_size(buffer));
+        qCWarning(lcWorker, "wrong size of received buffer: %x != %lx", (width * height * 4),
+                  gst_buffer_get_size(buffer));
         gchar *capsstr;
         capsstr = gst_caps_to_string(caps);
-        qDebug("recv video frame caps: %s", capsstr);
+        qCWarning(lcWorker, "recv video frame caps: %s", capsstr);
         g_free(capsstr);
     }
     gst_sample_unref(sample);
@@ -21,10 +21,14 @@
 #ifndef RTPWORKER_H
 #define RTPWORKER_H
 
+#include "latencytracer.h"
 #include "psimediaprovider.h"
+#include "streamcounters.h"
+#include <QAtomicInt>
 #include <QByteArray>
 #include <QImage>
 #include <QMutex>
+#include <QPair>
 #include <QString>
 #include <gst/app/gstappsink.h>
 #include <gst/gst.h>
@@ -33,8 +37,6 @@ namespace PsiMedia {
 
 class PipelineDeviceContext;
 
-class Stats;
-
 // Note: do not destruct this class during one of its callbacks
 class RtpWorker {
 public:
@@ -42,7 +44,8 @@ public:
     //   such as a timestamp
     class Frame {
     public:
-        QImage image;
+        QImage       image;
+        GstClockTime pts = GST_CLOCK_TIME_NONE;
 
         static Frame pullFromSink(GstAppSink *appsink);
     };
@@ -55,6 +58,7 @@ public:
     QString             infile;
     QByteArray          indata;
     bool                loopFile = false;
+    bool                offline  = false; // see RwControlConfigDevices
     QList<PAudioParams> localAudioParams;
     QList<PVideoParams> localVideoParams;
     QList<PPayloadInfo> localAudioPayloadInfo;
@@ -62,6 +66,7 @@ public:
     QList<PPayloadInfo> remoteAudioPayloadInfo;
     QList<PPayloadInfo> remoteVideoPayloadInfo;
     int                 maxbitrate = 0;
+    int                 cpuBudget  = -1; // percent of all cores for video encoding, see setCpuBudget()
 
     // read-only
     bool canTransmitAudio;
@@ -88,12 +93,46 @@ public:
     void rtpAudioIn(const PRtpPacket &packet);
     void rtpVideoIn(const PRtpPacket &packet);
 
+    // safe to call from any thread. displayed counts frames passed to
+    //   cb_outputFrame
+    PVideoOutputStats videoOutputStats() const;
+
+    // safe to call from any thread
+    PStreamMetrics audioStreamMetrics() const;
+    PStreamMetrics videoStreamMetrics() const;
+
+    // asks the local video encoder for a keyframe.  safe to call from any
+    //   thread, requests too close to the previous one are dropped
+    void requestKeyframe();
+
+    // per stage latency of the running streams, see LatencyTracer, followed
+    //   by the glass-to-glass latency of the received ones, see
+    //   GlassToGlassTracer.  tracing is also enabled from the start by
+    //   PSI_LATENCY_TRACE.  call setLatencyTracing from the worker thread
+    //   only, it resets the results
+    void                 setLatencyTracing(bool enabled);
+    QList<PLatencyStage> latencyStages() const;
+
     void setOutputVolume(int level);
     void setInputVolume(int level);
 
+    // the local preview is scaled down to fit in this size before it is
+    //   converted for display.  invalid or empty for the full picture.
+    //   call from the worker thread only
+    void setPreviewSize(const QSize &size);
+
+    // retunes a running video encoder to the new budget.  call from the
+    //   worker thread only
+    void setCpuBudget(int percent);
+
+    // takes effect on start, and rekeys the srtp elements if already running
+    void setSrtpParameters(const PSrtpParams &local, const PSrtpParams &remote);
+
     void recordStart();
     void recordStop();
     void dumpPipeline(std::function<void(const QStringList &)>);
+    // "send" and "receive" keys, see pipeline_snapshot()
+    void pipelineSnapshot(std::function<void(const QVariantMap &)>);
 
     // callbacks
 
@@ -105,6 +144,13 @@ public:
     void (*cb_audioOutputIntensity)(int value, void *app);
     void (*cb_audioInputIntensity)(int value, void *app);
 
+    // sent video was stepped down or back up because of cpu load
+    void (*cb_videoAdaptation)(const QSize &size, int fps, bool degraded, void *app);
+
+    // offline progress in ms, -1 where unknown.  the last one comes right
+    //   before cb_finished
+    void (*cb_offlineProgress)(qint64 position, qint64 duration, qint64 remaining, void *app);
+
     // callbacks - from alternate thread, be safe!
     //   also, it is not safe to assign callbacks except before starting
 
@@ -119,27 +165,104 @@ public:
 private:
     GMainContext *mainContext_ = nullptr;
     GSource *     timer        = nullptr;
+    GSource *     loadTimer    = nullptr;
+    GSource *     offlineTimer = nullptr;
 
     PipelineDeviceContext *pd_audiosrc = nullptr, *pd_videosrc = nullptr, *pd_audiosink = nullptr;
     GstElement *           sendbin = nullptr, *recvbin = nullptr;
 
-    GstElement *fileDemux   = nullptr;
-    GstElement *audiosrc    = nullptr;
-    GstElement *videosrc    = nullptr;
-    GstElement *audiortpsrc = nullptr;
-    GstElement *videortpsrc = nullptr;
-    GstElement *audiortppay = nullptr;
-    GstElement *videortppay = nullptr;
-    GstElement *volumein    = nullptr;
-    GstElement *volumeout   = nullptr;
-    bool        rtpaudioout = false;
-    bool        rtpvideoout = false;
+    GstElement *fileDemux    = nullptr;
+    GstElement *audiosrc     = nullptr;
+    GstElement *videosrc     = nullptr;
+    GstElement *audiortpsrc  = nullptr;
+    GstElement *videortpsrc  = nullptr;
+    GstElement *audiortppay  = nullptr;
+    GstElement *videortppay  = nullptr;
+    GstElement *volumein     = nullptr;
+    GstElement *volumeout    = nullptr;
+    GstElement *audiosrtpenc = nullptr;
+    GstElement *videosrtpenc = nullptr;
+    GstElement *audiosrtpdec = nullptr;
+    GstElement *videosrtpdec = nullptr;
+    bool        rtpaudioout  = false;
+    bool        rtpvideoout  = false;
     QMutex      audiortpsrc_mutex;
     QMutex      videortpsrc_mutex;
     QMutex      volumein_mutex;
     QMutex      volumeout_mutex;
     QMutex      rtpaudioout_mutex;
     QMutex      rtpvideoout_mutex;
+    QMutex      srtp_mutex;
+    PSrtpParams localSrtp;
+    PSrtpParams remoteSrtp;
+
+    // keyframe requests in both directions.  the ssrcs are guarded by
+    //   videortpsrc_mutex (remote) and rtpvideoout_mutex (local)
+    QMutex      keyframe_mutex;
+    GstElement *videoencbin     = nullptr;
+    gint64      lastKeyframe    = 0; // monotonic time we last forced one
+    gint64      lastPli         = 0; // monotonic time we last asked the remote
+    quint32     remoteVideoSsrc = 0;
+    quint32     localVideoSsrc  = 0;
+
+    // receive side video frame counters
+    QAtomicInt videoFramesIn;
+    QAtomicInt videoFramesDecoded;
+    QAtomicInt videoFramesShown;
+
+    StreamCounters audioMetrics { false };
+    StreamCounters videoMetrics { true };
+
+    // decode timing, only touched from the decoder's streaming thread
+    QList<QPair<GstClockTime, gint64>> decodeStarts; // pts, monotonic time
+    QAtomicInt                         decodeTime;   // smoothed, in us
+
+    // local preview scaling, see setPreviewSize()
+    GstElement *previewfilter = nullptr;
+    QSize       previewSize;
+    QSize       previewSourceSize;
+
+    // what the video encoder is tuned for, see retuneVideoEncoder()
+    QString videoEncCodec;
+    QSize   videoEncSize;
+    int     videoEncFps = 0;
+
+    // video overload monitor state, see checkVideoLoad()
+    GstElement *videoprepbin   = nullptr;
+    GstElement *videortpqueue  = nullptr;
+    QSize       videoBaseSize;
+    int         videoBaseFps   = 0;
+    int         videoLevel     = 0;
+    int         overloadTicks  = 0;
+    int         underloadTicks = 0;
+
+    mutable QMutex                     videoload_mutex;
+    QList<QPair<GstClockTime, gint64>> encodeStarts;   // pts, monotonic time
+    gint64                             encodeTime = 0; // smoothed, in us
+    int                                qosEvents  = 0;
+
+    // offline mode.  the received rtp is timestamped from its own rtp
+    //   timestamps, as nothing else is left to pace it.  both streams
+    //   share the session timeline: the first packet of the session is at
+    //   zero, and a stream starting later picks up where the session is at
+    //   its first packet.  the clocks are guarded by the rtpsrc mutexes
+    class MediaClock {
+    public:
+        int     clockRate = 0;
+        bool    started   = false;
+        quint32 last      = 0;
+        qint64  ticks     = 0; // since the first packet
+        qint64  base      = 0; // ns, session time of the first packet
+
+        GstClockTime stamp(const QByteArray &rtp, qint64 sessionTime);
+    };
+
+    MediaClock             audioInClock;
+    MediaClock             videoInClock;
+    QAtomicInteger<qint64> receivedTime;  // ns, furthest of both streams
+    QAtomicInt             rtpSinksAtEos; // file input played out
+    int                    rtpSinks     = 0;
+    gint64                 offlineStart = 0; // monotonic time
 
     // GSource *recordTimer;
 
@@ -148,25 +271,43 @@ private:
     QList<PPayloadInfo> actual_remoteAudioPayloadInfo;
     QList<PPayloadInfo> actual_remoteVideoPayloadInfo;
 
-    Stats *audioStats = nullptr;
-    Stats *videoStats = nullptr;
+    // tags for the latency stages that end in the appsink callbacks
+    enum LatencyMark { AudioHandoffMark, VideoHandoffMark, VideoSinkMark };
+
+    LatencyTracer      latencyTracer;
+    GlassToGlassTracer glassTracer;
+    bool               latencyTracing = false;
+
+    friend class MicroBench; // bench/microbench.cpp
 
     void cleanup();
 
-    static gboolean      cb_doStart(gpointer data);
-    static gboolean      cb_doUpdate(gpointer data);
-    static gboolean      cb_doStop(gpointer data);
-    static void          cb_fileDemux_no_more_pads(GstElement *element, gpointer data);
-    static void          cb_fileDemux_pad_added(GstElement *element, GstPad *pad, gpointer data);
-    static void          cb_fileDemux_pad_removed(GstElement *element, GstPad *pad, gpointer data);
-    static gboolean      cb_bus_call(GstBus *bus, GstMessage *msg, gpointer data);
-    static GstFlowReturn cb_show_frame_preview(GstAppSink *appsink, gpointer data);
-    static GstFlowReturn cb_show_frame_output(GstAppSink *appsink, gpointer data);
-    static GstFlowReturn cb_packet_ready_rtp_audio(GstAppSink *appsink, gpointer data);
-    static GstFlowReturn cb_packet_ready_rtp_video(GstAppSink *appsink, gpointer data);
-    static GstFlowReturn cb_packet_ready_preroll_stub(GstAppSink *appsink, gpointer data);
-    static void          cb_packet_ready_eos_stub(GstAppSink *appsink, gpointer data);
-    static gboolean      cb_fileReady(gpointer data);
+    static GstBuffer *makeGstBuffer(const PRtpPacket &packet);
+
+    static gboolean          cb_doStart(gpointer data);
+    static gboolean          cb_doUpdate(gpointer data);
+    static gboolean          cb_doStop(gpointer data);
+    static void              cb_fileDemux_no_more_pads(GstElement *element, gpointer data);
+    static void              cb_fileDemux_pad_added(GstElement *element, GstPad *pad, gpointer data);
+    static void              cb_fileDemux_pad_removed(GstElement *element, GstPad *pad, gpointer data);
+    static gboolean          cb_bus_call(GstBus *bus, GstMessage *msg, gpointer data);
+    static GstFlowReturn     cb_show_frame_preview(GstAppSink *appsink, gpointer data);
+    static GstFlowReturn     cb_show_frame_output(GstAppSink *appsink, gpointer data);
+    static GstFlowReturn     cb_packet_ready_rtp_audio(GstAppSink *appsink, gpointer data);
+    static GstFlowReturn     cb_packet_ready_rtp_video(GstAppSink *appsink, gpointer data);
+    static GstFlowReturn     cb_packet_ready_preroll_stub(GstAppSink *appsink, gpointer data);
+    static void              cb_packet_ready_eos_stub(GstAppSink *appsink, gpointer data);
+    static void              cb_packet_ready_eos_rtp(GstAppSink *appsink, gpointer data);
+    static gboolean          cb_fileReady(gpointer data);
+    static GstCaps *         cb_srtpdec_request_key(GstElement *element, guint ssrc, gpointer data);
+    static gboolean          cb_checkVideoLoad(gpointer data);
+    static gboolean          cb_checkOfflineProgress(gpointer data);
+    static GstPadProbeReturn cb_videoenc_in_probe(GstPad *pad, GstPadProbeInfo *info, gpointer data);
+    static GstPadProbeReturn cb_videoenc_out_probe(GstPad *pad, GstPadProbeInfo *info, gpointer data);
+    static GstPadProbeReturn cb_videoenc_qos_probe(GstPad *pad, GstPadProbeInfo *info, gpointer data);
+    static GstPadProbeReturn cb_videodec_event_probe(GstPad *pad, GstPadProbeInfo *info, gpointer data);
+    static GstPadProbeReturn cb_videodec_in_probe(GstPad *pad, GstPadProbeInfo *info, gpointer data);
+    static GstPadProbeReturn cb_videodec_out_probe(GstPad *pad, GstPadProbeInfo *info, gpointer data);
 
     gboolean      doStart();
     gboolean      doUpdate();
@@ -180,6 +321,15 @@ private:
     GstFlowReturn packet_ready_rtp_audio(GstAppSink *appsink);
     GstFlowReturn packet_ready_rtp_video(GstAppSink *appsink);
     gboolean      fileReady();
+    GstCaps *     srtpdec_request_key(GstElement *element, guint ssrc);
+    gboolean      checkVideoLoad();
+    gboolean      checkOfflineProgress();
+    void          videodec_in(GstBuffer *buffer);
+    void          videodec_out(GstBuffer *buffer);
+    void          videoenc_in(GstBuffer *buffer);
+    void          videoenc_out(GstBuffer *buffer);
+    void          videoenc_qos();
+    void          videodec_event(GstEvent *event);
 
     bool        setupSendRecv();
     bool        startSend();
@@ -191,6 +341,17 @@ private:
     bool        getCaps();
     bool        updateTheoraConfig();
     GstAppSink *makeVideoPlayAppSink(const gchar *name);
+    GstElement *makeSrtpDecoder();
+    void        startVideoLoadMonitor(GstElement *prep, GstElement *queue, GstElement *enc, const QSize &size, int fps);
+    void        setVideoLevel(int level);
+    void        applyPreviewSize();
+    void        retuneVideoEncoder();
+    void        startOfflineProgress();
+    void        pushRtp(QMutexLocker *locker, GstElement *appsrc, MediaClock *clock, const PRtpPacket &packet);
+    void        videoRtcpIn(const QByteArray &buf);
+    void        sendPictureLossIndication();
+    void        traceSendLatency();
+    void        traceRecvLatency();
 };
 
 }
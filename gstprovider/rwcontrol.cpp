@@ -20,7 +20,9 @@
 
 #include "rwcontrol.h"
 
+#include "eventrecorder.h"
 #include "gstthread.h"
+#include "logging.h"
 #include "rtpworker.h"
 #include <QPointer>
 
@@ -65,6 +67,14 @@ static RwControlFrameMessage *getLatestFrameAndRemoveOthers(QList<RwControlMessa
     return fmsg;
 }
 
+static RwControlFrameMessage *takeFirstFrame(QList<RwControlMessage *> *list, RwControlFrame::Type type)
+{
+    int firstPos = -1;
+    if (!queuedFrameInfo(*list, type, &firstPos))
+        return nullptr;
+    return static_cast<RwControlFrameMessage *>(list->takeAt(firstPos));
+}
+
 static RwControlAudioIntensityMessage *getLatestAudioIntensityAndRemoveOthers(QList<RwControlMessage *> *   list,
                                                                               RwControlAudioIntensity::Type type)
 {
@@ -122,8 +132,10 @@ static void applyDevicesToWorker(RtpWorker *worker, const RwControlConfigDevices
     worker->infile   = devices.fileNameIn;
     worker->indata   = devices.fileDataIn;
     worker->loopFile = devices.loopFile;
+    worker->offline  = devices.offline;
     worker->setOutputVolume(devices.audioOutVolume);
     worker->setInputVolume(devices.audioInVolume);
+    worker->setPreviewSize(devices.previewSize);
 }
 
 static void applyCodecsToWorker(RtpWorker *worker, const RwControlConfigCodecs &codecs)
@@ -138,6 +150,8 @@ static void applyCodecsToWorker(RtpWorker *worker, const RwControlConfigCodecs &
         worker->remoteVideoPayloadInfo = codecs.remoteVideoPayloadInfo;
 
     worker->maxbitrate = codecs.maximumSendingBitrate;
+    worker->setCpuBudget(codecs.videoEncodingCpuBudget);
+    worker->setSrtpParameters(codecs.localSrtp, codecs.remoteSrtp);
 }
 
 //----------------------------------------------------------------------------
@@ -160,6 +174,12 @@ RwControlLocal::RwControlLocal(GstMainLoop *thread, QObject *parent) :
 
 RwControlLocal::~RwControlLocal()
 {
+    // a frame waiting for room would hold up the pipeline shutdown below
+    in_mutex.lock();
+    closing = true;
+    in_taken.wakeAll();
+    in_mutex.unlock();
+
     // delete RwControlRemote, block until done
     QMutexLocker locker(&m);
     timer = g_timeout_source_new(0);
@@ -172,6 +192,10 @@ RwControlLocal::~RwControlLocal()
 
 void RwControlLocal::start(const RwControlConfigDevices &devices, const RwControlConfigCodecs &codecs)
 {
+    in_mutex.lock();
+    offline = devices.offline;
+    in_mutex.unlock();
+
     auto msg     = new RwControlStartMessage;
     msg->devices = devices;
     msg->codecs  = codecs;
@@ -191,6 +215,13 @@ void RwControlLocal::dumpPipeline(std::function<void(const QStringList &)> callb
     remote_->postMessage(msg);
 }
 
+void RwControlLocal::pipelineSnapshot(std::function<void(const QVariantMap &)> callback)
+{
+    auto msg      = new RwControlPipelineSnapshotMessage;
+    msg->callback = callback;
+    remote_->postMessage(msg);
+}
+
 void RwControlLocal::updateDevices(const RwControlConfigDevices &devices)
 {
     auto msg     = new RwControlUpdateDevicesMessage;
@@ -219,10 +250,42 @@ void RwControlLocal::setRecord(const RwControlRecord &record)
     remote_->postMessage(msg);
 }
 
+void RwControlLocal::updateSrtp(const PSrtpParams &local, const PSrtpParams &remote)
+{
+    auto msg    = new RwControlUpdateSrtpMessage;
+    msg->local  = local;
+    msg->remote = remote;
+    remote_->postMessage(msg);
+}
+
+void RwControlLocal::setPreviewSize(const QSize &size)
+{
+    auto msg  = new RwControlPreviewSizeMessage;
+    msg->size = size;
+    remote_->postMessage(msg);
+}
+
+void RwControlLocal::setLatencyTracing(bool enabled)
+{
+    auto msg     = new RwControlLatencyTracingMessage;
+    msg->enabled = enabled;
+    remote_->postMessage(msg);
+}
+
 void RwControlLocal::rtpAudioIn(const PRtpPacket &packet) { remote_->rtpAudioIn(packet); }
 
 void RwControlLocal::rtpVideoIn(const PRtpPacket &packet) { remote_->rtpVideoIn(packet); }
 
+void RwControlLocal::requestKeyframe() { remote_->requestKeyframe(); }
+
+PVideoOutputStats RwControlLocal::videoOutputStats() const { return remote_->videoOutputStats(); }
+
+PStreamMetrics RwControlLocal::audioStreamMetrics() const { return remote_->audioStreamMetrics(); }
+
+PStreamMetrics RwControlLocal::videoStreamMetrics() const { return remote_->videoStreamMetrics(); }
+
+QList<PLatencyStage> RwControlLocal::latencyStages() const { return remote_->latencyStages(); }
+
 // note: this is executed in the remote thread
 gboolean RwControlLocal::cb_doCreateRemote(gpointer data)
 {
@@ -262,8 +325,12 @@ void RwControlLocal::processMessages()
     wake_pending                   = false;
     QList<RwControlMessage *> list = in;
     in.clear();
+    bool showAll = offline;
+    in_taken.wakeAll();
     in_mutex.unlock();
 
+    EventRecorder::record("rwcontrol", "local process", EventRecorder::Instant, list.count());
+
     QPointer<QObject> self = this;
 
     // we only care about the latest preview frame
@@ -279,9 +346,10 @@ void RwControlLocal::processMessages()
         }
     }
 
-    // we only care about the latest output frame
-    fmsg = getLatestFrameAndRemoveOthers(&list, RwControlFrame::Output);
-    if (fmsg) {
+    // we only care about the latest output frame, except offline where
+    //   each of them is shown in turn
+    while ((fmsg = showAll ? takeFirstFrame(&list, RwControlFrame::Output)
+                           : getLatestFrameAndRemoveOthers(&list, RwControlFrame::Output))) {
         QImage i = fmsg->frame.image;
         delete fmsg;
         emit outputFrame(i);
@@ -289,6 +357,8 @@ void RwControlLocal::processMessages()
             qDeleteAll(list);
             return;
         }
+        if (!showAll)
+            break;
     }
 
     // we only care about the latest audio output intensity
@@ -328,6 +398,24 @@ void RwControlLocal::processMessages()
                 qDeleteAll(list);
                 return;
             }
+        } else if (msg->type == RwControlMessage::VideoAdaptation) {
+            auto                     vmsg       = static_cast<RwControlVideoAdaptationMessage *>(msg);
+            RwControlVideoAdaptation adaptation = vmsg->adaptation;
+            delete vmsg;
+            emit videoAdaptationChanged(adaptation.size, adaptation.fps, adaptation.degraded);
+            if (!self) {
+                qDeleteAll(list);
+                return;
+            }
+        } else if (msg->type == RwControlMessage::OfflineProgress) {
+            auto                     pmsg     = static_cast<RwControlOfflineProgressMessage *>(msg);
+            RwControlOfflineProgress progress = pmsg->progress;
+            delete pmsg;
+            emit offlineProgress(progress.position, progress.duration, progress.remaining);
+            if (!self) {
+                qDeleteAll(list);
+                return;
+            }
         } else
             delete msg;
     }
@@ -336,15 +424,26 @@ void RwControlLocal::processMessages()
 // note: this may be called from the remote thread
 void RwControlLocal::postMessage(RwControlMessage *msg)
 {
+    EventRecorder::record("rwcontrol", "post to local", EventRecorder::Instant, msg->type);
+
     QMutexLocker locker(&in_mutex);
 
     // if this is a frame, and the queue is maxed, then bump off the
-    //   oldest frame to make room
+    //   oldest frame to make room.  offline, output frames rather wait for
+    //   the ui to catch up, which holds up the streaming thread and so
+    //   the rest of the pipeline
     if (msg->type == RwControlMessage::Frame) {
         auto fmsg     = static_cast<RwControlFrameMessage *>(msg);
         int  firstPos = -1;
-        if (queuedFrameInfo(in, fmsg->frame.type, &firstPos) >= QUEUE_FRAME_MAX)
+        if (offline && fmsg->frame.type == RwControlFrame::Output) {
+            while (!closing && queuedFrameInfo(in, fmsg->frame.type, &firstPos) >= QUEUE_FRAME_MAX)
+                in_taken.wait(&in_mutex);
+        } else if (queuedFrameInfo(in, fmsg->frame.type, &firstPos) >= QUEUE_FRAME_MAX) {
+            qCDebug(lcRwControl, "frame queue full, dropping the oldest %s frame",
+                    fmsg->frame.type == RwControlFrame::Preview ? "preview" : "output");
+            EventRecorder::record("rwcontrol", "drop frame", EventRecorder::Instant, fmsg->frame.type);
             in.removeAt(firstPos);
+        }
     }
 
     in += msg;
@@ -371,6 +470,8 @@ RwControlRemote::RwControlRemote(GMainContext *mainContext, RwControlLocal *loca
     worker->cb_error                = cb_worker_error;
     worker->cb_audioOutputIntensity = cb_worker_audioOutputIntensity;
     worker->cb_audioInputIntensity  = cb_worker_audioInputIntensity;
+    worker->cb_videoAdaptation      = cb_worker_videoAdaptation;
+    worker->cb_offlineProgress      = cb_worker_offlineProgress;
     worker->cb_previewFrame         = cb_worker_previewFrame;
     worker->cb_outputFrame          = cb_worker_outputFrame;
     worker->cb_rtpAudioOut          = cb_worker_rtpAudioOut;
@@ -410,6 +511,16 @@ void RwControlRemote::cb_worker_audioInputIntensity(int value, void *app)
     static_cast<RwControlRemote *>(app)->worker_audioInputIntensity(value);
 }
 
+void RwControlRemote::cb_worker_videoAdaptation(const QSize &size, int fps, bool degraded, void *app)
+{
+    static_cast<RwControlRemote *>(app)->worker_videoAdaptation(size, fps, degraded);
+}
+
+void RwControlRemote::cb_worker_offlineProgress(qint64 position, qint64 duration, qint64 remaining, void *app)
+{
+    static_cast<RwControlRemote *>(app)->worker_offlineProgress(position, duration, remaining);
+}
+
 void RwControlRemote::cb_worker_previewFrame(const RtpWorker::Frame &frame, void *app)
 {
     static_cast<RwControlRemote *>(app)->worker_previewFrame(frame);
@@ -476,6 +587,9 @@ gboolean RwControlRemote::processMessages()
 
 bool RwControlRemote::processMessage(RwControlMessage *msg)
 {
+    qCDebug(lcRwControl, "processing message type %d", int(msg->type));
+    EventRecorder::record("rwcontrol", "remote process", EventRecorder::Instant, msg->type);
+
     if (msg->type == RwControlMessage::Start) {
         auto smsg = static_cast<RwControlStartMessage *>(msg);
 
@@ -540,6 +654,18 @@ bool RwControlRemote::processMessage(RwControlMessage *msg)
     } else if (msg->type == RwControlMessage::DumpPileline) {
         auto rmsg = static_cast<RwControlDumpPipelineMessage *>(msg);
         worker->dumpPipeline(rmsg->callback);
+    } else if (msg->type == RwControlMessage::PipelineSnapshot) {
+        auto rmsg = static_cast<RwControlPipelineSnapshotMessage *>(msg);
+        worker->pipelineSnapshot(rmsg->callback);
+    } else if (msg->type == RwControlMessage::UpdateSrtp) {
+        auto smsg = static_cast<RwControlUpdateSrtpMessage *>(msg);
+        worker->setSrtpParameters(smsg->local, smsg->remote);
+    } else if (msg->type == RwControlMessage::PreviewSize) {
+        auto pmsg = static_cast<RwControlPreviewSizeMessage *>(msg);
+        worker->setPreviewSize(pmsg->size);
+    } else if (msg->type == RwControlMessage::LatencyTracing) {
+        auto lmsg = static_cast<RwControlLatencyTracingMessage *>(msg);
+        worker->setLatencyTracing(lmsg->enabled);
     }
 
     return true;
@@ -604,6 +730,24 @@ void RwControlRemote::worker_audioInputIntensity(int value)
     local_->postMessage(msg);
 }
 
+void RwControlRemote::worker_videoAdaptation(const QSize &size, int fps, bool degraded)
+{
+    auto msg                 = new RwControlVideoAdaptationMessage;
+    msg->adaptation.size     = size;
+    msg->adaptation.fps      = fps;
+    msg->adaptation.degraded = degraded;
+    local_->postMessage(msg);
+}
+
+void RwControlRemote::worker_offlineProgress(qint64 position, qint64 duration, qint64 remaining)
+{
+    auto msg                = new RwControlOfflineProgressMessage;
+    msg->progress.position  = position;
+    msg->progress.duration  = duration;
+    msg->progress.remaining = remaining;
+    local_->postMessage(msg);
+}
+
 void RwControlRemote::worker_previewFrame(const RtpWorker::Frame &frame)
 {
     auto msg         = new RwControlFrameMessage;
@@ -654,6 +798,8 @@ void RwControlRemote::resumeMessages()
 // note: this may be called from the local thread
 void RwControlRemote::postMessage(RwControlMessage *msg)
 {
+    EventRecorder::record("rwcontrol", "post to remote", EventRecorder::Instant, msg->type);
+
     QMutexLocker locker(&m);
 
     // if a stop message is sent, unblock so that it can get processed.
@@ -679,4 +825,14 @@ void RwControlRemote::rtpAudioIn(const PRtpPacket &packet) { worker->rtpAudioIn(
 // note: this may be called from the local thread
 void RwControlRemote::rtpVideoIn(const PRtpPacket &packet) { worker->rtpVideoIn(packet); }
 
+void RwControlRemote::requestKeyframe() { worker->requestKeyframe(); }
+
+PVideoOutputStats RwControlRemote::videoOutputStats() const { return worker->videoOutputStats(); }
+
+PStreamMetrics RwControlRemote::audioStreamMetrics() const { return worker->audioStreamMetrics(); }
+
+PStreamMetrics RwControlRemote::videoStreamMetrics() const { return worker->videoStreamMetrics(); }
+
+QList<PLatencyStage> RwControlRemote::latencyStages() const { return worker->latencyStages(); }
+
 }
@@ -63,6 +63,8 @@ namespace PsiMedia {
 //
 // - Transmit/pause the audio/video streams.  This is fire and forget.
 //
+// - Update srtp keys of a running session.  This is fire and forget.
+//
 // - Start/stop recording a session.  For starting, this is somewhat fire
 //   and forget.  You'll eventually start receiving data packets, but the
 //   assumption is that recording is occurring even before the first packet
@@ -90,13 +92,16 @@ public:
     QString    fileNameIn;
     QByteArray fileDataIn;
     bool       loopFile;
+    bool       offline; // run without a clock, as fast as the input allows
     bool       useVideoPreview;
     bool       useVideoOut;
     int        audioOutVolume;
     int        audioInVolume;
+    QSize      previewSize;
 
     RwControlConfigDevices() :
-        loopFile(false), useVideoPreview(false), useVideoOut(false), audioOutVolume(-1), audioInVolume(-1)
+        loopFile(false), offline(false), useVideoPreview(false), useVideoOut(false), audioOutVolume(-1),
+        audioInVolume(-1)
     {
     }
 };
@@ -114,10 +119,14 @@ public:
     QList<PPayloadInfo> remoteVideoPayloadInfo;
 
     int maximumSendingBitrate;
+    int videoEncodingCpuBudget;
+
+    PSrtpParams localSrtp;
+    PSrtpParams remoteSrtp;
 
     RwControlConfigCodecs() :
         useLocalAudioParams(false), useLocalVideoParams(false), useRemoteAudioPayloadInfo(false),
-        useRemoteVideoPayloadInfo(false), maximumSendingBitrate(-1)
+        useRemoteVideoPayloadInfo(false), maximumSendingBitrate(-1), videoEncodingCpuBudget(-1)
     {
     }
 };
@@ -171,6 +180,26 @@ public:
     RwControlAudioIntensity() : type((Type)-1), value(-1) { }
 };
 
+// always remote -> local
+class RwControlVideoAdaptation {
+public:
+    QSize size;
+    int   fps;
+    bool  degraded;
+
+    RwControlVideoAdaptation() : fps(-1), degraded(false) { }
+};
+
+// always remote -> local. in ms, -1 where unknown
+class RwControlOfflineProgress {
+public:
+    qint64 position;
+    qint64 duration;
+    qint64 remaining;
+
+    RwControlOfflineProgress() : position(-1), duration(-1), remaining(-1) { }
+};
+
 // always remote -> local, for internal use
 class RwControlFrame {
 public:
@@ -193,7 +222,13 @@ public:
         Status,
         AudioIntensity,
         Frame,
-        DumpPileline
+        DumpPileline,
+        UpdateSrtp,
+        VideoAdaptation,
+        PreviewSize,
+        PipelineSnapshot,
+        LatencyTracing,
+        OfflineProgress
     };
 
     Type type;
@@ -223,6 +258,13 @@ public:
     std::function<void(const QStringList &)> callback;
 };
 
+class RwControlPipelineSnapshotMessage : public RwControlMessage {
+public:
+    RwControlPipelineSnapshotMessage() : RwControlMessage(RwControlMessage::PipelineSnapshot) { }
+
+    std::function<void(const QVariantMap &)> callback;
+};
+
 class RwControlUpdateDevicesMessage : public RwControlMessage {
 public:
     RwControlConfigDevices devices;
@@ -237,6 +279,28 @@ public:
     RwControlUpdateCodecsMessage() : RwControlMessage(RwControlMessage::UpdateCodecs) { }
 };
 
+class RwControlUpdateSrtpMessage : public RwControlMessage {
+public:
+    PSrtpParams local;
+    PSrtpParams remote;
+
+    RwControlUpdateSrtpMessage() : RwControlMessage(RwControlMessage::UpdateSrtp) { }
+};
+
+class RwControlPreviewSizeMessage : public RwControlMessage {
+public:
+    QSize size;
+
+    RwControlPreviewSizeMessage() : RwControlMessage(RwControlMessage::PreviewSize) { }
+};
+
+class RwControlLatencyTracingMessage : public RwControlMessage {
+public:
+    bool enabled = false;
+
+    RwControlLatencyTracingMessage() : RwControlMessage(RwControlMessage::LatencyTracing) { }
+};
+
 class RwControlTransmitMessage : public RwControlMessage {
 public:
     RwControlTransmit transmit;
@@ -265,6 +329,20 @@ public:
     RwControlAudioIntensityMessage() : RwControlMessage(RwControlMessage::AudioIntensity) { }
 };
 
+class RwControlVideoAdaptationMessage : public RwControlMessage {
+public:
+    RwControlVideoAdaptation adaptation;
+
+    RwControlVideoAdaptationMessage() : RwControlMessage(RwControlMessage::VideoAdaptation) { }
+};
+
+class RwControlOfflineProgressMessage : public RwControlMessage {
+public:
+    RwControlOfflineProgress progress;
+
+    RwControlOfflineProgressMessage() : RwControlMessage(RwControlMessage::OfflineProgress) { }
+};
+
 class RwControlFrameMessage : public RwControlMessage {
 public:
     RwControlFrame frame;
@@ -285,10 +363,18 @@ public:
     void updateCodecs(const RwControlConfigCodecs &codecs);
     void setTransmit(const RwControlTransmit &transmit);
     void setRecord(const RwControlRecord &record);
+    void updateSrtp(const PSrtpParams &local, const PSrtpParams &remote);
+    void setPreviewSize(const QSize &size); // cheaper than updateDevices, no status
+    void setLatencyTracing(bool enabled);
 
     // can be called from any thread
-    void rtpAudioIn(const PRtpPacket &packet);
-    void rtpVideoIn(const PRtpPacket &packet);
+    void                 rtpAudioIn(const PRtpPacket &packet);
+    void                 rtpVideoIn(const PRtpPacket &packet);
+    void                 requestKeyframe();
+    PVideoOutputStats    videoOutputStats() const;
+    PStreamMetrics       audioStreamMetrics() const;
+    PStreamMetrics       videoStreamMetrics() const;
+    QList<PLatencyStage> latencyStages() const;
 
     // can come from any thread.
     // note that it is only safe to assign callbacks prior to starting.
@@ -300,6 +386,7 @@ public:
     void (*cb_recordData)(const QByteArray &packet, void *app);
 
     void dumpPipeline(std::function<void(const QStringList &)> callback);
+    void pipelineSnapshot(std::function<void(const QVariantMap &)> callback);
 signals:
     // response to start, stop, updateCodecs, or it could be spontaneous
     void statusReady(const RwControlStatus &status);
@@ -308,6 +395,8 @@ signals:
     void outputFrame(const QImage &img);
     void audioOutputIntensityChanged(int intensity);
     void audioInputIntensityChanged(int intensity);
+    void videoAdaptationChanged(const QSize &size, int fps, bool degraded);
+    void offlineProgress(qint64 position, qint64 duration, qint64 remaining);
 
 private slots:
     void processMessages();
@@ -322,6 +411,9 @@ private:
 
     QMutex                    in_mutex;
     QList<RwControlMessage *> in;
+    bool                      offline = false; // output frames are never dropped
+    bool                      closing = false; // stop holding up the remote
+    QWaitCondition            in_taken;
 
     static gboolean cb_doCreateRemote(gpointer data);
     static gboolean cb_doDestroyRemote(gpointer data);
@@ -330,6 +422,7 @@ private:
     gboolean doDestroyRemote();
 
     friend class RwControlRemote;
+    friend class MicroBench; // bench/microbench.cpp
     void postMessage(RwControlMessage *msg);
 };
 
@@ -361,6 +454,8 @@ private:
     static void     cb_worker_error(void *app);
     static void     cb_worker_audioOutputIntensity(int value, void *app);
     static void     cb_worker_audioInputIntensity(int value, void *app);
+    static void     cb_worker_videoAdaptation(const QSize &size, int fps, bool degraded, void *app);
+    static void     cb_worker_offlineProgress(qint64 position, qint64 duration, qint64 remaining, void *app);
     static void     cb_worker_previewFrame(const RtpWorker::Frame &frame, void *app);
     static void     cb_worker_outputFrame(const RtpWorker::Frame &frame, void *app);
     static void     cb_worker_rtpAudioOut(const PRtpPacket &packet, void *app);
@@ -375,6 +470,8 @@ private:
     void     worker_error();
     void     worker_audioOutputIntensity(int value);
     void     worker_audioInputIntensity(int value);
+    void     worker_videoAdaptation(const QSize &size, int fps, bool degraded);
+    void     worker_offlineProgress(qint64 position, qint64 duration, qint64 remaining);
     void     worker_previewFrame(const RtpWorker::Frame &frame);
     void     worker_outputFrame(const RtpWorker::Frame &frame);
     void     worker_rtpAudioOut(const PRtpPacket &packet);
@@ -387,9 +484,14 @@ private:
     bool processMessage(RwControlMessage *msg);
 
     friend class RwControlLocal;
-    void postMessage(RwControlMessage *msg);
-    void rtpAudioIn(const PRtpPacket &packet);
-    void rtpVideoIn(const PRtpPacket &packet);
+    void                 postMessage(RwControlMessage *msg);
+    void                 rtpAudioIn(const PRtpPacket &packet);
+    void                 rtpVideoIn(const PRtpPacket &packet);
+    void                 requestKeyframe();
+    PVideoOutputStats    videoOutputStats() const;
+    PStreamMetrics       audioStreamMetrics() const;
+    PStreamMetrics       videoStreamMetrics() const;
+    QList<PLatencyStage> latencyStages() const;
 };
 
 }
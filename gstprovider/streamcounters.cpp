@@ -0,0 +1,91 @@
+/*
+ * Copyright (C) 2026  Psi IM Team
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301  USA
+ *
+ */
+
+#include "streamcounters.h"
+
+#include <QtEndian>
+#include <cmath>
+#include <glib.h>
+
+namespace PsiMedia {
+
+// upper bounds of the packet size buckets, in bytes.  the last bucket is open
+static const int size_limits[] = { 100, 200, 300, 500, 800, 1000, 1200, 1400 };
+
+StreamCounters::StreamCounters(bool _video) : video(_video) { }
+
+void StreamCounters::setClockRate(int rate) { clockRate.storeRelease(rate); }
+
+void StreamCounters::packetIn(const QByteArray &rtp)
+{
+    packetsIn.ref();
+    bytesIn.fetchAndAddRelaxed(rtp.size());
+
+    int rate = clockRate.loadAcquire();
+    if (rtp.size() < 12 || rate <= 0)
+        return;
+
+    // rfc 3550, 6.4.1: the difference of the transit times of two
+    //   consecutive packets, smoothed
+    quint32 rtpTime = qFromBigEndian<quint32>(rtp.constData() + 4);
+    gint64  arrival = g_get_monotonic_time();
+    if (haveLast) {
+        double sent = double(qint32(rtpTime - lastRtpTime)) * 1000000 / rate;
+        double d    = std::fabs(double(arrival - lastArrival) - sent);
+        jitterFactor += (d - jitterFactor) / 16;
+        jitter.storeRelease(int(jitterFactor));
+    }
+    haveLast    = true;
+    lastRtpTime = rtpTime;
+    lastArrival = arrival;
+}
+
+void StreamCounters::packetOut(const QByteArray &rtp)
+{
+    packetsOut.ref();
+    bytesOut.fetchAndAddRelaxed(rtp.size());
+
+    int bucket = 0;
+    while (bucket < SizeBuckets - 1 && rtp.size() > size_limits[bucket])
+        ++bucket;
+    sizes[bucket].ref();
+
+    // the marker bit ends a video frame
+    if (video && rtp.size() >= 2 && (rtp[1] & 0x80))
+        framesEncoded.ref();
+}
+
+PStreamMetrics StreamCounters::metrics() const
+{
+    PStreamMetrics m;
+    m.packetsIn  = packetsIn.loadAcquire();
+    m.bytesIn    = bytesIn.loadAcquire();
+    m.packetsOut = packetsOut.loadAcquire();
+    m.bytesOut   = bytesOut.loadAcquire();
+    for (const QAtomicInt &n : sizes)
+        m.packetSizes += n.loadAcquire();
+    for (int limit : size_limits)
+        m.packetSizeLimits += limit;
+    m.jitter        = jitter.loadAcquire();
+    m.framesEncoded = framesEncoded.loadAcquire();
+    return m;
+}
+
+}
@@ -0,0 +1,76 @@
+/*
+ * Copyright (C) 2026  Psi IM Team
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301  USA
+ *
+ */
+
+#ifndef PSIMEDIA_STREAMCOUNTERS_H
+#define PSIMEDIA_STREAMCOUNTERS_H
+
+#include "psimediaprovider.h"
+
+#include <QAtomicInt>
+#include <glib.h>
+
+namespace PsiMedia {
+
+//----------------------------------------------------------------------------
+// StreamCounters
+//----------------------------------------------------------------------------
+// packet counters of one rtp stream.  everything is atomic, so the packet
+//   paths never wait for a reader.  packetIn() keeps jitter state and must
+//   not be called from two threads at once, which holds for a single stream.
+//   frame and codec timings are up to the owner to fill in.
+class StreamCounters {
+public:
+    // for video, outgoing packets with the marker bit count as frames
+    explicit StreamCounters(bool video);
+
+    StreamCounters(const StreamCounters &) = delete;
+    StreamCounters &operator=(const StreamCounters &) = delete;
+
+    // rtp clock rate of the incoming stream, needed for the jitter
+    void setClockRate(int rate);
+
+    void packetIn(const QByteArray &rtp);
+    void packetOut(const QByteArray &rtp);
+
+    PStreamMetrics metrics() const;
+
+private:
+    enum { SizeBuckets = 9 };
+
+    bool                   video;
+    QAtomicInt             clockRate;
+    QAtomicInt             packetsIn;
+    QAtomicInteger<qint64> bytesIn;
+    QAtomicInt             packetsOut;
+    QAtomicInteger<qint64> bytesOut;
+    QAtomicInt             sizes[SizeBuckets];
+    QAtomicInt             jitter; // us
+    QAtomicInt             framesEncoded;
+
+    // jitter state, only touched by packetIn()
+    bool    haveLast     = false;
+    quint32 lastRtpTime  = 0;
+    gint64  lastArrival  = 0; // us
+    double  jitterFactor = 0; // us
+};
+
+}
+
+#endif // PSIMEDIA_STREAMCOUNTERS_H
@@ -0,0 +1,211 @@
+/*
+ * Copyright (C) 2026  Psi IM Team
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301  USA
+ *
+ */
+
+#include "virtualdevices.h"
+
+#include "logging.h"
+#include <QMap>
+#include <QSize>
+#include <QStringList>
+#include <gst/gst.h>
+
+namespace PsiMedia {
+
+static const QString virtual_prefix = QStringLiteral("virtual:");
+
+class VirtualDeviceId {
+public:
+    QString                kind;
+    QMap<QString, QString> settings;
+
+    QString value(const QString &key, const QString &defaultValue = QString()) const
+    {
+        return settings.value(key, defaultValue);
+    }
+};
+
+static VirtualDeviceId parse_id(const QString &id)
+{
+    VirtualDeviceId out;
+#if QT_VERSION >= QT_VERSION_CHECK(5, 14, 0)
+    QStringList parts = id.mid(virtual_prefix.length()).split(' ', Qt::SkipEmptyParts);
+#else
+    QStringList parts = id.mid(virtual_prefix.length()).split(' ', QString::SkipEmptyParts);
+#endif
+    if (parts.isEmpty())
+        return out;
+
+    out.kind = parts.takeFirst();
+    for (const QString &part : qAsConst(parts)) {
+        int at = part.indexOf('=');
+        if (at > 0)
+            out.settings[part.left(at)] = part.mid(at + 1);
+        else
+            qCWarning(lcDevices, "virtual device setting without a value: %s", qPrintable(part));
+    }
+    return out;
+}
+
+// sets a property from its string form, which covers enum nicks too
+static void set_arg(GstElement *e, const char *property, const QString &value)
+{
+    if (!g_object_class_find_property(G_OBJECT_GET_CLASS(e), property)) {
+        qCWarning(lcDevices, "virtual device: %s has no %s", GST_OBJECT_NAME(e), property);
+        return;
+    }
+    gst_util_set_object_arg(G_OBJECT(e), property, value.toUtf8().constData());
+}
+
+static GstElement *make_audio_in(const VirtualDeviceId &vid)
+{
+    GstElement *e = gst_element_factory_make("audiotestsrc", nullptr);
+    if (!e)
+        return nullptr;
+
+    g_object_set(G_OBJECT(e), "is-live", TRUE, nullptr);
+    set_arg(e, "wave", vid.value("wave", "sine"));
+    set_arg(e, "freq", vid.value("tone", "440"));
+    if (vid.settings.contains("volume"))
+        set_arg(e, "volume", vid.value("volume"));
+    return e;
+}
+
+static GstElement *make_audio_out(const VirtualDeviceId &vid)
+{
+    GstElement *e = gst_element_factory_make("fakesink", nullptr);
+    if (!e)
+        return nullptr;
+
+    // synced, the sink consumes in real time like a sound card would
+    set_arg(e, "sync", vid.value("sync", "true"));
+    g_object_set(G_OBJECT(e), "async", FALSE, nullptr);
+    return e;
+}
+
+static QString pattern_for_complexity(const QString &complexity)
+{
+    if (complexity == QLatin1String("low"))
+        return "smpte"; // static
+    if (complexity == QLatin1String("high"))
+        return "snow"; // noise, every frame is a new picture
+    if (complexity != QLatin1String("medium"))
+        qCWarning(lcDevices, "unknown virtual device complexity: %s", qPrintable(complexity));
+    return "ball";
+}
+
+// videotestsrc ! capsfilter, in a bin
+static GstElement *make_video_in(const VirtualDeviceId &vid, QSize *captureSize)
+{
+    QStringList sizeParts = vid.value("size", "640x480").split('x');
+    QSize       size;
+    if (sizeParts.count() == 2)
+        size = QSize(sizeParts[0].toInt(), sizeParts[1].toInt());
+    if (size.isEmpty()) {
+        qCWarning(lcDevices, "bad virtual device size: %s", qPrintable(vid.value("size")));
+        return nullptr;
+    }
+    int fps = vid.value("fps", "30").toInt();
+    if (fps <= 0) {
+        qCWarning(lcDevices, "bad virtual device fps: %s", qPrintable(vid.value("fps")));
+        return nullptr;
+    }
+
+    GstElement *src        = gst_element_factory_make("videotestsrc", nullptr);
+    GstElement *capsfilter = gst_element_factory_make("capsfilter", nullptr);
+    if (!src || !capsfilter) {
+        if (src)
+            gst_object_unref(src);
+        if (capsfilter)
+            gst_object_unref(capsfilter);
+        return nullptr;
+    }
+
+    g_object_set(G_OBJECT(src), "is-live", TRUE, nullptr);
+    set_arg(src, "pattern", vid.value("pattern", pattern_for_complexity(vid.value("complexity", "medium"))));
+
+    GstCaps *caps = gst_caps_new_simple("video/x-raw", "width", G_TYPE_INT, size.width(), "height", G_TYPE_INT,
+                                        size.height(), "framerate", GST_TYPE_FRACTION, fps, 1, nullptr);
+    g_object_set(G_OBJECT(capsfilter), "caps", caps, nullptr);
+    gst_caps_unref(caps);
+
+    GstElement *bin = gst_bin_new(nullptr);
+    gst_bin_add_many(GST_BIN(bin), src, capsfilter, nullptr);
+    gst_element_link(src, capsfilter);
+
+    GstPad *pad = gst_element_get_static_pad(capsfilter, "src");
+    gst_element_add_pad(bin, gst_ghost_pad_new("src", pad));
+    gst_object_unref(GST_OBJECT(pad));
+
+    if (captureSize)
+        *captureSize = size;
+    return bin;
+}
+
+bool virtualdevices_isVirtual(const QString &id) { return id.startsWith(virtual_prefix); }
+
+bool virtualdevices_listed() { return !qgetenv("PSI_VIRTUAL_DEVICES").isEmpty(); }
+
+QList<GstDevice> virtualdevices_list()
+{
+    QList<GstDevice> out;
+
+    GstDevice dev;
+    dev.type = PDevice::AudioIn;
+    dev.name = QLatin1String("Virtual: 440 Hz tone");
+    dev.id   = virtual_prefix + "audio-in";
+    out += dev;
+
+    dev.name = QLatin1String("Virtual: pink noise");
+    dev.id   = virtual_prefix + "audio-in wave=pink-noise";
+    out += dev;
+
+    dev.type = PDevice::AudioOut;
+    dev.name = QLatin1String("Virtual: discard");
+    dev.id   = virtual_prefix + "audio-out";
+    out += dev;
+
+    dev.type = PDevice::VideoIn;
+    for (const QSize &size : { QSize(320, 240), QSize(640, 480), QSize(1280, 720) }) {
+        dev.name = QString("Virtual: test pattern %1x%2").arg(size.width()).arg(size.height());
+        dev.id   = virtual_prefix + QString("video-in size=%1x%2").arg(size.width()).arg(size.height());
+        out += dev;
+    }
+
+    return out;
+}
+
+GstElement *virtualdevices_makeElement(const QString &id, PDevice::Type type, QSize *captureSize)
+{
+    VirtualDeviceId vid = parse_id(id);
+
+    GstElement *e = nullptr;
+    if (vid.kind == QLatin1String("audio-in") && type == PDevice::AudioIn)
+        e = make_audio_in(vid);
+    else if (vid.kind == QLatin1String("audio-out") && type == PDevice::AudioOut)
+        e = make_audio_out(vid);
+    else if (vid.kind == QLatin1String("video-in") && type == PDevice::VideoIn)
+        e = make_video_in(vid, captureSize);
+    else
+        qCWarning(lcDevices, "not a virtual device of this type: %s", qPrintable(id));
+
+    return e;
+}
+
+}
@@ -0,0 +1,47 @@
+/*
+ * Copyright (C) 2026  Psi IM Team
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301  USA
+ *
+ */
+
+#ifndef PSIMEDIA_VIRTUALDEVICES_H
+#define PSIMEDIA_VIRTUALDEVICES_H
+
+#include "devices.h"
+
+namespace PsiMedia {
+
+// synthetic devices, for testing and load generation on machines without
+//   cameras or sound cards.  ids are "virtual:" followed by the kind and
+//   optional key=value settings, for example:
+//
+//   virtual:audio-in tone=440 wave=sine volume=0.5
+//   virtual:audio-out sync=true
+//   virtual:video-in size=1280x720 fps=30 complexity=high
+//
+// wave and pattern take audiotestsrc and videotestsrc names.  complexity is
+//   low, medium or high, and picks a pattern that is cheap or expensive to
+//   encode unless pattern is given.  virtual devices work wherever a device
+//   id does, and are listed with the real ones if PSI_VIRTUAL_DEVICES is set.
+bool             virtualdevices_isVirtual(const QString &id);
+bool             virtualdevices_listed();
+QList<GstDevice> virtualdevices_list();
+GstElement *     virtualdevices_makeElement(const QString &id, PDevice::Type type, QSize *captureSize);
+
+}
+
+#endif // PSIMEDIA_VIRTUALDEVICES_H
@@ -0,0 +1,378 @@
+/*
+ * Copyright (C) 2026  Psi IM Team
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301  USA
+ *
+ */
+
+#include "networkimpairment.h"
+
+#include <QElapsedTimer>
+#include <QFile>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QTimer>
+#include <QtMath>
+#include <algorithm>
+#include <random>
+
+namespace PsiMedia {
+
+//----------------------------------------------------------------------------
+// NetworkImpairment
+//----------------------------------------------------------------------------
+class ImpairmentModel {
+public:
+    enum Distribution { Constant, Uniform, Normal, Pareto };
+
+    double       loss         = 0;
+    double       burstLoss    = 0;
+    double       burstEnter   = 0;
+    double       burstExit    = 1;
+    double       delay        = 0; // ms
+    double       jitter       = 0; // ms
+    Distribution distribution = Normal;
+    bool         reorder      = true;
+    int          rate         = 0; // kbit/s
+    int          burst        = 10000;
+    int          queue        = 100000;
+    quint32      seed         = 1;
+};
+
+static const char *distribution_names[] = { "constant", "uniform", "normal", "pareto" };
+
+static bool parse_model(const QString &spec, ImpairmentModel *out)
+{
+    ImpairmentModel m;
+#if QT_VERSION >= QT_VERSION_CHECK(5, 14, 0)
+    QStringList parts = spec.split(' ', Qt::SkipEmptyParts);
+#else
+    QStringList parts = spec.split(' ', QString::SkipEmptyParts);
+#endif
+    for (const QString &part : qAsConst(parts)) {
+        int at = part.indexOf('=');
+        if (at <= 0)
+            return false;
+        QString key   = part.left(at);
+        QString value = part.mid(at + 1);
+
+        bool   ok            = false;
+        double number        = value.toDouble(&ok);
+        bool   isProbability = key == "loss" || key == "burst-loss" || key == "burst-enter" || key == "burst-exit";
+        if (isProbability && (!ok || number < 0 || number > 1))
+            return false;
+
+        if (key == "loss")
+            m.loss = number;
+        else if (key == "burst-loss")
+            m.burstLoss = number;
+        else if (key == "burst-enter")
+            m.burstEnter = number;
+        else if (key == "burst-exit")
+            m.burstExit = number;
+        else if (key == "delay" || key == "jitter") {
+            if (!ok || number < 0)
+                return false;
+            (key == "delay" ? m.delay : m.jitter) = number;
+        } else if (key == "distribution") {
+            int n = 0;
+            while (n < 4 && value != distribution_names[n])
+                ++n;
+            if (n == 4)
+                return false;
+            m.distribution = ImpairmentModel::Distribution(n);
+        } else if (key == "reorder") {
+            if (value != "true" && value != "false")
+                return false;
+            m.reorder = value == "true";
+        } else if (key == "rate" || key == "burst" || key == "queue") {
+            int n = value.toInt(&ok);
+            if (!ok || n < 0)
+                return false;
+            (key == "rate" ? m.rate : (key == "burst" ? m.burst : m.queue)) = n;
+        } else if (key == "seed") {
+            m.seed = value.toUInt(&ok);
+            if (!ok)
+                return false;
+        } else
+            return false;
+    }
+    *out = m;
+    return true;
+}
+
+class NetworkImpairment::Private {
+public:
+    enum Action { Delivered, Lost, Overflowed };
+
+    class Held {
+    public:
+        double    release; // ms
+        quint64   order;
+        RtpPacket packet;
+    };
+
+    class Record {
+    public:
+        quint64 sequence;
+        double  arrival; // ms
+        int     size;
+        int     portOffset;
+        Action  action;
+        double  release; // ms, if delivered
+    };
+
+    NetworkImpairment *q;
+    ImpairmentModel    model;
+    std::mt19937       generator;
+    QElapsedTimer      clock;
+    QTimer             timer;
+    QList<Held>        held; // by release time
+    QList<Record>      records;
+    bool               recording = false;
+
+    quint64 sequence    = 0;
+    bool    bad         = false;
+    double  tokens      = 0; // bytes, negative while packets queue
+    double  tokenTime   = 0; // ms
+    double  lastRelease = 0; // ms
+    int     in          = 0;
+    int     delivered   = 0;
+    int     lost        = 0;
+    int     overflowed  = 0;
+
+    explicit Private(NetworkImpairment *_q) : q(_q)
+    {
+        timer.setSingleShot(true);
+        timer.setTimerType(Qt::PreciseTimer);
+        QObject::connect(&timer, &QTimer::timeout, q, [this]() { release(); });
+        reset();
+    }
+
+    void reset()
+    {
+        generator.seed(model.seed);
+        clock.start();
+        timer.stop();
+        held.clear();
+        records.clear();
+        sequence    = 0;
+        bad         = false;
+        tokens      = model.burst;
+        tokenTime   = 0;
+        lastRelease = 0;
+        in          = 0;
+        delivered   = 0;
+        lost        = 0;
+        overflowed  = 0;
+    }
+
+    double now() const { return double(clock.nsecsElapsed()) / 1000000; }
+
+    // mt19937 is the same everywhere, unlike the std distributions, so the
+    //   shaping is done here.  in [0, 1)
+    double uniform() { return double(generator()) / 4294967296.0; }
+
+    double delaySample(double u1, double u2) const
+    {
+        double d = model.delay;
+        switch (model.distribution) {
+        case ImpairmentModel::Constant:
+            break;
+        case ImpairmentModel::Uniform:
+            d += model.jitter * (2 * u1 - 1);
+            break;
+        case ImpairmentModel::Normal:
+            // box-muller
+            d += model.jitter * qSqrt(-2 * qLn(1 - u1)) * qCos(2 * M_PI * u2);
+            break;
+        case ImpairmentModel::Pareto:
+            // shape 3, scaled so the mean excess is jitter
+            d += 2 * model.jitter * (qPow(1 - u1, -1.0 / 3) - 1);
+            break;
+        }
+        return qMax(0.0, d);
+    }
+
+    void record(const RtpPacket &packet, double arrival, Action action, double releaseTime)
+    {
+        if (!recording)
+            return;
+        records += Record { sequence, arrival, packet.rawValue().size(), packet.portOffset(), action, releaseTime };
+    }
+
+    void write(const RtpPacket &packet)
+    {
+        double t    = now();
+        int    size = packet.rawValue().size();
+        ++sequence;
+        ++in;
+
+        // the same draws for every packet, so the decisions only depend on
+        //   the seed and the packet count
+        double uState = uniform(), uLoss = uniform(), uDelay1 = uniform(), uDelay2 = uniform();
+
+        // bottleneck.  tokens go negative for the bytes queued behind it
+        double depart = t;
+        if (model.rate > 0) {
+            double perMs = model.rate / 8.0;
+            tokens       = qMin(double(model.burst), tokens + (t - tokenTime) * perMs);
+            tokenTime    = t;
+            if (tokens - size < -model.queue) {
+                ++overflowed;
+                record(packet, t, Overflowed, 0);
+                return;
+            }
+            tokens -= size;
+            if (tokens < 0)
+                depart = t - tokens / perMs;
+        }
+
+        // gilbert-elliott
+        if (bad)
+            bad = uState >= model.burstExit;
+        else
+            bad = uState < model.burstEnter;
+        if (uLoss < (bad ? model.burstLoss : model.loss)) {
+            ++lost;
+            record(packet, t, Lost, 0);
+            return;
+        }
+
+        double releaseTime = depart + delaySample(uDelay1, uDelay2);
+        if (!model.reorder)
+            releaseTime = qMax(releaseTime, lastRelease);
+        lastRelease = qMax(lastRelease, releaseTime);
+        record(packet, t, Delivered, releaseTime);
+
+        Held h { releaseTime, sequence, packet };
+        auto at = std::upper_bound(held.begin(), held.end(), h, [](const Held &a, const Held &b) {
+            return a.release < b.release || (a.release == b.release && a.order < b.order);
+        });
+        held.insert(at, h);
+        schedule();
+    }
+
+    void schedule()
+    {
+        if (held.isEmpty()) {
+            timer.stop();
+            return;
+        }
+        timer.start(qMax(0, int(qCeil(held.first().release - now()))));
+    }
+
+    void release()
+    {
+        double           t = now();
+        QList<RtpPacket> due;
+        while (!held.isEmpty() && held.first().release <= t)
+            due += held.takeFirst().packet;
+        schedule();
+
+        for (const RtpPacket &packet : qAsConst(due)) {
+            ++delivered;
+            emit q->packetReady(packet);
+        }
+    }
+};
+
+NetworkImpairment::NetworkImpairment(QObject *parent) : QObject(parent) { d = new Private(this); }
+
+NetworkImpairment::~NetworkImpairment() { delete d; }
+
+bool NetworkImpairment::setModel(const QString &spec)
+{
+    if (!parse_model(spec, &d->model))
+        return false;
+    d->reset();
+    return true;
+}
+
+QString NetworkImpairment::model() const
+{
+    const ImpairmentModel &m = d->model;
+    return QString("loss=%1 burst-loss=%2 burst-enter=%3 burst-exit=%4 delay=%5 jitter=%6 distribution=%7 "
+                   "reorder=%8 rate=%9 burst=%10 queue=%11 seed=%12")
+        .arg(m.loss)
+        .arg(m.burstLoss)
+        .arg(m.burstEnter)
+        .arg(m.burstExit)
+        .arg(m.delay)
+        .arg(m.jitter)
+        .arg(distribution_names[m.distribution])
+        .arg(m.reorder ? "true" : "false")
+        .arg(m.rate)
+        .arg(m.burst)
+        .arg(m.queue)
+        .arg(m.seed);
+}
+
+void NetworkImpairment::setRecording(bool enabled) { d->recording = enabled; }
+
+void NetworkImpairment::write(const RtpPacket &packet) { d->write(packet); }
+
+void NetworkImpairment::connectChannels(RtpChannel *from, RtpChannel *to)
+{
+    connect(from, &RtpChannel::readyRead, this, [this, from]() {
+        while (from->packetsAvailable() > 0)
+            d->write(from->read());
+    });
+    connect(this, &NetworkImpairment::packetReady, to, [to](const RtpPacket &packet) { to->write(packet); });
+}
+
+int NetworkImpairment::packetsIn() const { return d->in; }
+
+int NetworkImpairment::packetsDelivered() const { return d->delivered; }
+
+int NetworkImpairment::packetsLost() const { return d->lost; }
+
+int NetworkImpairment::packetsOverflowed() const { return d->overflowed; }
+
+bool NetworkImpairment::writeLog(const QString &fileName) const
+{
+    static const char *action_names[] = { "delivered", "lost", "overflowed" };
+
+    QJsonArray packets;
+    for (const Private::Record &r : qAsConst(d->records)) {
+        QJsonObject p;
+        p["sequence"]   = qint64(r.sequence);
+        p["arrival"]    = r.arrival;
+        p["size"]       = r.size;
+        p["portOffset"] = r.portOffset;
+        p["action"]     = action_names[r.action];
+        if (r.action == Private::Delivered)
+            p["release"] = r.release;
+        packets += p;
+    }
+
+    QJsonObject log;
+    log["model"]      = model();
+    log["in"]         = d->in;
+    log["delivered"]  = d->delivered;
+    log["lost"]       = d->lost;
+    log["overflowed"] = d->overflowed;
+    log["packets"]    = packets;
+
+    QFile file(fileName);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate))
+        return false;
+    QByteArray out = QJsonDocument(log).toJson();
+    return file.write(out) == out.size();
+}
+
+}
@@ -0,0 +1,98 @@
+/*
+ * Copyright (C) 2026  Psi IM Team
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301  USA
+ *
+ */
+
+#ifndef PSIMEDIA_NETWORKIMPAIRMENT_H
+#define PSIMEDIA_NETWORKIMPAIRMENT_H
+
+#include "psimedia.h"
+
+#include <QObject>
+
+namespace PsiMedia {
+
+// an in-process stand-in for a bad network, to put between the rtp channels
+//   of two sessions (or between a channel and a socket) when testing.  every
+//   packet passes a token bucket bottleneck, then a gilbert-elliott loss
+//   model, then a delay.  the random decisions come from a seeded generator
+//   and only depend on the seed and the packet count, so without a rate the
+//   same model and packets always get the same losses and delays.  the
+//   bottleneck runs on the wall clock though, so with a rate what it queues
+//   and drops also depends on when the packets arrive, and is only repeated
+//   when they arrive with the same timing.
+//
+// the model is a string of space separated key=value settings:
+//
+//   loss=P          loss probability in the good state (default 0)
+//   burst-loss=P    loss probability in the bad state (default 0)
+//   burst-enter=P   per packet probability of going from good to bad (0)
+//   burst-exit=P    per packet probability of going from bad to good (1)
+//   delay=MS        base one-way delay (default 0)
+//   jitter=MS       spread of the delay (default 0)
+//   distribution=D  constant, uniform, normal or pareto (default normal)
+//   reorder=B       let jittered packets overtake each other (default true)
+//   rate=KBPS       bottleneck rate in kbit/s, 0 for none (default 0)
+//   burst=BYTES     token bucket size (default 10000)
+//   queue=BYTES     bottleneck queue, beyond which packets are dropped
+//                   (default 100000)
+//   seed=N          generator seed (default 1)
+//
+// for example: "loss=0.01 burst-enter=0.01 burst-exit=0.3 burst-loss=0.5
+//   delay=60 jitter=15 rate=800 seed=42"
+class NetworkImpairment : public QObject {
+    Q_OBJECT
+
+public:
+    explicit NetworkImpairment(QObject *parent = nullptr);
+    ~NetworkImpairment() override;
+
+    // returns false and leaves the model alone if spec has unknown keys or
+    //   bad values.  otherwise restarts the generator and the counters, and
+    //   drops what is held back
+    bool    setModel(const QString &spec);
+    QString model() const; // all settings, defaults included
+
+    // keeps a record of what happened to every packet, for writeLog()
+    void setRecording(bool enabled);
+
+    void write(const RtpPacket &packet);
+
+    // feeds everything read from "from" through, and writes the result to
+    //   "to".  nothing else should read from "from"
+    void connectChannels(RtpChannel *from, RtpChannel *to);
+
+    int packetsIn() const;
+    int packetsDelivered() const;
+    int packetsLost() const;       // by the loss model
+    int packetsOverflowed() const; // by the bottleneck queue
+
+    // the model, the counters and the record as json
+    bool writeLog(const QString &fileName) const;
+
+signals:
+    void packetReady(const PsiMedia::RtpPacket &packet);
+
+private:
+    class Private;
+    Private *d;
+};
+
+}
+
+#endif // PSIMEDIA_NETWORKIMPAIRMENT_H
@@ -61,6 +61,15 @@ static PVideoParams exportVideoParams(const VideoParams &p)
     return out;
 }
 
+static PSrtpParams exportSrtpParams(const SrtpParams &p)
+{
+    PSrtpParams out;
+    out.cipher = p.cipher();
+    out.auth   = p.auth();
+    out.key    = p.key();
+    return out;
+}
+
 static PayloadInfo importPayloadInfo(const PPayloadInfo &pp)
 {
     PayloadInfo out;
@@ -161,6 +170,15 @@ QString creditText()
     return QString();
 }
 
+bool writeEventTrace(const QString &fileName)
+{
+    auto p = provider();
+    if (p) {
+        return p->writeEventTrace(fileName);
+    }
+    return false;
+}
+
 PluginResult loadPlugin(const QString &fname, const QString &resourcePath)
 {
     if (g_provider)
@@ -187,6 +205,14 @@ PluginResult loadPlugin(const QString &fname, const QString &resourcePath)
         return ErrorInit;
     }
 
+    // the plugin interface didn't change, the provider's may have
+    if (!qobject_cast<Provider *>(provider->qobject())) {
+        delete provider;
+        loader->unload();
+        delete loader;
+        return ErrorVersion;
+    }
+
     if (!provider->init()) {
         delete provider;
         loader->unload();
@@ -404,6 +430,47 @@ QString VideoParams::toString() const
              QString::number(d->fps));
 }
 
+//----------------------------------------------------------------------------
+// SrtpParams
+//----------------------------------------------------------------------------
+class SrtpParams::Private {
+public:
+    QString    cipher;
+    QString    auth;
+    QByteArray key;
+};
+
+SrtpParams::SrtpParams() : d(new Private) { }
+
+SrtpParams::SrtpParams(const SrtpParams &other) : d(new Private(*other.d)) { }
+
+SrtpParams::~SrtpParams() { delete d; }
+
+SrtpParams &SrtpParams::operator=(const SrtpParams &other)
+{
+    *d = *other.d;
+    return *this;
+}
+
+bool SrtpParams::isNull() const { return d->key.isEmpty(); }
+
+QString SrtpParams::cipher() const { return d->cipher; }
+
+QString SrtpParams::auth() const { return d->auth; }
+
+QByteArray SrtpParams::key() const { return d->key; }
+
+void SrtpParams::setCipher(const QString &s) { d->cipher = s; }
+
+void SrtpParams::setAuth(const QString &s) { d->auth = s; }
+
+void SrtpParams::setKey(const QByteArray &key) { d->key = key; }
+
+bool SrtpParams::operator==(const SrtpParams &other) const
+{
+    return d->cipher == other.d->cipher && d->auth == other.d->auth && d->key == other.d->key;
+}
+
 //----------------------------------------------------------------------------
 // Features
 //----------------------------------------------------------------------------
@@ -415,6 +482,38 @@ QList<Device> importDevices(const QList<PDevice> &in)
     return out;
 }
 
+// the devices are matched by id.  returns false if the list stayed the same,
+//   which happens when the changes were seen through a lookup already
+bool applyDeviceChanges(QList<Device> *list, const PDeviceChanges &changes)
+{
+    bool changed = false;
+    for (const PDevice &pd : changes.removed) {
+        for (int n = 0; n < list->count(); ++n) {
+            if (list->at(n).id() == pd.id) {
+                list->removeAt(n);
+                changed = true;
+                break;
+            }
+        }
+    }
+
+    QList<PDevice> updated = changes.added + changes.changed;
+    for (const PDevice &pd : qAsConst(updated)) {
+        Device dev = Global::importDevice(pd);
+        int    n   = 0;
+        while (n < list->count() && list->at(n).id() != pd.id)
+            ++n;
+        if (n == list->count()) {
+            list->append(dev);
+            changed = true;
+        } else if (list->at(n).name() != pd.name || list->at(n).isDefault() != pd.isDefault) {
+            (*list)[n] = dev;
+            changed    = true;
+        }
+    }
+    return changed;
+}
+
 QList<AudioParams> importAudioModes(const QList<PAudioParams> &in)
 {
     QList<AudioParams> out;
@@ -472,6 +571,120 @@ QByteArray RtpPacket::rawValue() const { return d->rawValue; }
 
 int RtpPacket::portOffset() const { return d->portOffset; }
 
+//----------------------------------------------------------------------------
+// VideoOutputStats
+//----------------------------------------------------------------------------
+class VideoOutputStats::Private : public QSharedData {
+public:
+    int decodedFrames;
+    int droppedFrames;
+    int displayedFrames;
+
+    Private(int _decodedFrames, int _droppedFrames, int _displayedFrames) :
+        decodedFrames(_decodedFrames), droppedFrames(_droppedFrames), displayedFrames(_displayedFrames)
+    {
+    }
+};
+
+VideoOutputStats::VideoOutputStats() : d(nullptr) { }
+
+VideoOutputStats::VideoOutputStats(int decodedFrames, int droppedFrames, int displayedFrames) :
+    d(new Private(decodedFrames, droppedFrames, displayedFrames))
+{
+}
+
+VideoOutputStats::VideoOutputStats(const VideoOutputStats &other) = default;
+
+VideoOutputStats::~VideoOutputStats() = default;
+
+VideoOutputStats &VideoOutputStats::operator=(const VideoOutputStats &other) = default;
+
+bool VideoOutputStats::isNull() const { return (d ? false : true); }
+
+int VideoOutputStats::decodedFrames() const { return d->decodedFrames; }
+
+int VideoOutputStats::droppedFrames() const { return d->droppedFrames; }
+
+int VideoOutputStats::displayedFrames() const { return d->displayedFrames; }
+
+//----------------------------------------------------------------------------
+// StreamMetrics
+//----------------------------------------------------------------------------
+class StreamMetrics::Private : public QSharedData {
+public:
+    PStreamMetrics metrics;
+
+    explicit Private(const PStreamMetrics &_metrics) : metrics(_metrics) { }
+};
+
+StreamMetrics::StreamMetrics() : d(nullptr) { }
+
+StreamMetrics::StreamMetrics(const StreamMetrics &other) = default;
+
+StreamMetrics::~StreamMetrics() = default;
+
+StreamMetrics &StreamMetrics::operator=(const StreamMetrics &other) = default;
+
+bool StreamMetrics::isNull() const { return (d ? false : true); }
+
+int StreamMetrics::packetsReceived() const { return d->metrics.packetsIn; }
+
+qint64 StreamMetrics::bytesReceived() const { return d->metrics.bytesIn; }
+
+int StreamMetrics::packetsSent() const { return d->metrics.packetsOut; }
+
+qint64 StreamMetrics::bytesSent() const { return d->metrics.bytesOut; }
+
+int StreamMetrics::packetsDropped() const { return d->metrics.packetsDropped; }
+
+QList<int> StreamMetrics::packetSizes() const { return d->metrics.packetSizes; }
+
+QList<int> StreamMetrics::packetSizeLimits() const { return d->metrics.packetSizeLimits; }
+
+int StreamMetrics::jitter() const { return d->metrics.jitter; }
+
+int StreamMetrics::framesEncoded() const { return d->metrics.framesEncoded; }
+
+int StreamMetrics::framesDecoded() const { return d->metrics.framesDecoded; }
+
+int StreamMetrics::encodeTime() const { return d->metrics.encodeTime; }
+
+int StreamMetrics::decodeTime() const { return d->metrics.decodeTime; }
+
+//----------------------------------------------------------------------------
+// LatencyStage
+//----------------------------------------------------------------------------
+class LatencyStage::Private : public QSharedData {
+public:
+    PLatencyStage stage;
+
+    explicit Private(const PLatencyStage &_stage) : stage(_stage) { }
+};
+
+LatencyStage::LatencyStage() : d(nullptr) { }
+
+LatencyStage::LatencyStage(const LatencyStage &other) = default;
+
+LatencyStage::~LatencyStage() = default;
+
+LatencyStage &LatencyStage::operator=(const LatencyStage &other) = default;
+
+bool LatencyStage::isNull() const { return (d ? false : true); }
+
+QString LatencyStage::stream() const { return d->stage.stream; }
+
+QString LatencyStage::name() const { return d->stage.name; }
+
+int LatencyStage::count() const { return d->stage.count; }
+
+int LatencyStage::meanLatency() const { return d->stage.mean; }
+
+int LatencyStage::maxLatency() const { return d->stage.max; }
+
+QList<int> LatencyStage::histogram() const { return d->stage.histogram; }
+
+QList<int> LatencyStage::histogramLimits() const { return d->stage.bucketLimits; }
+
 //----------------------------------------------------------------------------
 // RtpChannel
 //----------------------------------------------------------------------------
@@ -499,10 +712,10 @@ RtpPacket RtpChannel::read()
 void RtpChannel::write(const RtpPacket &rtp)
 {
     if (d->c) {
-        if (!d->enabled) {
-            d->enabled = true;
-            d->c->setEnabled(true);
-        }
+        d->m.lock();
+        d->setEnabled(true);
+        d->callbackEnabled = false; // enabled for its own sake now
+        d->m.unlock();
 
         PRtpPacket pp;
         pp.rawValue   = rtp.rawValue();
@@ -511,6 +724,17 @@ void RtpChannel::write(const RtpPacket &rtp)
     }
 }
 
+void RtpChannel::setPacketCallback(std::function<void(const RtpPacket &)> callback)
+{
+    d->m.lock();
+    d->packetCallback = std::move(callback);
+    ++d->callbackSerial;
+    d->m.unlock();
+
+    if (d->c)
+        d->applyPacketCallback();
+}
+
 void RtpChannel::connectNotify(const QMetaMethod &signal)
 {
     int oldtotal = d->readyReadListeners;
@@ -518,10 +742,11 @@ void RtpChannel::connectNotify(const QMetaMethod &signal)
     if (signal == QMetaMethod::fromSignal(&RtpChannel::readyRead))
         ++d->readyReadListeners;
 
-    int total = d->readyReadListeners;
+    int          total = d->readyReadListeners;
+    QMutexLocker locker(&d->m);
     if (d->c && oldtotal == 0 && total > 0) {
-        d->enabled = true;
-        d->c->setEnabled(true);
+        d->setEnabled(true);
+        d->callbackEnabled = false;
     }
 }
 
@@ -532,10 +757,14 @@ void RtpChannel::disconnectNotify(const QMetaMethod &signal)
     if (signal == QMetaMethod::fromSignal(&RtpChannel::readyRead))
         --d->readyReadListeners;
 
-    int total = d->readyReadListeners;
+    // a packet callback keeps the channel enabled
+    int          total = d->readyReadListeners;
+    QMutexLocker locker(&d->m);
     if (d->c && oldtotal > 0 && total == 0) {
-        d->enabled = false;
-        d->c->setEnabled(false);
+        if (d->packetCallback)
+            d->callbackEnabled = true;
+        else
+            d->setEnabled(false);
     }
 }
 
@@ -658,6 +887,8 @@ void RtpSession::setFileDataInput(const QByteArray &fileData) { d->c->setFileDat
 
 void RtpSession::setFileLoopEnabled(bool enabled) { d->c->setFileLoopEnabled(enabled); }
 
+void RtpSession::setOfflineMode(bool enabled) { d->c->setOfflineMode(enabled); }
+
 #ifdef QT_GUI_LIB
 void RtpSession::setVideoPreviewWidget(VideoWidget *widget)
 {
@@ -665,8 +896,15 @@ void RtpSession::setVideoPreviewWidget(VideoWidget *widget)
 }
 #endif
 
+void RtpSession::setVideoPreviewSize(const QSize &size) { d->c->setVideoPreviewSize(size); }
+
 void RtpSession::dumpPipeline(std::function<void(const QStringList &)> callback) { d->c->dumpPipeline(callback); }
 
+void RtpSession::pipelineSnapshot(std::function<void(const QVariantMap &)> callback)
+{
+    d->c->pipelineSnapshot(callback);
+}
+
 void RtpSession::setRecordingQIODevice(QIODevice *dev) { d->c->setRecorder(dev); }
 
 void RtpSession::stopRecording() { d->c->stopRecording(); }
@@ -689,6 +927,13 @@ void RtpSession::setLocalVideoPreferences(const QList<VideoParams> &params)
 
 void RtpSession::setMaximumSendingBitrate(int kbps) { d->c->setMaximumSendingBitrate(kbps); }
 
+void RtpSession::setVideoEncodingCpuBudget(int percent) { d->c->setVideoEncodingCpuBudget(percent); }
+
+void RtpSession::setSrtpParameters(const SrtpParams &local, const SrtpParams &remote)
+{
+    d->c->setSrtpParameters(exportSrtpParams(local), exportSrtpParams(remote));
+}
+
 void RtpSession::setRemoteAudioPreferences(const QList<PayloadInfo> &info)
 {
     QList<PPayloadInfo> list;
@@ -719,6 +964,8 @@ void RtpSession::pauseVideo() { d->c->pauseVideo(); }
 
 void RtpSession::stop() { d->c->stop(); }
 
+void RtpSession::requestKeyframe() { d->c->requestKeyframe(); }
+
 QList<PayloadInfo> RtpSession::localAudioPayloadInfo() const
 {
     QList<PayloadInfo> out;
@@ -781,7 +1028,77 @@ void RtpSession::setInputVolume(int level) { d->c->setInputVolume(level); }
 
 RtpSession::Error RtpSession::errorCode() const { return static_cast<RtpSession::Error>(d->c->errorCode()); }
 
+VideoOutputStats RtpSession::videoOutputStats() const
+{
+    PVideoOutputStats ps = d->c->videoOutputStats();
+    return VideoOutputStats(ps.decoded, ps.droppedLate, ps.displayed);
+}
+
+StreamMetrics RtpSession::audioStreamMetrics() const
+{
+    StreamMetrics m;
+    m.d = new StreamMetrics::Private(d->c->audioStreamMetrics());
+    return m;
+}
+
+StreamMetrics RtpSession::videoStreamMetrics() const
+{
+    StreamMetrics m;
+    m.d = new StreamMetrics::Private(d->c->videoStreamMetrics());
+    return m;
+}
+
+void RtpSession::setLatencyTracingEnabled(bool enabled) { d->c->setLatencyTracing(enabled); }
+
+QList<LatencyStage> RtpSession::latencyStages() const
+{
+    QList<LatencyStage> out;
+    for (const PLatencyStage &ps : d->c->latencyStages()) {
+        LatencyStage s;
+        s.d = new LatencyStage::Private(ps);
+        out += s;
+    }
+    return out;
+}
+
+bool RtpSession::setRtpCaptureFile(const QString &fileName) { return d->c->setRtpCapture(fileName); }
+
 RtpChannel *RtpSession::audioRtpChannel() { return &d->audioRtpChannel; }
 
 RtpChannel *RtpSession::videoRtpChannel() { return &d->videoRtpChannel; }
+
+//----------------------------------------------------------------------------
+// AudioRecorder
+//----------------------------------------------------------------------------
+AudioRecorder::AudioRecorder(QObject *parent) : QObject(parent) { d = new AudioRecorderPrivate(this); }
+
+AudioRecorder::~AudioRecorder() { delete d; }
+
+void AudioRecorder::setInputDevice(const QString &deviceId) { d->c->setInputDevice(deviceId); }
+
+void AudioRecorder::setOutputDevice(QIODevice *recordDevice) { d->c->setOutputDevice(recordDevice); }
+
+void AudioRecorder::setPreferences(const QList<AudioParams> &params)
+{
+    QList<PAudioParams> list;
+    for (const AudioParams &p : params)
+        list += exportAudioParams(p);
+    d->c->setPreferences(list);
+}
+
+QList<AudioParams> AudioRecorder::preferences() const
+{
+    QList<AudioParams> out;
+    for (const PAudioParams &pp : d->c->preferences())
+        out += importAudioParams(pp);
+    return out;
+}
+
+void AudioRecorder::start() { d->c->start(); }
+
+void AudioRecorder::pause() { d->c->pause(); }
+
+void AudioRecorder::stop() { d->c->stop(); }
+
+AudioRecorder::Error AudioRecorder::errorCode() const { return Error(d->c->errorCode()); }
 }; // namespace PsiMedia
@@ -25,6 +25,7 @@
 #include <QSharedDataPointer>
 #include <QSize>
 #include <QStringList>
+#include <QVariantMap>
 #ifdef QT_GUI_LIB
 #include <QWidget>
 #endif
@@ -33,6 +34,7 @@
 class QMetaMethod;
 
 namespace PsiMedia {
+class AudioRecorderPrivate;
 class RtpChannelPrivate;
 class RtpSession;
 class RtpSessionPrivate;
@@ -47,6 +49,12 @@ void         unloadPlugin();
 QString creditName();
 QString creditText();
 
+// writes the most recent media events of the process (packets, control
+//   messages, frames, state changes) to fileName as a chrome trace, to be
+//   loaded into perfetto or chrome://tracing.  returns false if there is no
+//   provider or the file can't be written
+bool writeEventTrace(const QString &fileName);
+
 class Device {
 public:
     enum Type {
@@ -151,6 +159,36 @@ private:
     Private *d;
 };
 
+// srtp master key material.  key() is the master key followed by the
+//   master salt: 30 bytes for aes-128-icm, 46 for aes-256-icm, 28 for
+//   aes-128-gcm and 44 for aes-256-gcm.  an empty cipher means aes-128-icm
+//   and an empty auth means hmac-sha1-80 (auth is ignored for gcm).
+class SrtpParams {
+public:
+    SrtpParams();
+    SrtpParams(const SrtpParams &other);
+    ~SrtpParams();
+    SrtpParams &operator=(const SrtpParams &other);
+
+    bool isNull() const;
+
+    QString    cipher() const;
+    QString    auth() const;
+    QByteArray key() const;
+
+    void setCipher(const QString &s);
+    void setAuth(const QString &s);
+    void setKey(const QByteArray &key);
+
+    bool operator==(const SrtpParams &other) const;
+
+    inline bool operator!=(const SrtpParams &other) const { return !(*this == other); }
+
+private:
+    class Private;
+    Private *d;
+};
+
 class Features : public QObject {
     Q_OBJECT
 
@@ -194,6 +232,105 @@ private:
     QSharedDataPointer<Private> d;
 };
 
+// counters of received video frames since the session started.  under
+//   load, frames that would be shown too late are skipped (before decoding
+//   if possible) rather than queued, and counted as dropped.
+class VideoOutputStats {
+public:
+    VideoOutputStats();
+    VideoOutputStats(int decodedFrames, int droppedFrames, int displayedFrames);
+    VideoOutputStats(const VideoOutputStats &other);
+    ~VideoOutputStats();
+    VideoOutputStats &operator=(const VideoOutputStats &other);
+
+    bool isNull() const;
+
+    int decodedFrames() const;
+    int droppedFrames() const;
+    int displayedFrames() const;
+
+private:
+    class Private;
+    QSharedDataPointer<Private> d;
+};
+
+// counters of one media stream, since the session started.  times are in
+//   microseconds.  frame counts and codec times are for video only.
+class StreamMetrics {
+public:
+    StreamMetrics();
+    StreamMetrics(const StreamMetrics &other);
+    ~StreamMetrics();
+    StreamMetrics &operator=(const StreamMetrics &other);
+
+    bool isNull() const;
+
+    int    packetsReceived() const;
+    qint64 bytesReceived() const;
+    int    packetsSent() const; // produced for the remote side
+    qint64 bytesSent() const;
+
+    // produced, but dropped because the rtp channel was not read in time
+    int packetsDropped() const;
+
+    // outgoing packets per size bucket.  bucket n holds sizes up to
+    //   packetSizeLimits()[n] bytes, the last one everything above
+    QList<int> packetSizes() const;
+    QList<int> packetSizeLimits() const;
+
+    int jitter() const; // interarrival jitter of received packets (rfc 3550)
+
+    int framesEncoded() const;
+    int framesDecoded() const;
+    int encodeTime() const; // smoothed per frame, 0 if unknown
+    int decodeTime() const; // smoothed per frame, 0 if unknown
+
+private:
+    class Private;
+    friend class RtpSession;
+    QSharedDataPointer<Private> d;
+};
+
+// latency attributed to one stage of a stream while latency tracing is
+//   enabled.  the stages of a stream follow each other in flow order:
+//   audio-send and video-send: capture, aec (with echo cancellation), prep,
+//     queue, encode, pay, handoff (to the rtp channel)
+//   audio-recv and video-recv: jitterbuffer, depay, decode, convert, sink
+//   the send side starts at the capture timestamp, the receive side at the
+//   packet arrival.
+//   audio-e2e and video-e2e: glass-to-glass, from capture on the remote side
+//     to output here.  the sender stamps its wall clock capture time into
+//     the rtp (abs-capture-time header extension), so this needs tracing on
+//     both sides and wall clocks that agree.  audio is counted until the
+//     output device is due to play it, video until the frame is handed to
+//     the application.
+//   all times are in microseconds.
+class LatencyStage {
+public:
+    LatencyStage();
+    LatencyStage(const LatencyStage &other);
+    ~LatencyStage();
+    LatencyStage &operator=(const LatencyStage &other);
+
+    bool isNull() const;
+
+    QString stream() const;
+    QString name() const;
+    int     count() const; // buffers measured
+    int     meanLatency() const;
+    int     maxLatency() const;
+
+    // buffers per bucket.  bucket n holds latencies up to
+    //   histogramLimits()[n], the last one everything above
+    QList<int> histogram() const;
+    QList<int> histogramLimits() const;
+
+private:
+    class Private;
+    friend class RtpSession;
+    QSharedDataPointer<Private> d;
+};
+
 // may drop packets if not read fast enough.
 // may queue no packets at all, if nobody is listening to readyRead.
 class RtpChannel : public QObject {
@@ -204,6 +341,26 @@ public:
     RtpPacket read();
     void      write(const RtpPacket &rtp);
 
+    // opt-in direct mode, for applications with their own thread-safe
+    //   transport.  while a callback is set, outgoing packets are not
+    //   queued and readyRead() is not emitted.  instead the callback is
+    //   invoked synchronously on the media streaming thread as soon as
+    //   each packet is produced.  threading contract:
+    //   - the callback is never called from the thread owning this object,
+    //     so it must be thread-safe.
+    //   - it blocks the media pipeline while it runs, so it should only
+    //     hand the packet over (e.g. to a socket) and return.
+    //   - write() may be used from it.  setPacketCallback() too, which
+    //     doesn't block then: the new callback takes over once the
+    //     running one returns.
+    //   - otherwise, once setPacketCallback() returns, the previous
+    //     callback is not running and won't be called again.  pass an
+    //     empty function to go back to the queued readyRead() mode, which
+    //     leaves the channel enabled only if readyRead() is connected.
+    //   the callback may be set before the session is started, and stays
+    //   in effect across restarts.
+    void setPacketCallback(std::function<void(const RtpPacket &)> callback);
+
 signals:
     void readyRead();
     void packetsWritten(int count);
@@ -291,10 +448,29 @@ public:
     void setFileInput(const QString &fileName);
     void setFileDataInput(const QByteArray &fileData);
     void setFileLoopEnabled(bool enabled);
+    // for processing recorded media rather than calls: the pipelines run
+    //   without a clock, as fast as the cpu allows.  file input is read
+    //   ahead, received rtp is timed by its own rtp timestamps, writes to
+    //   the rtp channels block while the pipeline is behind, and nothing
+    //   read from them is dropped.  audio output is discarded and every
+    //   decoded frame is shown.  live devices still run in real time.
+    //   call before start
+    void setOfflineMode(bool enabled);
 #ifdef QT_GUI_LIB
     void setVideoPreviewWidget(VideoWidget *widget);
 #endif
+    // the local preview is scaled down to fit in this size before it is
+    //   converted for display, which is much cheaper for small self-views.
+    //   by default (invalid size) it follows the preview widget's size.
+    void setVideoPreviewSize(const QSize &size);
     void dumpPipeline(std::function<void(const QStringList &)>);
+    // structured state of the live pipelines: element tree, states,
+    //   negotiated caps per pad, queue levels and latency, under "send" and
+    //   "receive" keys (empty map if not started).  unlike dumpPipeline it
+    //   needs no environment setup, so it can be polled in production.
+    //   QJsonDocument::fromVariant() turns it into json.  the callback is
+    //   invoked from the media thread
+    void pipelineSnapshot(std::function<void(const QVariantMap &)>);
 
     // pass a QIODevice to record to.  if a device is set before starting
     //   the session, then recording will wait until it starts.
@@ -311,6 +487,23 @@ public:
 
     void setMaximumSendingBitrate(int kbps);
 
+    // share of the total cpu time (all cores, 1-100) the video encoder is
+    //   allowed to use.  large budgets let high resolutions be encoded on
+    //   several threads at full effort, small budgets make the encoder
+    //   trade quality for speed instead of dropping frames.  -1 (the
+    //   default) lets the provider decide.  takes effect when sending
+    //   starts.
+    void setVideoEncodingCpuBudget(int percent);
+
+    // encrypt the rtp streams of both media types with srtp.  local params
+    //   protect what we send, remote params decrypt what we receive.  a
+    //   null params object disables that direction.  this must be set
+    //   before start() to enable encryption.  calling it again on a running
+    //   session rekeys the streams without restarting the pipelines.
+    //   params that would turn encryption on or off for a running session,
+    //   or whose key doesn't fit the cipher, are ignored with a warning.
+    void setSrtpParameters(const SrtpParams &local, const SrtpParams &remote);
+
     // set remote preferences, using payloadinfo.
     void setRemoteAudioPreferences(const QList<PayloadInfo> &info);
     void setRemoteVideoPreferences(const QList<PayloadInfo> &info);
@@ -404,6 +597,12 @@ public:
     void pauseVideo();
     void stop();
 
+    // make the video encoder send a full frame as soon as possible, for
+    //   example when a new receiver joins.  requests from the remote side
+    //   (rtcp pli/fir on the video channel) are handled automatically.
+    //   requests closer together than a second are ignored.
+    void requestKeyframe();
+
     // in a correctly negotiated session, there will be an equal amount of
     //   local/remote values for each media type (during negotiation there
     //   may be a mismatch).  however, the payloadinfo for each won't
@@ -442,6 +641,32 @@ public:
 
     Error errorCode() const;
 
+    // all zero if the session is not running
+    VideoOutputStats videoOutputStats() const;
+
+    // readable at any time, cheap to poll.  after the session stops, the
+    //   counters of the last run remain
+    StreamMetrics audioStreamMetrics() const;
+    StreamMetrics videoStreamMetrics() const;
+
+    // measure where the latency of each stream goes, see LatencyStage.
+    //   can be switched at any time and costs a little per buffer while on.
+    //   enabling resets the results, which remain readable after the
+    //   session stops.  PSI_LATENCY_TRACE in the environment also enables it
+    void                setLatencyTracingEnabled(bool enabled);
+    QList<LatencyStage> latencyStages() const;
+
+    // records the rtp of both channels in both directions, each packet with
+    //   the time it was written to or produced by the session, and the
+    //   payload info in effect, for RtpReplay.  recording goes on across
+    //   restarts until called with an empty fileName.  returns false if the
+    //   file can't be written.  PSI_RTP_CAPTURE in the environment records
+    //   every session from its start, "%1" in it is replaced by a counter.
+    //   with srtp the packets are recorded encrypted, as they go over the
+    //   wire, and the keys are not, so they only replay into a session set
+    //   up with the same keys
+    bool setRtpCaptureFile(const QString &fileName);
+
     RtpChannel *audioRtpChannel();
     RtpChannel *videoRtpChannel();
 
@@ -450,6 +675,14 @@ signals:
     void preferencesUpdated();
     void audioOutputIntensityChanged(int intensity); // 0-100, -1 for no signal
     void audioInputIntensityChanged(int intensity);  // 0-100
+    // the sent video was scaled down (degraded) or back up to follow the
+    //   encoder load. size and fps are what is being sent now
+    void videoAdaptationChanged(const QSize &size, int fps, bool degraded);
+    // in offline mode, twice a second.  position and duration of the input
+    //   and the estimated time left at the rate so far, in ms, -1 where
+    //   unknown.  received rtp has no duration.  with file input the last
+    //   one comes right before finished()
+    void offlineProgress(qint64 position, qint64 duration, qint64 remaining);
     void stoppedRecording();
     void stopped();
     void finished(); // for file playback only
@@ -461,6 +694,51 @@ private:
     friend class RtpSessionPrivate;
     RtpSessionPrivate *d;
 };
+
+// records from an audio input device to ogg opus, for voice messages.  the
+//   capture pipeline is set up as soon as the input device is known and
+//   stays ready between recordings, so start() is quick.  the encoded data
+//   is written to the output device in the thread the device lives in, and
+//   the device is closed when the recording ends.  set a new output device
+//   for every recording
+class AudioRecorder : public QObject {
+    Q_OBJECT
+
+public:
+    enum Error { ErrorGeneric, ErrorSystem, ErrorCodec };
+
+    explicit AudioRecorder(QObject *parent = nullptr);
+    ~AudioRecorder() override;
+
+    void setInputDevice(const QString &deviceId);
+    void setOutputDevice(QIODevice *recordDevice);
+
+    // only opus is recorded, with the sample rate and channels of the first
+    //   opus entry where opus supports them.  preferences() is what will be
+    //   used
+    void               setPreferences(const QList<AudioParams> &params);
+    QList<AudioParams> preferences() const;
+
+    // start() after pause() resumes the same recording
+    void start();
+    void pause();
+    void stop();
+
+    Error errorCode() const;
+
+signals:
+    void started();
+    void preferencesUpdated();
+    void paused();
+    void stopped(); // everything is written and the output device closed
+    void error();   // the output device is closed as well
+
+private:
+    Q_DISABLE_COPY(AudioRecorder)
+
+    friend class AudioRecorderPrivate;
+    AudioRecorderPrivate *d;
+};
 }; // namespace PsiMedia
 
 Q_DECLARE_METATYPE(PsiMedia::AudioParams)
@@ -21,6 +21,7 @@
 #include "psimedia.h"
 
 #include <QCoreApplication>
+#include <QMutex>
 #include <QPluginLoader>
 
 #ifdef QT_GUI_LIB
@@ -64,6 +65,7 @@ signals:
 
 Provider *         provider();
 QList<Device>      importDevices(const QList<PDevice> &in);
+bool               applyDeviceChanges(QList<Device> *list, const PDeviceChanges &changes);
 QList<AudioParams> importAudioModes(const QList<PAudioParams> &in);
 QList<VideoParams> importVideoModes(const QList<PVideoParams> &in);
 
@@ -110,13 +112,37 @@ public:
         emit q->updated();
     }
 
+    void applyUpdate(const PFeaturesUpdate &in)
+    {
+        bool changed = applyDeviceChanges(&audioOutputDevices, in.audioOutputDevices);
+        changed      = applyDeviceChanges(&audioInputDevices, in.audioInputDevices) || changed;
+        changed      = applyDeviceChanges(&videoInputDevices, in.videoInputDevices) || changed;
+        // the first update repeats what the lookup brought
+        if (in.types & FeaturesContext::AudioModes) {
+            QList<AudioParams> modes = importAudioModes(in.supportedAudioModes);
+            if (modes != supportedAudioModes) {
+                supportedAudioModes = modes;
+                changed             = true;
+            }
+        }
+        if (in.types & FeaturesContext::VideoModes) {
+            QList<VideoParams> modes = importVideoModes(in.supportedVideoModes);
+            if (modes != supportedVideoModes) {
+                supportedVideoModes = modes;
+                changed             = true;
+            }
+        }
+        if (changed)
+            emit q->updated();
+    }
+
 private slots:
     void providerInitialized()
     {
         c = provider()->createFeatures();
         c->qobject()->setParent(this);
         c->lookup(0xff, this, [this](const PFeatures &in) { importResults(in); });
-        c->monitor(0xff, this, [this](const PFeatures &in) { importResults(in); });
+        c->monitor(0xff, this, [this](const PFeaturesUpdate &in) { applyUpdate(in); });
     }
 };
 
@@ -132,15 +158,30 @@ public:
     bool               enabled;
     int                readyReadListeners;
 
+    // packetCallback and the enabled state can be changed from inside the
+    //   callback, so on the streaming thread.  the context is never called
+    //   into with m held while it may be waiting for the callback
+    QMutex                                 m;
+    std::function<void(const RtpPacket &)> packetCallback;
+    int                                    callbackSerial  = 0;     // bumped on every change
+    bool                                   callbackEnabled = false; // the callback enabled the channel
+
     RtpChannelPrivate(RtpChannel *_q) : QObject(_q), q(_q), c(nullptr), enabled(false), readyReadListeners(0) { }
 
     void setContext(RtpChannelContext *_c)
     {
         if (c) {
+            m.lock();
+            bool hadCallback = bool(packetCallback);
+            m.unlock();
+            if (hadCallback)
+                c->setReadCallback(nullptr);
             c->qobject()->disconnect(this);
             c->qobject()->setParent(nullptr);
-            enabled = false;
-            c       = nullptr;
+            QMutexLocker locker(&m);
+            enabled         = false;
+            callbackEnabled = false;
+            c               = nullptr;
         }
 
         if (!_c)
@@ -152,10 +193,64 @@ public:
         connect(c->qobject(), SIGNAL(packetsWritten(int)), SLOT(c_packetsWritten(int)));
         connect(c->qobject(), SIGNAL(destroyed()), SLOT(c_destroyed()));
 
-        if (readyReadListeners > 0) {
-            enabled = true;
-            c->setEnabled(true);
+        m.lock();
+        if (readyReadListeners > 0)
+            setEnabled(true);
+        bool hasCallback = bool(packetCallback);
+        m.unlock();
+
+        if (hasCallback)
+            applyPacketCallback();
+    }
+
+    // with m held
+    void setEnabled(bool b)
+    {
+        if (enabled == b)
+            return;
+        enabled = b;
+        c->setEnabled(b);
+    }
+
+    // hands the current callback to the context.  a change that comes in
+    //   meanwhile from another thread is handed over right after
+    void applyPacketCallback()
+    {
+        int serial;
+        do {
+            m.lock();
+            serial        = callbackSerial;
+            auto callback = packetCallback;
+            m.unlock();
+
+            if (callback)
+                c->setReadCallback(
+                    [callback](const PRtpPacket &p) { callback(RtpPacket(p.rawValue, p.portOffset)); });
+            else
+                c->setReadCallback(nullptr);
+        } while (!updateCallbackEnabled(serial));
+    }
+
+    // false if the callback changed since serial
+    bool updateCallbackEnabled(int serial)
+    {
+        QMutexLocker locker(&m);
+        if (serial != callbackSerial)
+            return false;
+
+        // a callback needs the channel enabled.  once it is gone the
+        //   channel goes back to what the readyRead() listeners want
+        if (packetCallback) {
+            if (!enabled) {
+                callbackEnabled = true;
+                setEnabled(true);
+            }
+        } else if (callbackEnabled) {
+            callbackEnabled = false;
+            if (readyReadListeners == 0)
+                setEnabled(false);
         }
+        return true;
     }
 
 private slots:
@@ -165,8 +260,10 @@ private slots:
 
     void c_destroyed()
     {
-        enabled = false;
-        c       = nullptr;
+        QMutexLocker locker(&m);
+        enabled         = false;
+        callbackEnabled = false;
+        c               = nullptr;
     }
 };
 
@@ -190,6 +287,10 @@ public:
         connect(c->qobject(), SIGNAL(preferencesUpdated()), SLOT(c_preferencesUpdated()));
         connect(c->qobject(), SIGNAL(audioOutputIntensityChanged(int)), SLOT(c_audioOutputIntensityChanged(int)));
         connect(c->qobject(), SIGNAL(audioInputIntensityChanged(int)), SLOT(c_audioInputIntensityChanged(int)));
+        connect(c->qobject(), SIGNAL(videoAdaptationChanged(const QSize &, int, bool)),
+                SLOT(c_videoAdaptationChanged(const QSize &, int, bool)));
+        connect(c->qobject(), SIGNAL(offlineProgress(qint64, qint64, qint64)),
+                SLOT(c_offlineProgress(qint64, qint64, qint64)));
         connect(c->qobject(), SIGNAL(stoppedRecording()), SLOT(c_stoppedRecording()));
         connect(c->qobject(), SIGNAL(stopped()), SLOT(c_stopped()));
         connect(c->qobject(), SIGNAL(finished()), SLOT(c_finished()));
@@ -212,6 +313,16 @@ private slots:
 
     void c_audioInputIntensityChanged(int intensity) { emit q->audioInputIntensityChanged(intensity); }
 
+    void c_videoAdaptationChanged(const QSize &size, int fps, bool degraded)
+    {
+        emit q->videoAdaptationChanged(size, fps, degraded);
+    }
+
+    void c_offlineProgress(qint64 position, qint64 duration, qint64 remaining)
+    {
+        emit q->offlineProgress(position, duration, remaining);
+    }
+
     void c_stoppedRecording() { emit q->stoppedRecording(); }
 
     void c_stopped()
@@ -235,4 +346,39 @@ private slots:
         emit q->error();
     }
 };
+
+//----------------------------------------------------------------------------
+// AudioRecorder
+//----------------------------------------------------------------------------
+class AudioRecorderPrivate : public QObject {
+    Q_OBJECT
+
+public:
+    AudioRecorder *       q;
+    AudioRecorderContext *c;
+
+    AudioRecorderPrivate(AudioRecorder *_q) : QObject(_q), q(_q)
+    {
+        c = provider()->createAudioRecorder();
+        c->qobject()->setParent(this);
+        connect(c->qobject(), SIGNAL(started()), SLOT(c_started()));
+        connect(c->qobject(), SIGNAL(preferencesUpdated()), SLOT(c_preferencesUpdated()));
+        connect(c->qobject(), SIGNAL(paused()), SLOT(c_paused()));
+        connect(c->qobject(), SIGNAL(stopped()), SLOT(c_stopped()));
+        connect(c->qobject(), SIGNAL(error()), SLOT(c_error()));
+    }
+
+    ~AudioRecorderPrivate() { delete c; }
+
+private slots:
+    void c_started() { emit q->started(); }
+
+    void c_preferencesUpdated() { emit q->preferencesUpdated(); }
+
+    void c_paused() { emit q->paused(); }
+
+    void c_stopped() { emit q->stopped(); }
+
+    void c_error() { emit q->error(); }
+};
 }; // namespace PsiMedia
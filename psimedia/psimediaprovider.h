@@ -54,6 +54,10 @@ class AudioRecorderContext;
 class Plugin {
 public:
     virtual ~Plugin() { }
+
+    // the provider may be returned while it is still starting up, in which
+    //   case init() doesn't start it again and initialized() is emitted once
+    //   it is usable.  check isInitialized() before creating contexts
     virtual Provider *createProvider(const QVariantMap &vm = QVariantMap()) = 0;
 };
 
@@ -106,6 +110,31 @@ public:
     QList<PVideoParams> supportedVideoModes;
 };
 
+// devices are matched by id.  changed ones kept their id but got a new name
+//   or default flag
+class PDeviceChanges {
+public:
+    QList<PDevice> added;
+    QList<PDevice> removed;
+    QList<PDevice> changed;
+
+    inline bool isEmpty() const { return added.isEmpty() && removed.isEmpty() && changed.isEmpty(); }
+};
+
+// what changed since the previous update, limited to the categories a
+//   monitor asked for.  types has the FeaturesContext::Type flags of the
+//   categories that changed, the others are left empty.  modes are sent
+//   whole
+class PFeaturesUpdate {
+public:
+    int                 types = 0;
+    PDeviceChanges      audioOutputDevices;
+    PDeviceChanges      audioInputDevices;
+    PDeviceChanges      videoInputDevices;
+    QList<PAudioParams> supportedAudioModes;
+    QList<PVideoParams> supportedVideoModes;
+};
+
 class PPayloadInfo {
 public:
     class Parameter {
@@ -125,6 +154,16 @@ public:
     inline PPayloadInfo() : id(-1), clockrate(-1), channels(-1), ptime(-1), maxptime(-1) { }
 };
 
+// srtp master key material. key is the master key followed by the master
+//   salt. empty cipher/auth mean "aes-128-icm" and "hmac-sha1-80", an empty
+//   key means no encryption.
+class PSrtpParams {
+public:
+    QString    cipher;
+    QString    auth;
+    QByteArray key;
+};
+
 class PRtpPacket {
 public:
     QByteArray rawValue;
@@ -133,6 +172,63 @@ public:
     inline PRtpPacket() : portOffset(0) { }
 };
 
+// rtp capture file, written by RtpSessionContext::setRtpCapture() and read
+//   by RtpReplay.  integers are big endian.  after the magic come records,
+//   each a type byte and the time since the capture started in us (u64),
+//   then:
+//   - PacketRecord: flags (u8), port offset (u8), size (u16), the packet
+//   - PayloadInfoRecord: size (u32), json of the payload info in effect from
+//     then on, with "localAudio", "localVideo", "remoteAudio" and
+//     "remoteVideo" lists of PPayloadInfo objects, parameters as a list of
+//     name and value objects
+#define PSIMEDIA_RTPCAPTURE_MAGIC "PSIRTPC1"
+
+class PRtpCapture {
+public:
+    enum Record { PacketRecord = 0, PayloadInfoRecord = 1 };
+    enum Flag {
+        Video = 0x01, // otherwise audio
+        Sent  = 0x02  // produced by the session, otherwise written to it
+    };
+};
+
+// receive side video frame counters, since the session started
+class PVideoOutputStats {
+public:
+    int decoded     = 0; // frames produced by the decoder
+    int droppedLate = 0; // received, but skipped because they would be shown too late
+    int displayed   = 0; // frames handed to the output widget
+};
+
+// counters of one media stream since the session started.  times in us
+class PStreamMetrics {
+public:
+    int        packetsIn      = 0; // rtp from the remote side
+    qint64     bytesIn        = 0;
+    int        packetsOut     = 0; // rtp produced for the remote side
+    qint64     bytesOut       = 0;
+    int        packetsDropped = 0; // produced, but dropped as the app didn't read them in time
+    QList<int> packetSizes;        // outgoing packets per size bucket
+    QList<int> packetSizeLimits;   // upper bound of each bucket but the last, which is open
+    int        jitter        = 0;  // interarrival jitter of incoming packets (rfc 3550)
+    int        framesEncoded = 0;  // video only
+    int        framesDecoded = 0;  // video only
+    int        encodeTime    = 0;  // smoothed per frame, 0 if unknown
+    int        decodeTime    = 0;  // smoothed per frame, 0 if unknown
+};
+
+// latency attributed to one stage of a stream while tracing, in us
+class PLatencyStage {
+public:
+    QString    stream; // e.g. "audio-send", "video-recv"
+    QString    name;   // e.g. "capture", "encode", "jitterbuffer"
+    int        count = 0;
+    int        mean  = 0;
+    int        max   = 0;
+    QList<int> histogram;    // buffers per bucket
+    QList<int> bucketLimits; // upper bound of each bucket but the last, which is open
+};
+
 class Provider : public QObjectInterface {
 public:
     virtual bool init()                = 0;
@@ -145,6 +241,9 @@ public:
     virtual RtpSessionContext *   createRtpSession()    = 0;
     virtual AudioRecorderContext *createAudioRecorder() = 0;
 
+    // recent media events of the whole process, as a chrome trace
+    virtual bool writeEventTrace(const QString &fileName) = 0;
+
     HINT_SIGNALS : HINT_METHOD(initialized())
 };
 
@@ -152,8 +251,12 @@ class FeaturesContext : public QObjectInterface {
 public:
     enum Type { AudioOut = 0x01, AudioIn = 0x02, VideoIn = 0x04, AudioModes = 0x08, VideoModes = 0x10 };
 
-    virtual void lookup(int types, QObject *receiver, std::function<void(const PFeatures &)> &&callback)  = 0;
-    virtual void monitor(int types, QObject *receiver, std::function<void(const PFeatures &)> &&callback) = 0;
+    // the callbacks are dropped with the receiver.  lookup calls back once
+    //   with everything, as soon as it is known.  monitor calls back with
+    //   the changes to the given types from then on, and starts with
+    //   everything as added if nothing is known yet
+    virtual void lookup(int types, QObject *receiver, std::function<void(const PFeatures &)> &&callback)        = 0;
+    virtual void monitor(int types, QObject *receiver, std::function<void(const PFeaturesUpdate &)> &&callback) = 0;
 };
 
 class RtpChannelContext : public QObjectInterface {
@@ -164,6 +267,14 @@ public:
     virtual PRtpPacket read()                       = 0;
     virtual void       write(const PRtpPacket &rtp) = 0;
 
+    // with a callback set, packets are handed to it synchronously from the
+    //   streaming thread instead of being queued for read(). readyRead is
+    //   not emitted then. once this returns, the previous callback is not
+    //   running anymore. an empty callback switches back to queuing.
+    //   calling this from inside the callback doesn't block; the new
+    //   callback takes over once the running one returns.
+    virtual void setReadCallback(std::function<void(const PRtpPacket &)> &&callback) = 0;
+
     HINT_SIGNALS : HINT_METHOD(readyRead()) HINT_METHOD(packetsWritten(int count))
 };
 
@@ -192,12 +303,16 @@ public:
     virtual void setFileInput(const QString &fileName)         = 0;
     virtual void setFileDataInput(const QByteArray &fileData)  = 0;
     virtual void setFileLoopEnabled(bool enabled)              = 0;
+    virtual void setOfflineMode(bool enabled)                  = 0; // before start
 
 #ifdef QT_GUI_LIB
     virtual void setVideoOutputWidget(VideoWidgetContext *widget)  = 0;
     virtual void setVideoPreviewWidget(VideoWidgetContext *widget) = 0;
 #endif
 
+    // invalid size to follow the preview widget
+    virtual void setVideoPreviewSize(const QSize &size) = 0;
+
     virtual void setRecorder(QIODevice *recordDevice) = 0;
     virtual void stopRecording()                      = 0;
 
@@ -206,6 +321,14 @@ public:
 
     virtual void setMaximumSendingBitrate(int kbps) = 0;
 
+    // share of the total cpu (all cores) the video encoder may use, -1 for
+    //   the default
+    virtual void setVideoEncodingCpuBudget(int percent) = 0;
+
+    // may be called again after starting to rekey, but encryption itself
+    //   can only be turned on or off before starting
+    virtual void setSrtpParameters(const PSrtpParams &local, const PSrtpParams &remote) = 0;
+
     virtual void setRemoteAudioPreferences(const QList<PPayloadInfo> &info) = 0;
     virtual void setRemoteVideoPreferences(const QList<PPayloadInfo> &info) = 0;
 
@@ -219,6 +342,9 @@ public:
     virtual void pauseVideo() = 0;
     virtual void stop()       = 0;
 
+    // may be called from any thread
+    virtual void requestKeyframe() = 0;
+
     virtual QList<PPayloadInfo> localAudioPayloadInfo() const  = 0;
     virtual QList<PPayloadInfo> localVideoPayloadInfo() const  = 0;
     virtual QList<PPayloadInfo> remoteAudioPayloadInfo() const = 0;
@@ -238,14 +364,28 @@ public:
 
     virtual Error errorCode() const = 0;
 
+    virtual PVideoOutputStats videoOutputStats() const   = 0;
+    virtual PStreamMetrics    audioStreamMetrics() const = 0;
+    virtual PStreamMetrics    videoStreamMetrics() const = 0;
+
+    virtual void                 setLatencyTracing(bool enabled) = 0;
+    virtual QList<PLatencyStage> latencyStages() const           = 0;
+
+    // empty fileName stops capturing
+    virtual bool setRtpCapture(const QString &fileName) = 0;
+
     virtual RtpChannelContext *audioRtpChannel() = 0;
     virtual RtpChannelContext *videoRtpChannel() = 0;
 
-    virtual void dumpPipeline(std::function<void(const QStringList &)> callback) = 0;
+    virtual void dumpPipeline(std::function<void(const QStringList &)> callback)     = 0;
+    virtual void pipelineSnapshot(std::function<void(const QVariantMap &)> callback) = 0;
 
     HINT_SIGNALS : HINT_METHOD(started()) HINT_METHOD(preferencesUpdated())
                        HINT_METHOD(audioOutputIntensityChanged(int intensity))
-                           HINT_METHOD(audioInputIntensityChanged(int intensity)) HINT_METHOD(stoppedRecording())
+                           HINT_METHOD(audioInputIntensityChanged(int intensity))
+                               HINT_METHOD(videoAdaptationChanged(const QSize &size, int fps, bool degraded))
+                                   HINT_METHOD(offlineProgress(qint64 position, qint64 duration, qint64 remaining))
+                                   HINT_METHOD(stoppedRecording())
                                HINT_METHOD(stopped()) HINT_METHOD(finished()) // for file playback only
                    HINT_METHOD(error())
 };
@@ -273,10 +413,10 @@ public:
 }; // namespace PsiMedia
 
 Q_DECLARE_INTERFACE(PsiMedia::Plugin, "org.psi-im.psimedia.Plugin/1.5")
-Q_DECLARE_INTERFACE(PsiMedia::Provider, "org.psi-im.psimedia.Provider/1.5")
-Q_DECLARE_INTERFACE(PsiMedia::FeaturesContext, "org.psi-im.psimedia.FeaturesContext/1.4")
-Q_DECLARE_INTERFACE(PsiMedia::RtpChannelContext, "org.psi-im.psimedia.RtpChannelContext/1.4")
-Q_DECLARE_INTERFACE(PsiMedia::RtpSessionContext, "org.psi-im.psimedia.RtpSessionContext/1.5")
+Q_DECLARE_INTERFACE(PsiMedia::Provider, "org.psi-im.psimedia.Provider/1.6")
+Q_DECLARE_INTERFACE(PsiMedia::FeaturesContext, "org.psi-im.psimedia.FeaturesContext/1.5")
+Q_DECLARE_INTERFACE(PsiMedia::RtpChannelContext, "org.psi-im.psimedia.RtpChannelContext/1.5")
+Q_DECLARE_INTERFACE(PsiMedia::RtpSessionContext, "org.psi-im.psimedia.RtpSessionContext/1.6")
 Q_DECLARE_INTERFACE(PsiMedia::AudioRecorderContext, "org.psi-im.psimedia.AudioRecorderContext/1.4")
 
 #endif // PSIMEDIAPROVIDER_H
@@ -0,0 +1,248 @@
+/*
+ * Copyright (C) 2026  Psi IM Team
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301  USA
+ *
+ */
+
+#include "rtpreplay.h"
+
+#include "psimediaprovider.h"
+
+#include <QElapsedTimer>
+#include <QFile>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QPointer>
+#include <QTimer>
+#include <QtEndian>
+
+// packets written per event loop pass when replaying as fast as possible
+#define REPLAY_BATCH 64
+
+namespace PsiMedia {
+
+//----------------------------------------------------------------------------
+// RtpReplay
+//----------------------------------------------------------------------------
+static QList<PayloadInfo> json_to_payload_info(const QJsonArray &list)
+{
+    QList<PayloadInfo> out;
+    for (const QJsonValue &v : list) {
+        QJsonObject o = v.toObject();
+
+        QList<PayloadInfo::Parameter> parameters;
+        for (const QJsonValue &pv : o["parameters"].toArray()) {
+            PayloadInfo::Parameter p;
+            p.name  = pv.toObject()["name"].toString();
+            p.value = pv.toObject()["value"].toString();
+            parameters += p;
+        }
+
+        PayloadInfo pi;
+        pi.setId(o["id"].toInt(-1));
+        pi.setName(o["name"].toString());
+        pi.setClockrate(o["clockrate"].toInt(-1));
+        pi.setChannels(o["channels"].toInt(-1));
+        pi.setPtime(o["ptime"].toInt(-1));
+        pi.setMaxptime(o["maxptime"].toInt(-1));
+        pi.setParameters(parameters);
+        out += pi;
+    }
+    return out;
+}
+
+class RtpReplay::Private {
+public:
+    class Packet {
+    public:
+        qint64     time; // us since the capture started
+        int        flags;
+        int        portOffset;
+        QByteArray data;
+    };
+
+    RtpReplay *          q;
+    QList<Packet>        packets;
+    QJsonObject          info;
+    qint64               firstTime = 0;
+    qint64               lastTime  = 0;
+    QTimer               timer;
+    QElapsedTimer        clock;
+    QPointer<RtpChannel> audio, video;
+    Timing               timing = OriginalTiming;
+    QList<int>           queue; // packets to replay, by index
+    int                  at       = 0;
+    qint64               first    = 0; // time of the first queued packet
+    int                  replayed = 0;
+
+    explicit Private(RtpReplay *_q) : q(_q)
+    {
+        timer.setSingleShot(true);
+        timer.setTimerType(Qt::PreciseTimer);
+        QObject::connect(&timer, &QTimer::timeout, q, [this]() { step(); });
+    }
+
+    bool parse(const QByteArray &buf)
+    {
+        if (!buf.startsWith(PSIMEDIA_RTPCAPTURE_MAGIC))
+            return false;
+
+        const char *p       = buf.constData();
+        int         pos     = 8;
+        bool        records = false;
+        while (pos + 9 <= buf.size()) {
+            int    type = quint8(p[pos]);
+            qint64 time = qint64(qFromBigEndian<quint64>(p + pos + 1));
+            pos += 9;
+
+            if (type == PRtpCapture::PacketRecord) {
+                if (pos + 4 > buf.size())
+                    break;
+                int size = qFromBigEndian<quint16>(p + pos + 2);
+                if (pos + 4 + size > buf.size())
+                    break;
+                packets += Packet { time, quint8(p[pos]), quint8(p[pos + 1]), buf.mid(pos + 4, size) };
+                pos += 4 + size;
+            } else if (type == PRtpCapture::PayloadInfoRecord) {
+                if (pos + 4 > buf.size())
+                    break;
+                int size = int(qFromBigEndian<quint32>(p + pos));
+                if (size < 0 || pos + 4 + size > buf.size())
+                    break;
+                info = QJsonDocument::fromJson(buf.mid(pos + 4, size)).object();
+                pos += 4 + size;
+            } else {
+                // from a later version, which we can't skip
+                break;
+            }
+            if (!records)
+                firstTime = time;
+            records  = true;
+            lastTime = time;
+        }
+        return true;
+    }
+
+    void write(const Packet &packet)
+    {
+        RtpChannel *channel = (packet.flags & PRtpCapture::Video) ? video : audio;
+        if (channel)
+            channel->write(RtpPacket(packet.data, packet.portOffset));
+        ++replayed;
+    }
+
+    void step()
+    {
+        if (timing == AsFastAsPossible) {
+            for (int n = 0; n < REPLAY_BATCH && at < queue.count(); ++n)
+                write(packets[queue[at++]]);
+        } else {
+            qint64 elapsed = clock.nsecsElapsed() / 1000;
+            while (at < queue.count() && packets[queue[at]].time - first <= elapsed)
+                write(packets[queue[at++]]);
+        }
+
+        if (at >= queue.count()) {
+            queue.clear();
+            emit q->finished();
+            return;
+        }
+
+        if (timing == AsFastAsPossible)
+            timer.start(0);
+        else {
+            qint64 wait = packets[queue[at]].time - first - clock.nsecsElapsed() / 1000;
+            timer.start(int(qMax(qint64(0), (wait + 999) / 1000)));
+        }
+    }
+};
+
+RtpReplay::RtpReplay(QObject *parent) : QObject(parent) { d = new Private(this); }
+
+RtpReplay::~RtpReplay() { delete d; }
+
+bool RtpReplay::open(const QString &fileName)
+{
+    stop();
+    d->packets.clear();
+    d->info      = QJsonObject();
+    d->firstTime = 0;
+    d->lastTime  = 0;
+
+    QFile file(fileName);
+    if (!file.open(QIODevice::ReadOnly))
+        return false;
+    return d->parse(file.readAll());
+}
+
+int RtpReplay::packetCount(Direction direction) const
+{
+    int count = 0;
+    for (const Private::Packet &p : qAsConst(d->packets)) {
+        if (bool(p.flags & PRtpCapture::Sent) == (direction == Sent))
+            ++count;
+    }
+    return count;
+}
+
+qint64 RtpReplay::duration() const { return d->lastTime - d->firstTime; }
+
+QList<PayloadInfo> RtpReplay::audioPayloadInfo(Direction direction) const
+{
+    return json_to_payload_info(d->info[direction == Sent ? "localAudio" : "remoteAudio"].toArray());
+}
+
+QList<PayloadInfo> RtpReplay::videoPayloadInfo(Direction direction) const
+{
+    return json_to_payload_info(d->info[direction == Sent ? "localVideo" : "remoteVideo"].toArray());
+}
+
+void RtpReplay::start(RtpChannel *audio, RtpChannel *video, Direction direction, Timing timing)
+{
+    stop();
+    d->audio    = audio;
+    d->video    = video;
+    d->timing   = timing;
+    d->at       = 0;
+    d->replayed = 0;
+    for (int n = 0; n < d->packets.count(); ++n) {
+        const Private::Packet &p = d->packets[n];
+        if (bool(p.flags & PRtpCapture::Sent) != (direction == Sent))
+            continue;
+        if (!((p.flags & PRtpCapture::Video) ? video : audio))
+            continue;
+        d->queue += n;
+    }
+
+    // the gap before the first packet is left out
+    d->first = d->queue.isEmpty() ? 0 : d->packets[d->queue.first()].time;
+    d->clock.start();
+    d->timer.start(0);
+}
+
+void RtpReplay::stop()
+{
+    d->timer.stop();
+    d->queue.clear();
+}
+
+bool RtpReplay::isActive() const { return !d->queue.isEmpty(); }
+
+int RtpReplay::packetsReplayed() const { return d->replayed; }
+
+}
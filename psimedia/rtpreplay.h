@@ -0,0 +1,82 @@
+/*
+ * Copyright (C) 2026  Psi IM Team
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301  USA
+ *
+ */
+
+#ifndef PSIMEDIA_RTPREPLAY_H
+#define PSIMEDIA_RTPREPLAY_H
+
+#include "psimedia.h"
+
+#include <QObject>
+
+namespace PsiMedia {
+
+// plays an rtp capture (see RtpSession::setRtpCaptureFile) back into the
+//   rtp channels of a session, to run the receiving side of a recorded call
+//   again: its jitterbuffers, decoders and what they cost.  the packets of
+//   one direction are written in their recorded order, either at their
+//   recorded times or as fast as the event loop allows.  the same capture
+//   always gives the same packets in the same order, only the timing of a
+//   realtime replay depends on the system
+class RtpReplay : public QObject {
+    Q_OBJECT
+
+public:
+    enum Direction {
+        Received, // written to the recorded session
+        Sent      // produced by the recorded session
+    };
+
+    enum Timing { OriginalTiming, AsFastAsPossible };
+
+    explicit RtpReplay(QObject *parent = nullptr);
+    ~RtpReplay() override;
+
+    // reads the whole capture.  returns false if it can't be read or isn't a
+    //   capture.  a last record cut short is left out
+    bool open(const QString &fileName);
+
+    int    packetCount(Direction direction) const;
+    qint64 duration() const; // us, from the first to the last record
+
+    // the payload info of the recorded session, as last recorded.  the
+    //   Received direction carries the remote payload types, the Sent one
+    //   the local ones.  to replay into a receiving session, these are its
+    //   remote preferences
+    QList<PayloadInfo> audioPayloadInfo(Direction direction) const;
+    QList<PayloadInfo> videoPayloadInfo(Direction direction) const;
+
+    // either channel may be null to leave its media out
+    void start(RtpChannel *audio, RtpChannel *video, Direction direction = Received, Timing timing = OriginalTiming);
+    void stop();
+    bool isActive() const;
+    int  packetsReplayed() const;
+
+signals:
+    // all packets were written
+    void finished();
+
+private:
+    class Private;
+    Private *d;
+};
+
+}
+
+#endif // PSIMEDIA_RTPREPLAY_H
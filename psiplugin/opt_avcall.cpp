@@ -23,10 +23,10 @@ public:
 // OptionsTabAvCall
 //----------------------------------------------------------------------------
 
-OptionsTabAvCall::OptionsTabAvCall(PsiMedia::Provider *provider, OptionAccessingHost *optHost, PsiMediaHost *mediaHost,
-                                   QIcon icon) :
+OptionsTabAvCall::OptionsTabAvCall(std::function<PsiMedia::GstProvider *()> startProvider, OptionAccessingHost *optHost,
+                                   PsiMediaHost *mediaHost, QIcon icon) :
     _icon(icon),
-    provider(provider), optHost(optHost), mediaHost(mediaHost)
+    startProvider(startProvider), optHost(optHost), mediaHost(mediaHost)
 {
     // connect(MediaDeviceWatcher::instance(), &MediaDeviceWatcher::updated, this, [this]() { restoreOptions(); });
 }
@@ -38,10 +38,10 @@ QWidget *OptionsTabAvCall::widget()
     if (w)
         return nullptr;
 
-    w = new OptAvCallUI();
-    if (!features) {
-        features = provider->createFeatures();
-    }
+    w                  = new OptAvCallUI();
+    waitingForProvider = false;
+    if (!provider)
+        provider = startProvider();
 
     return w;
 }
@@ -60,6 +60,7 @@ void OptionsTabAvCall::applyOptions()
     optHost->setPluginOption("devices.audio-output", aout);
     optHost->setPluginOption("devices.audio-input", ain);
     optHost->setPluginOption("devices.video-input", vin);
+    optHost->setPluginOption("provider.prewarm", d->ck_prewarm->isChecked());
     mediaHost->selectMediaDevices(ain, aout, vin);
 }
 
@@ -69,7 +70,25 @@ void OptionsTabAvCall::restoreOptions()
         return;
 
     OptAvCallUI *d = static_cast<OptAvCallUI *>(w.data());
-    auto         devs
+    d->ck_prewarm->setChecked(optHost->getPluginOption("provider.prewarm", false).toBool());
+
+    // the devices are filled in once the provider started by widget() is up
+    if (!provider)
+        return;
+    if (!provider->isInitialized()) {
+        if (!waitingForProvider) {
+            waitingForProvider = true;
+            QObject::connect(provider, &PsiMedia::GstProvider::initialized, w, [this]() {
+                waitingForProvider = false;
+                restoreOptions();
+            });
+        }
+        return;
+    }
+    if (!features)
+        features = provider->createFeatures();
+
+    auto devs
         = PsiMedia::FeaturesContext::AudioOut | PsiMedia::FeaturesContext::AudioIn | PsiMedia::FeaturesContext::VideoIn;
 
     auto handler = [this, d](const PsiMedia::PFeatures &features) {
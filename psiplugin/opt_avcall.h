@@ -5,16 +5,20 @@
 #include "psimediahost.h"
 
 #include <QIcon>
+#include <functional>
 
 namespace PsiMedia {
-class Provider;
+class GstProvider;
 class FeaturesContext;
 }
 class OptionAccessingHost;
 
 class OptionsTabAvCall : public OAH_PluginOptionsTab {
 public:
-    OptionsTabAvCall(PsiMedia::Provider *provider, OptionAccessingHost *optHost, PsiMediaHost *mediaHost, QIcon icon);
+    // startProvider is called when the page is opened, the provider isn't
+    //   needed before
+    OptionsTabAvCall(std::function<PsiMedia::GstProvider *()> startProvider, OptionAccessingHost *optHost,
+                     PsiMediaHost *mediaHost, QIcon icon);
     ~OptionsTabAvCall();
 
     QWidget *widget() override;
@@ -34,12 +38,14 @@ public:
                       std::function<void(QWidget *)> connectDataChanged) override;
 
 private:
-    QPointer<QWidget>          w;
-    QIcon                      _icon;
-    PsiMedia::Provider *       provider;
-    PsiMedia::FeaturesContext *features  = nullptr;
-    OptionAccessingHost *      optHost   = nullptr;
-    PsiMediaHost *             mediaHost = nullptr;
+    QPointer<QWidget>                        w;
+    QIcon                                    _icon;
+    std::function<PsiMedia::GstProvider *()> startProvider;
+    PsiMedia::GstProvider *                  provider           = nullptr;
+    PsiMedia::FeaturesContext *              features           = nullptr;
+    OptionAccessingHost *                    optHost            = nullptr;
+    PsiMediaHost *                           mediaHost          = nullptr;
+    bool                                     waitingForProvider = false;
 
     std::function<void()>          dataChanged;
     std::function<void(bool)>      noDirty;
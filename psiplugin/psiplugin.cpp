@@ -77,6 +77,8 @@ private:
 
     OAH_PluginOptionsTab * tab      = nullptr;
     PsiMedia::GstProvider *provider = nullptr;
+
+    PsiMedia::GstProvider *startProvider();
 };
 
 QString PsiMediaPlugin::name() const { return "Psi Multimedia Plugin"; }
@@ -87,6 +89,28 @@ bool PsiMediaPlugin::enable()
         return false;
     enabled = true;
 
+    if (!tab) {
+        tab = new OptionsTabAvCall([this]() { return startProvider(); }, psiOptions, mediaHost,
+                                   pluginHost->selfMetadata()["icon"].value<QIcon>());
+        psiOptions->addSettingPage(tab);
+    }
+
+    // gstreamer and the device monitor are started by the host asking for
+    //   the provider (see createProvider()) or by opening the options page,
+    //   unless the user wants calls to be instant
+    if (psiOptions->getPluginOption("provider.prewarm", false).toBool())
+        startProvider();
+
+    return enabled;
+}
+
+// creates and starts the provider on first use.  setMediaProvider() gets it
+//   once it is initialized
+PsiMedia::GstProvider *PsiMediaPlugin::startProvider()
+{
+    if (!enabled)
+        return nullptr;
+
     if (!provider) {
         QVariantMap params;
 #ifdef Q_OS_WIN
@@ -96,10 +120,6 @@ bool PsiMediaPlugin::enable()
         connect(provider, &PsiMedia::GstProvider::initialized, this, [this]() {
             mediaHost->setMediaProvider(provider);
 
-            tab = new OptionsTabAvCall(provider, psiOptions, mediaHost,
-                                       pluginHost->selfMetadata()["icon"].value<QIcon>());
-            psiOptions->addSettingPage(tab);
-
             auto ain  = psiOptions->getPluginOption("devices.audio-input", QString()).toString();
             auto aout = psiOptions->getPluginOption("devices.audio-output", QString()).toString();
             auto vin  = psiOptions->getPluginOption("devices.video-input", QString()).toString();
@@ -107,8 +127,7 @@ bool PsiMediaPlugin::enable()
         });
         provider->init();
     }
-
-    return enabled;
+    return provider;
 }
 
 bool PsiMediaPlugin::disable()
@@ -155,8 +174,12 @@ QString PsiMediaPlugin::pluginInfo()
 
 PsiMedia::Provider *PsiMediaPlugin::createProvider(const QVariantMap &)
 {
-    // We don't need more than one provider in Psi
-    return provider;
+    // We don't need more than one provider in Psi.
+    //
+    // asking for the provider starts it, so the first call always gets one.
+    //   it may still be initializing then (see Plugin::createProvider()),
+    //   and it is also handed over with setMediaProvider() once it is up
+    return startProvider();
 }
 
 #include "psiplugin.moc"